@@ -18,11 +18,20 @@
 #include <array>
 #include <map>
 #include <set>
+#include <functional>
+#include <tuple>
+#include <memory>
 #include <cstdint>
 #include <algorithm>
 #include <regex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "alarmas.h"
 
 using namespace std;
+using namespace alarmas;
 
 
 /* ========================================================================= *
@@ -33,60 +42,34 @@ using namespace std;
 
 /* ========================================================================= *
  * Opcode and Bitmask Enums
+ *  (`OPCODE`, `I_FMT` and `OPR_WIDTH` are shared from `alarmas.h`)
  * ========================================================================= */
-enum OPCODE : uint16_t {
-    NOP  =0b0000000<<9,
-    HALT =0b0000011<<9,
-    MOVRR=0b0000100<<9,
-    MOVRF=0b0000110<<9,
-    MOVFR=0b0000111<<9,
-    LDRO =0b0001000<<9,
-    LDR  =0b0001011<<9,
-    STRO =0b0001100<<9,
-    STR  =0b0001111<<9,
-
-    ADD  =0b0010000<<9,
-    SUB  =0b0010001<<9,
-    MUL  =0b0010010<<9,
-    MULU =0b0010011<<9,
-    DIV  =0b0010100<<9,
-    MOD  =0b0010101<<9,
-    AND  =0b0010110<<9,
-    OR   =0b0010111<<9,
-    EOR  =0b0011000<<9,
-    NOT  =0b0011001<<9,
-    LSL  =0b0011010<<9,
-    LSR  =0b0011011<<9,
-    ASR  =0b0011100<<9,
-    ROL  =0b0011101<<9,
-    ROR  =0b0011110<<9,
-    CMP  =0b0011111<<9,
-
-    B    =0b0100000<<9,
-    BEQ  =0b0110000<<9,
-    BNE  =0b0111000<<9,
-    MOVIM=0b1000000<<9,
+enum FWD_PATHS {
+    FWD_NONE=0,
+    FWD_ALU,
+    FWD_ALL
 };
 
-enum I_FMT {
-    S_TYPE=0,
-    R1_TYPE,
-    R2_TYPE,
-    R2NW_TYPE,
-    R3_TYPE,
-    B_TYPE,
-    I_TYPE,
-    FL_TYPE,
-    FS_TYPE,
-    LS_TYPE,
-    LSO_TYPE,
-    FMT_LEN
+enum CFG_EXIT {
+    EXIT_NONE=0,
+    EXIT_HALT,
+    EXIT_INDIRECT,
+    EXIT_END,
+    EXIT_OUTSIDE,
+    EXIT_EXTERN
 };
 
-enum OPR_WIDTH {
-    NON=0,
-    REG=3,
-    IMM=12
+enum CARRY_STATE {
+    CARRY_NONE=0,
+    CARRY_CLEAR,
+    CARRY_CHAINED,
+    CARRY_STALE
+};
+
+enum SYM_BIND {
+    SYM_LOCAL=0,
+    SYM_GLOBAL,
+    SYM_EXTERN
 };
 
 
@@ -98,8 +81,18 @@ const long long IMM_MAX = (1<<(IMM-1))-1;
 const long long IMM_MIN = -1ULL<<(IMM-1);
 const unsigned IMM_NIBS = (IMM>>2) + !!(IMM&0b11);
 const unsigned MAX_INST = 65536;
+const unsigned MAX_DATA = 65536;
+const unsigned IO_BASE = 0xF800;
 const unsigned MAX_OPR = 3;
 const unsigned MAX_REG = WIDTH_TO_BITS(REG);
+const unsigned PC_REG = MAX_REG;
+const unsigned FLAGS_BIT = MAX_REG+1;
+const unsigned CARRY_BIT = FLAGS_BIT+1;
+const unsigned LDI_MAX_COST = 5;
+const unsigned SCHED_WINDOW = 32;
+const unsigned long long CYCLES_UNKNOWN = ~0ULL;
+const char OBJ_MAGIC[8] = { 'a', 'l', 'A', 'R', 'M', 'o', 'b', 'j' };
+const uint32_t OBJ_VERSION = 1;
 const char* ORD_SUFXS[] = { "st", "nd", "rd", "th" }; 
 
 
@@ -109,6 +102,30 @@ const char* ORD_SUFXS[] = { "st", "nd", "rd", "th" };
 struct label_s;
 struct prog_opts_s;
 struct prog_s;
+struct data_seg_s;
+struct macro_inst_s;
+struct macro_s;
+struct ldi_step_s;
+struct ldi_state_s;
+struct inst_row_s;
+struct peep_inst_s;
+struct peep_rule_s;
+struct known_bits_s;
+struct const_state_s;
+struct pipe_model_s;
+struct profile_entry_s;
+struct cfg_edge_s;
+struct cfg_block_s;
+struct cfg_loop_s;
+struct cfg_s;
+struct obj_header_s;
+struct obj_sym_s;
+struct obj_reloc_s;
+struct obj_line_s;
+struct obj_file_s;
+struct repl_line_s;
+struct cond_block_s;
+struct skip_range_s;
 
 /* ========================================================================= *
  * Typedefs
@@ -122,6 +139,10 @@ typedef vector<pair<uint8_t,OPR_WIDTH>>     fmt_config_t;
 
 typedef vector<pair<OPCODE,inst_tokens_t>>      inst_list_t;
 
+typedef vector<ldi_step_s>          ldi_seq_t;
+
+typedef map<mword_t, profile_entry_s>   profile_t;
+
 
 /* ========================================================================= *
  * Struct definitions
@@ -131,11 +152,99 @@ struct label_s {
     mword_t     address;
 };
 
+struct pipe_model_s {
+    unsigned    stages          = 5;
+    FWD_PATHS   forwarding      = FWD_ALL;
+    unsigned    load_latency    = 1;
+    unsigned    branch_penalty  = 2;
+    // per-opcode cycle costs, 1 for opcodes that aren't listed
+    map<OPCODE, unsigned> cycles;
+};
+
+// execution counts of a single address in a profile
+struct profile_entry_s {
+    unsigned long long  count;
+    unsigned long long  taken;
+};
+
 struct prog_opts_s {
     char*   src_file    = nullptr;
     char*   out_file    = nullptr;
     bool    list_flag   = false;
     bool    strict_flag = false;
+    bool    relax_flag  = false;
+    mword_t relax_reg   = 0;
+    bool    relax_use_scratch = false;
+    mword_t relax_scratch_reg = 0;
+    bool    sched_flag  = false;
+    bool    hazard_report_flag = false;
+    bool    dead_flag   = false;
+    bool    dead_report_flag = false;
+    bool    clc_flag    = false;
+    bool    carry_report_flag = false;
+    bool    peep_flag   = false;
+    bool    const_flag  = false;
+    pipe_model_s pipe_model;
+    bool    layout_flag = false;
+    char*   profile_file = nullptr;
+    char*   rules_file  = nullptr;
+    vector<string> entry_labels;
+    bool    cfg_report_flag = false;
+    char*   cfg_dot_file = nullptr;
+    char*   cfg_json_file = nullptr;
+    char*   data_file   = nullptr;
+    bool    compile_flag = false;
+    vector<string> link_files;
+    bool    interactive_flag = false;
+    map<string, long long> defines;
+};
+
+// words placed in data memory by a single directive, either values to be
+//   resolved into `words` (a single value is repeated over `length`), or
+//   the little-endian words of a file mapped by `.incbin`
+struct data_seg_s {
+    unsigned        address;
+    unsigned        length;
+    inst_tokens_t   toks;
+    vector<mword_t> words;
+    const uint8_t*  bytes   = nullptr;
+    size_t          n_bytes = 0;
+    unsigned        line_num;
+    string          src;
+};
+
+// instruction of a macro body, parsed once with the parameters it takes
+//   (`holes[t]` is the parameter filling token `t` whole, -1 for none, or
+//   -2 for tokens patched with `\@` or parameters inside a longer name),
+//   or a use of the earlier macro `macro` taking the tokens as arguments
+struct macro_inst_s {
+    vector<OPCODE>  opcodes;
+    inst_tokens_t   toks;
+    inst_tokens_t   toks_raw;
+    vector<int>     holes;
+    vector<string>  labels;
+    unsigned        line_num;
+    shared_ptr<const macro_s> macro;
+};
+
+// `.macro` definition, or `.rept` block (no name) repeated `count` times
+struct macro_s {
+    string                  name;
+    vector<string>          params;
+    vector<pair<unsigned,string>> lines;
+    vector<macro_inst_s>    body;
+    vector<string>          end_labels;
+    unsigned                line_num;
+    unsigned                count;
+};
+
+// source lines left out by conditional assembly, and the directive that
+//   left them out
+struct skip_range_s {
+    unsigned    first;
+    unsigned    last;
+    unsigned    cond_line;
+    string      cond;
 };
 
 struct prog_s {
@@ -143,86 +252,224 @@ struct prog_s {
     label_map_t         label_lookup;
     vector<label_s>     labels;
     vector<unsigned>    debug_line_nums;
+    vector<unsigned>    debug_macro_lines;
     vector<mword_t>     mcode;
     vector<inst_tokens_t> insts_raw;
+    vector<string>      debug_notes;
+    vector<data_seg_s>  data;
+    label_map_t         data_lookup;
+    vector<label_s>     data_labels;
+    set<string>         global_labels;
+    set<string>         extern_labels;
+    // branches to extern labels, patched by the linker
+    vector<pair<unsigned,string>> relocs;
+    // extern labels are allowed (`-c`, `-L`)
+    bool                linking = false;
+    // may be linked after other code, so it doesn't start at reset
+    bool                relocatable = false;
+    // `.equ` and `-D` symbols, and the lines conditional assembly left out
+    map<string, long long> equs;
+    vector<skip_range_s> skipped;
+};
+
+// open `.if` block of conditional assembly, with whether the region around
+//   it is assembled, whether its condition held and whether `.else` was seen
+struct cond_block_s {
+    unsigned    line_num;
+    string      src;
+    bool        outer;
+    bool        taken;
+    bool        in_else;
+};
+
+// line entered into the interactive assembler (`-i`), with the instruction
+//   and label counts before it and the earlier branches to labels it
+//   defined, so `:undo` can take it back
+struct repl_line_s {
+    string              src;
+    unsigned            n_insts;
+    unsigned            n_labels;
+    vector<unsigned>    patched;
+};
+
+// header of a relocatable object (`-c`), followed by the words, symbols,
+//   relocations and line info (one per word) in that order, each padded
+//   to 4 bytes, and then the string table, whose first string is the
+//   source path. Objects are in host byte order so the linker can use a
+//   mapped file as is.
+struct obj_header_s {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    n_words;
+    uint32_t    n_syms;
+    uint32_t    n_relocs;
+    uint32_t    str_size;
+    uint32_t    pad;
+    // source size, modification time (ns) and options, to reuse objects
+    uint64_t    src_size;
+    int64_t     src_mtime;
+    uint64_t    opts_hash;
+};
+
+// symbol of an object, `name` is an offset into its string table
+struct obj_sym_s {
+    uint32_t    name;
+    uint32_t    address;
+    uint32_t    bind;
+};
+
+// branch word patched by the linker with the offset to an extern symbol
+struct obj_reloc_s {
+    uint32_t    index;
+    uint32_t    sym;
+};
+
+// source line of an object word, and its macro body line (0 for none)
+struct obj_line_s {
+    uint32_t    line;
+    uint32_t    macro_line;
+};
+
+// relocatable object viewed in place, from a mapped file or `buf`
+struct obj_file_s {
+    string              path;
+    string              buf;
+    const char*         mapped  = nullptr;
+    size_t              size    = 0;
+    const obj_header_s* hdr     = nullptr;
+    const mword_t*      words   = nullptr;
+    const obj_sym_s*    syms    = nullptr;
+    const obj_reloc_s*  relocs  = nullptr;
+    const obj_line_s*   lines   = nullptr;
+    const char*         strs    = nullptr;
+};
+
+// single step of a constant materialization sequence, registers are slots
+//   (0 = destination register, 1 = scratch register)
+struct ldi_step_s {
+    OPCODE      opcode;
+    uint8_t     dst;
+    uint8_t     src_n;
+    uint8_t     src_m;
+    mword_t     imm;
+};
+
+// register values known while searching for a materialization sequence
+struct ldi_state_s {
+    mword_t     val[2];
+    uint8_t     known;
+};
+
+// control-flow edge between two blocks of the encoded program
+//   - `cycles` are added when the edge is taken (the branch penalty)
+//   - `back` marks edges that close a loop in a depth-first walk
+struct cfg_edge_s {
+    unsigned    to;
+    unsigned    cycles;
+    bool        taken;
+    bool        back;
+};
+
+// basic block of the encoded program
+//   - `loop` is the innermost loop holding the block, or -1
+//   - `best`/`worst` are the cycles until the program exits
+struct cfg_block_s {
+    unsigned    first;
+    unsigned    last;
+    unsigned    cycles_min;
+    unsigned    cycles_max;
+    vector<cfg_edge_s> succs;
+    CFG_EXIT    exit;
+    unsigned    exit_cycles;
+    bool        reachable;
+    int         loop;
+    unsigned long long best;
+    unsigned long long worst;
+};
+
+// natural loop of the encoded program, `blocks` sorted and holding `header`
+//   - `best`/`worst` are the cycles per iteration
+struct cfg_loop_s {
+    unsigned    header;
+    vector<unsigned> blocks;
+    int         parent;
+    unsigned    depth;
+    unsigned long long best;
+    unsigned long long worst;
+};
+
+struct cfg_s {
+    vector<cfg_block_s> blocks;
+    vector<cfg_loop_s>  loops;
+    vector<unsigned>    block_of;
+};
+
+// single row of the parallel instruction vectors in `prog_s`, used by passes
+//   that rewrite the instruction list before encoding
+//   - `origin` is the old index whose labels move onto this row, or -1
+struct inst_row_s {
+    OPCODE          opcode;
+    inst_tokens_t   toks;
+    inst_tokens_t   toks_raw;
+    unsigned        line_num;
+    unsigned        macro_line;
+    string          note;
+    int             origin;
+};
+
+// instruction of a peephole rule, over the register variables of the rule
+//   (`A` is 0), with the variable of each register operand in `vars`
+struct peep_inst_s {
+    OPCODE          opcode;
+    unsigned        vars[MAX_OPR];
+    long long       imm;
+};
+
+// peephole rule read from a rules file (written by `superopt`), where
+//   `keeps` and `writes` are bitmasks of variables and `flags` is set when
+//   either side sets the flags, so they must be dead after a match
+struct peep_rule_s {
+    vector<peep_inst_s> pattern;
+    vector<peep_inst_s> replacement;
+    unsigned        n_vars;
+    unsigned        keeps;
+    unsigned        writes;
+    bool            flags;
+    unsigned        line_num;
+};
+
+// bits of a value known to be 0 (`zeros`) or 1 (`ones`), the rest unknown
+struct known_bits_s {
+    mword_t         zeros;
+    mword_t         ones;
+};
+
+// known register values and carry (0 or 1) reaching an instruction, where
+//   `reached` is false until some path reaches it
+struct const_state_s {
+    bool            reached;
+    known_bits_s    regs[MAX_REG];
+    known_bits_s    carry;
 };
 
 
 /* ========================================================================= *
  * ISA Config Definition
  * ========================================================================= */
-const array<fmt_config_t, FMT_LEN> FMT_CONFIG = {{
-    { },                                    // S-Type
-    { {1*REG,REG} },                        // R1-Type
-    { {1*REG,REG}, {2*REG,REG} },           // R2-Type
-    { {2*REG,REG}, {0,REG} },               // R2NW-Type
-    { {1*REG,REG}, {2*REG,REG}, {0,REG} },  // R3-Type
-    { {0,IMM} },                            // B-Type
-    { {1*IMM,REG}, {0,IMM} },               // I-Type
-    { {1*REG,REG}, {0,NON} },               // FL-Type
-    { {0,NON},     {2*REG,REG} },           // FS-Type
-    { {1*REG,REG}, {2*REG,REG} },           // LS-Type
-    { {1*REG,REG}, {2*REG,REG}, {0,REG} },  // LSO-Type
-}};
+// builds the operand fields of each format from `FMT_FIELDS`
+array<fmt_config_t, FMT_LEN> build_fmt_config();
 
-const map<OPCODE, I_FMT> OPC_TO_FMT = {
-    { NOP,  S_TYPE },
-    { HALT, S_TYPE },
-    { MOVRR, R2_TYPE },
-    { MOVIM, I_TYPE },
-    { MOVRF, FL_TYPE },
-    { MOVFR, FS_TYPE },
-    { LDR,  LS_TYPE },
-    { LDRO, LSO_TYPE },
-    { STR,  LS_TYPE },
-    { STRO, LSO_TYPE },
-    { ADD,  R3_TYPE },
-    { SUB,  R3_TYPE },
-    { MUL,  R3_TYPE },
-    { MULU, R3_TYPE },
-    { DIV,  R3_TYPE },
-    { MOD,  R3_TYPE },
-    { AND,  R3_TYPE },
-    { OR,   R3_TYPE },
-    { EOR,  R3_TYPE },
-    { NOT,  R2_TYPE },
-    { LSL,  R3_TYPE },
-    { LSR,  R3_TYPE },
-    { ASR,  R3_TYPE },
-    { ROL,  R3_TYPE },
-    { ROR,  R3_TYPE },
-    { CMP,  R2NW_TYPE },
-    { B,    B_TYPE },
-    { BEQ,  B_TYPE },
-    { BNE,  B_TYPE },
-};
+// builds the format of each opcode from `OPC_FMTS`
+map<OPCODE, I_FMT> build_opc_to_fmt();
 
-const map<string, vector<OPCODE>> ISA = {
-    {"NOP",     { NOP }}, 
-    {"HALT",    { HALT }},
-    {"MOV",     { MOVRR, MOVRF, MOVFR, MOVIM }},
-    {"LDR",     { LDR, LDRO }},
-    {"STR",     { STR, STRO }},  
-    {"ADD",     { ADD }},
-    {"SUB",     { SUB }},  
-    {"MUL",     { MUL }},  
-    {"MULU",    { MULU }}, 
-    {"DIV",     { DIV }},  
-    {"MOD",     { MOD }},  
-    {"AND",     { AND }},  
-    {"OR",      { OR }},   
-    {"EOR",     { EOR }},  
-    {"NOT",     { NOT }},  
-    {"LSL",     { LSL }},  
-    {"LSR",     { LSR }},  
-    {"ASR",     { ASR }},  
-    {"ROL",     { ROL }},  
-    {"ROR",     { ROR }},  
-    {"CMP",     { CMP }},  
-    {"B",       { B }},    
-    {"BEQ",     { BEQ }},    
-    {"BNE",     { BNE }},
-};
+// builds the opcodes of each mnemonic from `MNEMONICS`
+map<string, vector<OPCODE>> build_isa();
+
+const array<fmt_config_t, FMT_LEN> FMT_CONFIG = build_fmt_config();
+
+const map<OPCODE, I_FMT> OPC_TO_FMT = build_opc_to_fmt();
+
+const map<string, vector<OPCODE>> ISA = build_isa();
 
 const array<regex,FMT_LEN> FMT_REGEX = {{
     // S_TYPE
@@ -296,8 +543,52 @@ const map<string, string> PSUEDO_ISA = {
     {"CLC",     "AND R0, R0, R0"},
 };
 
+const array<const char*,3> FWD_NAMES = {{ "none", "alu", "all" }};
+
+const array<const char*,6> CFG_EXIT_NAMES = {{
+    "none", "halt", "indirect", "end", "outside", "extern"
+}};
+
+const array<const char*,4> CARRY_NAMES = {{
+    "unreached", "clear", "chained", "stale"
+}};
+
+const set<string> DATA_DIRECTIVES = {
+    "WORD", "FILL", "ORG", "ALIGN", "INCBIN"
+};
+
+const set<string> MACRO_DIRECTIVES = {
+    "MACRO", "ENDM", "REPT", "ENDR"
+};
+
+const set<string> LINK_DIRECTIVES = {
+    "GLOBAL", "EXTERN"
+};
+
+const set<string> COND_DIRECTIVES = {
+    "IF", "IFDEF", "IFNDEF", "ELSE", "ENDIF"
+};
+
 const vector<string> RESERVED_NAMES = {
-    "FLAGS"
+    "FLAGS",
+    "LDI"
+};
+
+// listing note of a `-i` branch waiting for its label to be defined
+const string REPL_PENDING_NOTE = "(waiting for label)";
+
+// mnemonic of the constant materialization psuedo-instruction
+const string LDI_MNEMONIC = "LDI";
+
+// ALU operations usable by constant materialization (none read the carry,
+//   and MUL is left out since it takes several cycles on most pipelines)
+const vector<OPCODE> LDI_OPS = {
+    AND, OR, EOR, NOT, LSL, LSR, ASR, ROL, ROR
+};
+
+// subset of LDI_OPS that do something useful with `Rd, Rd, Rd` operands
+const vector<OPCODE> LDI_SELF_OPS = {
+    NOT, LSL, LSR, ASR, ROL, ROR
 };
 
 
@@ -307,16 +598,62 @@ const vector<string> RESERVED_NAMES = {
 const regex extract_inst_re(
     "^((?:\\s*\\w*:)*)\\s*(\\w+)?\\s*([^;]*)\\s*(;.*)?$");
 const regex label_re("(\\w*):");
+const regex directive_re(
+    "^((?:\\s*\\w*:)*)\\s*\\.(\\w*)\\s*([^;]*)\\s*(;.*)?$");
+const regex macro_line_re(
+    "^((?:\\s*[\\w\\\\@]*:)*)\\s*(\\w+)?\\s*([^;]*)\\s*(;.*)?$");
+const regex macro_label_re("([\\w\\\\@]*):");
+const regex macro_opr_split_re("[\\s,\\[\\]]+");
+const regex macro_ref_re("\\\\(\\w+|@)");
+const regex data_label_re("^[A-Z_]\\w*$", regex::icase);
+const regex incbin_re("^\"([^\"]+)\"$");
 const regex dec_re("^(-?\\d+)$");
 const regex udec_re("^(\\d+)$");
 const regex hex_re("^0[xX]([A-F\\d]+)$");
 const regex bin_re("^0[bB]([01]+)$");
+const regex ldi_re(string("^(R\\d+)(?:\\s+|\\s*,\\s*)([-\\w]+)")
+    + string("(?:(?:\\s+|\\s*,\\s*)(R\\d+))?\\s*$"), regex::icase);
+const regex ldi_re_strict(string("^(R\\d+)\\s*,\\s*([-\\w]+)")
+    + string("(?:\\s*,\\s*(R\\d+))?\\s*$"), regex::icase);
+const regex profile_re(string("^\\s*(0[xX][A-F\\d]+|\\d+)\\s+(\\d+)")
+    + string("(?:\\s+(\\d+))?\\s*(;.*)?$"), regex::icase);
+const regex cond_re(
+    "^([-\\w]+)(?:\\s*(==|!=|<=|>=|<|>)\\s*([-\\w]+))?$");
+const regex rule_re("^(.*?)\\s*=>\\s*(.*?)\\s*:\\s*keeps\\s+(.*?)\\s*$",
+    regex::icase);
+const regex rule_inst_re("^(\\w+)\\s*(.*)$");
+const regex rule_var_re("^[A-G]$", regex::icase);
+const regex relax_regs_re("^(R\\d+)(?:,(R\\d+))?$", regex::icase);
 
 
 /* ========================================================================= *
  * Function Declarations
  * ========================================================================= */
 
+/* ------------------------------------------------------------------------- *
+ * assemble_program
+ * - Parses `src_file` and runs the optimization passes and reports of
+ *     `opts` over it, then encodes its instructions and data into `prog`.
+ * - Returns false (after printing why) if any step fails.
+ * ------------------------------------------------------------------------- */
+bool assemble_program(const prog_opts_s& opts, const char* src_file,
+    prog_s& prog);
+
+/* ------------------------------------------------------------------------- *
+ * run_interactive
+ * - Assembles lines from standard input as they are typed (`-i`), keeping
+ *     a single `prog_s` and printing the listing row of each instruction.
+ * - Branches to labels that aren't defined yet wait in `pending` and are
+ *     encoded once a later line defines the label.
+ * - Lines starting with `:` are commands:
+ *   - `:undo` takes back the last line, along with the branches it patched
+ *   - `:save [file]` writes the Logisim image (default: the object file)
+ *   - `:list` prints the full listing, `:help` the commands, `:quit` exits
+ * - Returns false if any line or command failed, so scripted sessions can
+ *     check for errors.
+ * ------------------------------------------------------------------------- */
+bool run_interactive(const prog_opts_s& opts);
+
 /* ------------------------------------------------------------------------- *
  * parse_program
  * - First pass of input file, builds list of tokenized instructions
@@ -331,6 +668,198 @@ const regex bin_re("^0[bB]([01]+)$");
  * ------------------------------------------------------------------------- */
 bool parse_program(ifstream& in, prog_s& prog, bool strict_parsing=false);
 
+/* ------------------------------------------------------------------------- *
+ * parse_inst_line
+ * - Parses a single (trimmed) line of the text section into `prog`, adding
+ *     its labels and the instructions of its mnemonic, psuedo-instruction,
+ *     `LDI` or use of one of `macros`.
+ * - Shared by `parse_program` and the interactive assembler.
+ * - Returns true upon succesful completion.
+ * - Returns false if some syntax error is found.
+ * ------------------------------------------------------------------------- */
+bool parse_inst_line(string line_buf, unsigned file_line,
+        bool strict_parsing, const map<string, macro_s>& macros,
+        unsigned& n_expanded, prog_s& prog);
+
+/* ------------------------------------------------------------------------- *
+ * parse_data
+ * - Lays out the data section of the source `lines` before instructions
+ *     are parsed, so data labels can be used anywhere in the program.
+ * - Lines after `.data` (until `.text`) place words in data memory:
+ *   - `.word v[, v...]` places 16-bit values or labels
+ *   - `.fill count[, v]` places `count` copies of `v` (default 0)
+ *   - `.org addr` and `.align n` skip ahead, leaving zeros
+ *   - `.incbin "file"` maps a binary file and places its bytes as
+ *       little-endian words, without copying them
+ * - Labels in the data section name data addresses, values are resolved
+ *     by `encode_data` once instruction labels are final.
+ * - Returns true upon succesful completion, builds `prog.data`,
+ *     `prog.data_lookup`, and `prog.data_labels`.
+ * - Returns false if a directive is malformed, a file can't be mapped, or
+ *     the data outgrows data memory.
+ * ------------------------------------------------------------------------- */
+bool parse_data(const vector<string>& lines, prog_s& prog,
+    bool strict_parsing);
+
+/* ------------------------------------------------------------------------- *
+ * preprocess_program
+ * - Resolves conditional assembly and symbols in the source `lines` before
+ *     any other pass sees them:
+ *   - `.if v [op v]` (`==`, `!=`, `<`, `<=`, `>`, `>=`, or nonzero),
+ *       `.ifdef NAME`, `.ifndef NAME`, `.else` and `.endif` blocks nest
+ *   - `.equ NAME, v` defines a symbol, like `-D NAME=v` (in `prog.equs`)
+ * - Lines of regions that aren't assembled are only scanned for the
+ *     conditional directive starting them, then emptied (keeping line
+ *     numbers), so they never reach label or operand parsing. Each
+ *     region is noted in `prog.skipped` for the listing.
+ * - Symbols are left in the lines, so errors quote the source as written,
+ *     and are replaced by their values where operands are parsed. Since
+ *     that's after every `.equ` is read, a symbol must be defined before
+ *     the first line using its name.
+ * - Returns true upon succesful completion.
+ * - Returns false if a condition or definition is malformed, a symbol is
+ *     used before its definition, or blocks are unbalanced.
+ * ------------------------------------------------------------------------- */
+bool preprocess_program(vector<string>& lines, bool strict_parsing,
+    prog_s& prog);
+
+/* ------------------------------------------------------------------------- *
+ * layout_program
+ * - Reorders the basic blocks of the program so the hot paths measured in
+ *     `profile` fall through instead of taking branches.
+ * - Blocks are chained greedily along their hottest edges, and each
+ *     region's chains are placed hottest first after the chain holding
+ *     the region's first block.
+ * - Conditionals are inverted (`BEQ` <-> `BNE`) when their taken path now
+ *     falls through, `B` is added where a fall-through was broken, and a
+ *     `B` to the block that now follows is dropped. Branches refer to
+ *     labels, so offsets are recomputed when the program is encoded.
+ * - The first instruction, the labels in `entries` and the blocks that read
+ *     the PC keep their address, blocks only move within the regions
+ *     between them (padded with `NOP` when they shrink, left as typed when
+ *     they would grow). Programs that write the PC are left as typed, since
+ *     their computed jump targets can't follow the moved blocks.
+ * - Returns true upon succesful completion, counting the blocks that were
+ *     moved in `n_moved` and the inverted conditionals in `n_inverted`.
+ * - Returns false if an entry label is undefined, the profile doesn't fit
+ *     the program, or the program outgrows instruction memory.
+ * ------------------------------------------------------------------------- */
+bool layout_program(prog_s& prog, const profile_t& profile,
+    const vector<string>& entries, unsigned& n_moved, unsigned& n_inverted);
+
+/* ------------------------------------------------------------------------- *
+ * peephole_program
+ * - Rewrites the sequences matching the pattern of a rule in `rules` into
+ *     its shorter replacement, as proven equivalent by `superopt`.
+ * - A pattern matches instructions with no label inside them, whose
+ *     registers map one-to-one onto its variables (never onto the PC) and
+ *     whose immediates are its own. A match is only rewritten when the
+ *     registers either side writes but the rule doesn't keep, and the
+ *     flags when either side sets them, are dead after it.
+ * - Rules are tried in file order at each instruction, over and over
+ *     until none applies. Each rewrite is noted in the listing.
+ * - Programs that read or write the PC are left as typed, since their
+ *     computed addresses can't follow the shorter code.
+ * - Counts the rewritten sequences in `n_rewritten`.
+ * ------------------------------------------------------------------------- */
+void peephole_program(prog_s& prog, const vector<peep_rule_s>& rules,
+    unsigned& n_rewritten);
+
+/* ------------------------------------------------------------------------- *
+ * propagate_constants
+ * - Follows the bits of each register (and the carry) known along the
+ *     control flow of the program, visiting a basic block again only when
+ *     the values reaching it lose known bits. Registers are unknown at
+ *     reset and at global labels, and the carry starts clear.
+ * - ALU ops whose result is known are folded into `MOV Rd, Imm` when it
+ *     fits the immediate and the flags they set are dead.
+ * - `MUL` by a power of two becomes `LSL`, and `DIV`/`MOD` by a power of
+ *     two become `ASR`/`AND` when the dividend is known non-negative, so
+ *     the result and flags stay the same. The shift or mask comes from a
+ *     register known to hold it, or else is loaded into a dead register
+ *     when `MOV` and the new op cost no more cycles in `model`.
+ * - Each rewrite is noted in the listing. Programs that read or write the
+ *     PC are left as typed, since their computed jumps can't be followed.
+ * - Counts the folded and reduced instructions in `n_folded` and
+ *     `n_reduced`.
+ * ------------------------------------------------------------------------- */
+void propagate_constants(prog_s& prog, const pipe_model_s& model,
+    unsigned& n_folded, unsigned& n_reduced);
+
+/* ------------------------------------------------------------------------- *
+ * eliminate_dead_writes
+ * - Computes register and flag liveness over the whole program and finds
+ *     the `MOV` and ALU instructions whose results are never read, along
+ *     with the ones only read by those (repeated until none are left).
+ * - Everything is live at `HALT`, after writes to the PC, and past the
+ *     end of the program, and writes to the PC are never dead.
+ * - When `apply` is true, the dead instructions are removed, with labels
+ *     and branch targets moving to the next instruction that is kept.
+ *     Programs that read or write the PC are only reported, since their
+ *     computed addresses can't follow the removed instructions.
+ * - When `report` is true, prints the dead writes by source line to
+ *     standard error.
+ * - Counts the removed instructions in `n_removed`.
+ * ------------------------------------------------------------------------- */
+void eliminate_dead_writes(prog_s& prog, bool apply, bool report,
+    unsigned& n_removed);
+
+/* ------------------------------------------------------------------------- *
+ * track_carry
+ * - Follows the state of the carry flag along the control flow of the
+ *     program, starting clear at reset: `ADD`, `SUB` and `MOV Flags, Rn`
+ *     leave a carry meant for the next instruction (chained), `CMP` leaves
+ *     a borrow nobody asked for, `AND` (`CLC`) clears it, and the carry
+ *     of every other ALU op isn't documented, so it's stale too.
+ * - A chained carry that reaches another block, along with the carry at
+ *     labels of programs that write the PC, is stale, and `ADD`/`SUB`
+ *     reading a stale carry are warned about.
+ * - A `CLC` is redundant when the carry is clear on every path reaching it
+ *     and the N and Z flags it sets are never read.
+ * - When `apply` is true, redundant `CLC`s are removed, unless the program
+ *     reads or writes the PC. Each decision is noted in the listing.
+ * - When `report` is true, prints the carry reaching each `CLC`, `ADD` and
+ *     `SUB` to standard error.
+ * - Counts the removed instructions in `n_removed`.
+ * ------------------------------------------------------------------------- */
+void track_carry(prog_s& prog, bool apply, bool report, unsigned& n_removed);
+
+/* ------------------------------------------------------------------------- *
+ * schedule_program
+ * - Reorders independent instructions within basic blocks to hide the
+ *     load-use and flag hazards of the pipeline described by `model`.
+ * - Blocks are split at labels, branch targets, and after branches,
+ *     `HALT`, and writes to the PC. Reads of the PC are never moved, and
+ *     blocks are scheduled in windows of at most `SCHED_WINDOW` insts.
+ * - Register, flag and memory dependencies are kept, with the last flag
+ *     write of each window kept last since a later block may test it.
+ * - A window is only reordered when its estimated stall count drops.
+ * - When `apply` is false, nothing is reordered and only the estimates
+ *     are computed, for a report of the unscheduled program.
+ * - When `report` is true, prints per-block stall cycles before and after
+ *     scheduling to standard error.
+ * ------------------------------------------------------------------------- */
+void schedule_program(prog_s& prog, const pipe_model_s& model, bool apply,
+    bool report);
+
+/* ------------------------------------------------------------------------- *
+ * relax_branches
+ * - Layout pass run between parsing and encoding, rewrites every B-type
+ *     branch whose target is out of range of the 12-bit offset into a
+ *     long branch through register `reg` (and `scratch_reg` if given):
+ *   - `B L`   -> `LDI reg, L[, scratch_reg]`, `MOV R7, reg`
+ *   - `BEQ L` -> `BNE` over the long branch above (`BNE` likewise)
+ * - Repeats until no more addresses change, long branches never shrink
+ *     back (they are padded with `NOP` instead) so the layout converges.
+ * - Returns true upon succesful completion, counting the branches that
+ *     were relaxed in `n_relaxed`.
+ * - Returns false if a target can't be loaded with the given registers,
+ *     a branch of a relocatable program (`-c`, `-L` sources) is out of
+ *     range, or the program outgrows instruction memory.
+ * ------------------------------------------------------------------------- */
+bool relax_branches(prog_s& prog, mword_t reg, bool use_scratch,
+    mword_t scratch_reg, unsigned& n_relaxed);
+
 /* ------------------------------------------------------------------------- *
  * encode_program
  * - Second pass of input file, encodes tokenized instructions into their
@@ -340,6 +869,25 @@ bool parse_program(ifstream& in, prog_s& prog, bool strict_parsing=false);
  * ------------------------------------------------------------------------- */
 bool encode_program(prog_s& prog);
 
+/* ------------------------------------------------------------------------- *
+ * encode_inst
+ * - Encodes instruction `i` of `prog` into `enc_inst_buf`, replacing its
+ *     immediate tokens with their hex (and its extern branches with a
+ *     relocation).
+ * - Returns true upon succesful completion.
+ * - Returns false if any operand cannot be encoded.
+ * ------------------------------------------------------------------------- */
+bool encode_inst(prog_s& prog, unsigned i, mword_t& enc_inst_buf);
+
+/* ------------------------------------------------------------------------- *
+ * encode_data
+ * - Resolves the values of the data section into `prog.data` words, with
+ *     labels naming data addresses or (final) instruction addresses.
+ * - Returns true upon succesful completion.
+ * - Returns false if any value cannot be encoded.
+ * ------------------------------------------------------------------------- */
+bool encode_data(prog_s& prog);
+
 /* ------------------------------------------------------------------------- *
  * write_program
  * - Writes the program to a given output file.
@@ -347,30 +895,364 @@ bool encode_program(prog_s& prog);
  * ------------------------------------------------------------------------- */
 void write_program(ofstream& out, const prog_s& prog);
 
+/* ------------------------------------------------------------------------- *
+ * write_data
+ * - Writes the data section as a data memory image to a given output file,
+ *     with gaps and repeated values run-length encoded (`count*value`).
+ * - Words of `.incbin` files are written straight from their mapping.
+ * -  File should be opened before calling this function.
+ * ------------------------------------------------------------------------- */
+void write_data(ofstream& out, const prog_s& prog);
+
+/* ------------------------------------------------------------------------- *
+ * build_object
+ * - Lays out the encoded program as a relocatable object in `buf`: its
+ *     words, every label as a symbol (bound `.global` or local), every
+ *     `.extern` label, a relocation for each branch to one, and the source
+ *     line of each word.
+ * - `src_file` is stat'd so an unchanged source can reuse the object.
+ * ------------------------------------------------------------------------- */
+void build_object(const prog_s& prog, const char* src_file,
+    uint64_t opts_hash, string& buf);
+
+/* ------------------------------------------------------------------------- *
+ * map_object
+ * - Maps the object file `obj.path` into memory and checks it, pointing
+ *     the arrays of `obj` into the mapping.
+ * - Returns false if the file can't be mapped or isn't a valid object,
+ *     only printing why if `quiet` isn't set.
+ * ------------------------------------------------------------------------- */
+bool map_object(obj_file_s& obj, bool quiet=false);
+
+/* ------------------------------------------------------------------------- *
+ * load_link_file
+ * - Loads a file given to `-L` into `obj`, mapping it if it's an object.
+ * - A source file is assembled into the object next to it (`.s` replaced
+ *     by `.o`), unless that object was built from the same source size,
+ *     modification time and options (including the `-r` rules file's
+ *     size and modification time), in which case it's reused as is.
+ * - Sources given to `-L` don't get `-O layout`, listings or reports.
+ * - Returns false if the file can't be assembled or loaded.
+ * ------------------------------------------------------------------------- */
+bool load_link_file(const prog_opts_s& opts, const string& path,
+    obj_file_s& obj);
+
+/* ------------------------------------------------------------------------- *
+ * link_objects
+ * - Places `objs` one after another from address 0 into `image`,
+ *     resolving each `.extern` label to the `.global` label of the same
+ *     name and patching the branches to it.
+ * - Returns false if a label is global in two objects, an extern label
+ *     isn't global anywhere, a patched branch is out of range, or the
+ *     image outgrows instruction memory.
+ * ------------------------------------------------------------------------- */
+bool link_objects(const vector<obj_file_s>& objs, vector<mword_t>& image);
+
 /* ------------------------------------------------------------------------- *
  * print_program_listing
  * - Prints more verbose program listing to standard error.
  * ------------------------------------------------------------------------- */
 void print_program_listing(const prog_s& prog);
 
+/* ------------------------------------------------------------------------- *
+ * build_cfg
+ * - Builds the control-flow graph of the encoded program in `prog.mcode`,
+ *     split into basic blocks at labels, branch targets, and after
+ *     branches, `HALT`, and writes to the PC.
+ * - Edges follow `B`/`BEQ`/`BNE` offsets and fall-throughs, while `HALT`,
+ *     writes to the PC (indirect jumps), branches out of the program and
+ *     falling past its last instruction are exits.
+ * - Blocks not reachable from address 0 (or a `.global` label) are
+ *     marked, and loops are the natural loops of the edges that close a
+ *     cycle in a depth-first walk from address 0 (edges into the same
+ *     header share a loop).
+ * - Cycles come from the per-opcode costs of `model`, taken branches and
+ *     writes to the PC add its branch penalty, and loads add its load
+ *     latency to the worst case. Each loop gets its best and worst cycles
+ *     per iteration, and each block its best and worst cycles until the
+ *     program exits, with every loop on the way run once.
+ * ------------------------------------------------------------------------- */
+void build_cfg(const prog_s& prog, const pipe_model_s& model, cfg_s& cfg);
+
+/* ------------------------------------------------------------------------- *
+ * print_cfg_report
+ * - Prints the loops, unreachable code, exits past the end of the program,
+ *     and the cycle estimates of a control-flow graph to standard error.
+ * ------------------------------------------------------------------------- */
+void print_cfg_report(const prog_s& prog, const cfg_s& cfg);
+
+/* ------------------------------------------------------------------------- *
+ * write_cfg_dot
+ * - Writes a control-flow graph as a Graphviz digraph, with each block's
+ *     instructions and cycles as a node and each loop as a nested cluster.
+ * - Taken branches are solid, fall-throughs dashed, and loop-closing
+ *     edges bold, while unreachable blocks are grayed out.
+ * ------------------------------------------------------------------------- */
+void write_cfg_dot(ofstream& out, const prog_s& prog, const cfg_s& cfg);
+
+/* ------------------------------------------------------------------------- *
+ * write_cfg_json
+ * - Writes a control-flow graph as JSON, with `blocks`, `loops` and
+ *     `labels` arrays. Cycle estimates are `[best, worst]` pairs, or
+ *     `null` when no path ends.
+ * ------------------------------------------------------------------------- */
+void write_cfg_json(ofstream& out, const prog_s& prog, const cfg_s& cfg);
+
+/* ------------------------------------------------------------------------- *
+ * parse_ldi
+ * - Expands the `LDI Rd, Imm[, Rs]` psuedo-instruction extracted into `m`
+ *     by `extract_inst_re`, loading any 16-bit value into `Rd` and
+ *     optionally clobbering the scratch register `Rs`.
+ * - Pushes the sequence found by `materialize_constant` onto `prog`, with
+ *     each instruction noted in the listing along with the sequence cost.
+ * - Returns false if the operands are malformed or no sequence exists.
+ * ------------------------------------------------------------------------- */
+bool parse_ldi(const string& line_buf, const smatch& m, unsigned file_line,
+    bool strict_parsing, prog_s& prog);
+
+/* ------------------------------------------------------------------------- *
+ * build_macro
+ * - Parses the body lines of a `.macro` or `.rept` block once into
+ *     instruction templates: mnemonics are looked up, `CLC` is replaced,
+ *     operands are split into tokens and checked against the formats of
+ *     the mnemonic, and each `\param` operand becomes a hole.
+ * - `\param` and `\@` (the expansion count) can also be part of a longer
+ *     label or operand name, such as `loop\@`.
+ * - The opcode is fixed unless a hole decides between formats (`MOV`).
+ * - Uses of the macros in `macros`, defined before this body, keep a copy
+ *     of the used macro to expand in place with the filled arguments.
+ * - Returns false if a body line is malformed, references an unknown
+ *     parameter, or uses a macro with the wrong number of arguments.
+ * ------------------------------------------------------------------------- */
+bool build_macro(macro_s& macro, const map<string, macro_s>& macros,
+    bool strict_parsing);
+
+/* ------------------------------------------------------------------------- *
+ * expand_macro
+ * - Copies the instruction templates of `macro` onto `prog`, filling the
+ *     holes with `args` and `\@` with the running expansion count in
+ *     `n_expanded`.
+ * - Expanded instructions keep the call site as their line, the macro
+ *     body line in `prog.debug_macro_lines`, and are noted in the listing.
+ * - `LDI` templates are expanded by `parse_ldi` once their operands are
+ *     known, since the sequence depends on the value, and macro uses by
+ *     expanding the used macro.
+ * - Returns false if a label is repeated, an `LDI` fails, or the program
+ *     outgrows instruction memory.
+ * ------------------------------------------------------------------------- */
+bool expand_macro(const macro_s& macro, const vector<string>& args,
+    const string& line_buf, unsigned file_line, unsigned& n_expanded,
+    prog_s& prog);
+
+/* ------------------------------------------------------------------------- *
+ * materialize_constant
+ * - Searches for the shortest sequence that leaves `target` in the
+ *     destination register (slot 0), using the scratch register (slot 1)
+ *     only when `use_scratch` is set.
+ * - Sequences are built from `MOV Imm` and the carry-independent ALU ops
+ *     in `LDI_OPS`, so the result never depends on the incoming flags.
+ * - The search is exhaustive over single-register chains and over
+ *     two-register sequences whose last immediate is solved backwards
+ *     from `target`, falling back to the generic 5-instruction split.
+ * - Returns true and fills `seq` on success, false if no sequence of at
+ *     most `LDI_MAX_COST` instructions was found.
+ * ------------------------------------------------------------------------- */
+bool materialize_constant(mword_t target, bool use_scratch, ldi_seq_t& seq);
+
+/* ------------------------------------------------------------------------- *
+ * Program rewriting helpers
+ * ------------------------------------------------------------------------- */
+// copies the parallel instruction vectors into rows, with origins set
+vector<inst_row_s> program_rows(const prog_s& prog);
+
+// copies a single row of the parallel instruction vectors
+inst_row_s program_rows(const prog_s& prog, unsigned i);
+
+// replaces the instruction list with `rows`, moving labels to their origins
+void rewrite_program(prog_s& prog, const vector<inst_row_s>& rows);
+
+// resolves the instruction index targeted by a B-type instruction, or -1
+int branch_target(const prog_s& prog, unsigned i);
+
+// replaces numeric branch offsets with hidden labels so they survive moves
+void anchor_branch_offsets(prog_s& prog);
+
+// finds or adds the hidden label naming an instruction index
+string anchor_label(prog_s& prog, unsigned target);
+
+// collects register/flag bitmasks (`FLAGS_BIT`) read and written by an inst
+void inst_regs(OPCODE opc, const inst_tokens_t& toks,
+    unsigned& uses, unsigned& defs);
+
+// finds the first instruction that reads or writes the PC, or -1
+int find_pc_inst(const prog_s& prog);
+
+// matches the pattern of `rule` at instruction `i`, mapping its variables
+//   to registers in `regs`, if what it doesn't keep is dead after it
+bool match_rule(const prog_s& prog, const peep_rule_s& rule, unsigned i,
+    const vector<bool>& is_target, const vector<unsigned>& live_after,
+    unsigned regs[MAX_REG]);
+
+// builds the instruction tokens of a rule instruction on registers `regs`
+inst_tokens_t rule_inst_tokens(const peep_inst_s& inst,
+    const unsigned regs[MAX_REG]);
+
+// computes the known bits of an ALU result and the carry it leaves
+known_bits_s known_alu(OPCODE opc, const known_bits_s& n,
+    const known_bits_s& m, const known_bits_s& carry, known_bits_s& carry_out);
+
+// finds the cheaper op computing a `MUL`, `DIV` or `MOD` by a power of two,
+//   with the operand it keeps (0 or 1) in `src` and its constant `amount`
+bool reduced_op(OPCODE opc, const known_bits_s& n, const known_bits_s& m,
+    OPCODE& red_opc, unsigned& src, mword_t& amount);
+
+// applies an instruction to the known register values and carry of `state`
+void const_step(const prog_s& prog, unsigned i, const_state_s& state);
+
+// joins `from` into `to`, keeping the bits known alike, true if `to` changed
+bool join_const_state(const_state_s& to, const const_state_s& from);
+
+// builds the known bits of a constant
+known_bits_s known_const(mword_t val);
+
+// checks if every bit of a value is known
+bool is_known(const known_bits_s& k);
+
+// finds the sorted indices that start basic blocks, `prog.insts.size()` last
+vector<unsigned> block_starts(const prog_s& prog);
+
+// checks if an instruction ends a basic block (branch, halt, PC write)
+bool ends_block(OPCODE opc, unsigned defs);
+
 /* ------------------------------------------------------------------------- *
  * Smaller helper functions
  * ------------------------------------------------------------------------- */
 // encodes an operand string into a register value
 bool encode_register(const string& str, mword_t& buf);
 
+// parses a 12-bit immediate token the same way `encode_program` does
+bool parse_immediate(const string& str, long long& val);
+
+// parses a 16-bit immediate (signed or unsigned decimal, hex or binary)
+bool parse_wide_immediate(const string& str, long long& val);
+
+// checks if a word survives sign-extension from an immediate field
+bool fits_imm(mword_t val);
+
+// looks up the mnemonic that an opcode is written with
+const string& opcode_mnemonic(OPCODE opc);
+
+// formats an encoded instruction the way the listing shows it
+string listing_str(const prog_s& prog, unsigned i);
+
+// formats the listing row of an instruction, with its address and notes
+string listing_row(const prog_s& prog, unsigned i);
+
+// decodes the opcode of an encoded instruction
+OPCODE decode_opcode(mword_t word);
+
+// looks up the cycle cost of an opcode in the pipeline model
+unsigned cycle_cost(OPCODE opc, const pipe_model_s& model);
+
+// builds a register operand token from a register number
+string reg_token(unsigned r);
+
+// appends to the listing note of a row, separating notes with `;`
+void add_note(string& note, const string& add);
+
+// builds the instruction tokens of a materialization step
+inst_tokens_t ldi_step_tokens(const ldi_step_s& step, const mword_t regs[2]);
+
 // converts a numerically encoded instruction to a hexadecimal string
 string to_hex_string(mword_t enc_inst, int bits_to_convert=WORD_SIZE);
 
 // checks label name against mnemonics, register formats, and illegal names
 bool is_reserved_name(const string& str);
 
+// checks and adds the labels extracted into `m` at `address`, naming data
+//   addresses when `is_data` is set
+bool parse_labels(const string& line_buf, const smatch& m, unsigned file_line,
+    unsigned address, bool is_data, prog_s& prog);
+
+// checks and adds a label at `address`, marking `line_buf` from `pos` on
+//   errors, naming a data address when `is_data` is set
+bool add_label(const string& label_raw_buf, const string& line_buf, int pos,
+    int len, unsigned file_line, unsigned address, bool is_data,
+    prog_s& prog);
+
+// name of the directive on `line` after any labels, uppercase, or empty if
+//   there is none (a cheap scan, without matching the whole line)
+string line_directive(const string& line);
+
+// parses a 16-bit number or the value of a symbol in `syms`
+bool symbol_value(const string& str, const map<string, long long>& syms,
+    long long& val);
+
+// lists the words of the operands `oprs` that can name symbols, with their
+//   positions (numbers and macro parameters are left out)
+vector<pair<string::size_type, string>> symbol_words(const string& oprs);
+
+// replaces the symbols of `syms` in the operands `oprs` by their values
+string substitute_symbols(const string& oprs,
+    const map<string, long long>& syms);
+
+// formats the source line of an instruction, with its macro body line
+string line_ref(const prog_s& prog, unsigned i);
+
+// takes back the instructions, labels and patched branches of a `-i` line
+void undo_repl_line(prog_s& prog, const repl_line_s& line,
+    map<string, vector<unsigned>>& pending);
+
 /* ------------------------------------------------------------------------- *
  * IO helper functions
  * ------------------------------------------------------------------------- */
 // validates and organizes command line options
 bool get_options(int argc, char** argv, prog_opts_s& opts);
 
+// parses a pipeline model option (`key=value,...`)
+bool parse_pipe_model(const string& str, pipe_model_s& model);
+
+// reads a profile file of `address count [taken]` lines
+bool read_profile(ifstream& in, profile_t& profile);
+
+// reads a rules file of `pattern => replacement : keeps vars` lines
+bool read_rules(ifstream& in, vector<peep_rule_s>& rules);
+
+// parses the `|` separated instructions of a rule, counting its variables
+bool parse_rule_insts(const string& str, vector<peep_inst_s>& insts,
+    unsigned& n_vars);
+
+// unmaps the files mapped by `.incbin`
+void unmap_data(prog_s& prog);
+
+// points the arrays of `obj` into its bytes, checking that they fit
+bool view_object(obj_file_s& obj, const char* bytes, size_t size);
+
+// unmaps an object mapped by `map_object`
+void unmap_object(obj_file_s& obj);
+
+// names the object a source file given to `-L` is assembled into
+string object_path(const string& src_file);
+
+// checks if a path names an object file (`.o`)
+bool is_object_path(const string& path);
+
+// hashes the options that change the code assembled for `-L` sources, with
+//   the size and modification time of the `-r` rules file
+uint64_t options_hash(const prog_opts_s& opts);
+
+// reads the modification time of a stat'd file in nanoseconds
+int64_t mtime_ns(const struct stat& st);
+
+// formats the file and line of an object word, with its macro body line
+string object_line_ref(const obj_file_s& obj, unsigned i);
+
+// splits a string on a delimiter
+vector<string> split_str(const string& str, char delim);
+
+// splits operands on commas (or spaces unless parsing strictly)
+vector<string> split_operands(const string& oprs, bool strict_parsing);
+
 // prints the help message upon failure to run
 void print_help();
 
@@ -407,69 +1289,509 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    // attempt to open input file
-    ifstream fin;
-    fin.open(opts.src_file);
-    if(fin.fail()) {
-        cerr << "Error: could not open source file '" << opts.src_file << "'" 
-             << endl;
+    // if `-i` option enabled, assemble lines as they are typed
+    if(opts.interactive_flag)
+        return run_interactive(opts) ? 0 : 1;
+
+    // when linking, the source file may be an object already
+    obj_file_s src_obj;
+    src_obj.path = opts.src_file;
+    const bool src_is_object = !opts.link_files.empty()
+        && (is_object_path(opts.src_file) || map_object(src_obj, true));
+    if(src_is_object && src_obj.hdr == nullptr && !map_object(src_obj))
         return 1;
-    }
 
-    // initialize data structures for parsing
+    // assemble source file
     prog_s prog;
+    prog.linking = opts.compile_flag || !opts.link_files.empty();
+    prog.relocatable = opts.compile_flag;
+    if(!src_is_object && !assemble_program(opts, opts.src_file, prog))
+        return 1;
 
-    // parse source file
-    bool parse_success = parse_program(fin, prog, opts.strict_flag);
-    if(!parse_success) {
-        cerr << "Error: failed to parse '" << opts.src_file
-             << "' into valid program, aborting..." 
+    // error: data can't be relocated
+    if(opts.compile_flag && !prog.data.empty()) {
+        cerr << "Error: data section of '" << opts.src_file << "' can't be "
+             << "placed in a relocatable object, only the source file of a "
+             << "link (`-L`) can have data"
              << endl;
         return 1;
     }
 
-    // close source file
-    fin.close();
-
-    // initialize data structures for encoding
-    vector<mword_t> mcode;
-
-    // encode parsed program
-    bool encode_success = encode_program(prog);
-    if(!encode_success) {
-        cerr << "Error: failed to encode '" << opts.src_file
-             << "' into valid program, aborting..." 
-             << endl;
-        return 1;
+    // if `-L` option enabled, link the source file and the listed files
+    vector<mword_t> image;
+    if(!opts.link_files.empty()) {
+        vector<obj_file_s> objs(1 + opts.link_files.size());
+        if(src_is_object)
+            objs[0] = src_obj;
+        else {
+            objs[0].path = opts.src_file;
+            build_object(prog, opts.src_file, options_hash(opts), objs[0].buf);
+            view_object(objs[0], objs[0].buf.data(), objs[0].buf.size());
+        }
+        bool link_success = true;
+        for(unsigned f=0; link_success && f<opts.link_files.size(); f++)
+            link_success = load_link_file(opts, opts.link_files[f], objs[1+f]);
+        link_success = link_success && link_objects(objs, image);
+        for(auto it=objs.begin(); it!=objs.end(); ++it)
+            unmap_object(*it);
+        if(!link_success) {
+            cerr << "Error: failed to link '" << opts.out_file
+                 << "', aborting..."
+                 << endl;
+            return 1;
+        }
+        // the source file is placed first, so only its branches changed
+        if(!src_is_object) {
+            copy(image.begin(), image.begin() + prog.mcode.size(),
+                prog.mcode.begin());
+        }
     }
 
     // attempt to open output file
     ofstream fout;
-    fout.open(opts.out_file);
+    fout.open(opts.out_file, opts.compile_flag ? ios::binary : ios::out);
     if(fout.fail()) {
         cerr << "Error: could not open destination file '" << opts.out_file 
              << "'" << endl;
         return 1;
     }
 
+    // listings and reports describe a source file
+    if(src_is_object && (opts.list_flag || opts.cfg_report_flag
+            || opts.cfg_dot_file || opts.cfg_json_file)) {
+        cerr << "Warning: '" << opts.src_file << "' is an object, so it has "
+             << "no listing or control-flow graph"
+             << endl;
+    }
+
     // if `-l` option enabled, write program listing
-    if(opts.list_flag)
+    if(opts.list_flag && !src_is_object)
         print_program_listing(prog);
 
-    // write encoded program to source file
-    write_program(fout, prog);
+    // if `-R cfg`, `-g` or `-j` options enabled, analyze control flow
+    if(!src_is_object && (opts.cfg_report_flag || opts.cfg_dot_file
+            || opts.cfg_json_file)) {
+        cfg_s cfg;
+        build_cfg(prog, opts.pipe_model, cfg);
+        if(opts.cfg_report_flag)
+            print_cfg_report(prog, cfg);
+        const char* files[2] = { opts.cfg_dot_file, opts.cfg_json_file };
+        for(unsigned f=0; f<2; f++) {
+            if(files[f] == nullptr)
+                continue;
+            ofstream fcfg;
+            fcfg.open(files[f]);
+            if(fcfg.fail()) {
+                cerr << "Error: could not open control-flow graph file '"
+                     << files[f] << "'" << endl;
+                return 1;
+            }
+            if(f == 0)
+                write_cfg_dot(fcfg, prog, cfg);
+            else
+                write_cfg_json(fcfg, prog, cfg);
+            fcfg.close();
+        }
+    }
+
+    // write relocatable object, linked image or encoded program
+    if(opts.compile_flag) {
+        string buf;
+        build_object(prog, opts.src_file, options_hash(opts), buf);
+        fout.write(buf.data(), buf.size());
+    }
+    else {
+        if(!opts.link_files.empty())
+            prog.mcode = image;
+        write_program(fout, prog);
+    }
 
     // close destination file
     fout.close();
 
-    return 0;
-}
-
+    // write data image next to the instruction image if there is any data
+    if(opts.data_file != nullptr || !prog.data.empty()) {
+        const string data_file = opts.data_file != nullptr ? opts.data_file
+            : string(opts.out_file) + ".data";
+        ofstream fdata;
+        fdata.open(data_file);
+        if(fdata.fail()) {
+            cerr << "Error: could not open data file '" << data_file << "'"
+                 << endl;
+            return 1;
+        }
+        write_data(fdata, prog);
+        fdata.close();
+    }
+    unmap_data(prog);
+
+    return 0;
+}
+
 
 /* ========================================================================= *
  * Function Declarations
  * ========================================================================= */
 
+/* ------------------------------------------------------------------------- *
+ * assemble_program
+ * - Parses `src_file` and runs the optimization passes and reports of
+ *     `opts` over it, then encodes its instructions and data into `prog`.
+ * - Returns false (after printing why) if any step fails.
+ * ------------------------------------------------------------------------- */
+bool assemble_program(const prog_opts_s& opts, const char* src_file,
+        prog_s& prog) {
+    // attempt to open input file
+    ifstream fin;
+    fin.open(src_file);
+    if(fin.fail()) {
+        cerr << "Error: could not open source file '" << src_file << "'" 
+             << endl;
+        return false;
+    }
+
+    // parse source file, with the `-D` symbols defined
+    prog.equs = opts.defines;
+    bool parse_success = parse_program(fin, prog, opts.strict_flag);
+    if(!parse_success) {
+        cerr << "Error: failed to parse '" << src_file
+             << "' into valid program, aborting..." 
+             << endl;
+        return false;
+    }
+
+    // close source file
+    fin.close();
+
+    // if `-O layout` option enabled, reorder blocks by the profile
+    if(opts.layout_flag) {
+        ifstream fprof;
+        fprof.open(opts.profile_file);
+        if(fprof.fail()) {
+            cerr << "Error: could not open profile file '" << opts.profile_file
+                 << "'" << endl;
+            return false;
+        }
+        profile_t profile;
+        unsigned n_moved = 0, n_inverted = 0;
+        if(!read_profile(fprof, profile)
+                || !layout_program(prog, profile, opts.entry_labels, n_moved,
+                    n_inverted)) {
+            cerr << "Error: failed to lay out '" << src_file
+                 << "' by profile '" << opts.profile_file << "', aborting..."
+                 << endl;
+            return false;
+        }
+        fprof.close();
+        if(n_moved > 0 || n_inverted > 0) {
+            cerr << "Moved " << n_moved << " block"
+                 << (n_moved == 1 ? "" : "s") << " and inverted " << n_inverted
+                 << " branch" << (n_inverted == 1 ? "" : "es") << " in '"
+                 << src_file << "'"
+                 << endl;
+        }
+    }
+
+    // if `-O peep` option enabled, rewrite sequences by the rules file
+    if(opts.peep_flag) {
+        ifstream frules;
+        frules.open(opts.rules_file);
+        if(frules.fail()) {
+            cerr << "Error: could not open rules file '" << opts.rules_file
+                 << "'" << endl;
+            return false;
+        }
+        vector<peep_rule_s> rules;
+        if(!read_rules(frules, rules)) {
+            cerr << "Error: failed to read rules file '" << opts.rules_file
+                 << "', aborting..."
+                 << endl;
+            return false;
+        }
+        frules.close();
+        unsigned n_rewritten = 0;
+        peephole_program(prog, rules, n_rewritten);
+        if(n_rewritten > 0) {
+            cerr << "Rewrote " << n_rewritten << " sequence"
+                 << (n_rewritten == 1 ? "" : "s") << " by peephole rules in '"
+                 << src_file << "'"
+                 << endl;
+        }
+    }
+
+    // if `-O const` option enabled, fold and reduce by known constants
+    if(opts.const_flag) {
+        unsigned n_folded = 0, n_reduced = 0;
+        propagate_constants(prog, opts.pipe_model, n_folded, n_reduced);
+        if(n_folded > 0 || n_reduced > 0) {
+            cerr << "Folded " << n_folded << " instruction"
+                 << (n_folded == 1 ? "" : "s") << " and reduced " << n_reduced
+                 << " by known constants in '" << src_file << "'"
+                 << endl;
+        }
+    }
+
+    // if `-O dead` or `-R dead` options enabled, find dead writes
+    if(opts.dead_flag || opts.dead_report_flag) {
+        unsigned n_removed = 0;
+        eliminate_dead_writes(prog, opts.dead_flag, opts.dead_report_flag,
+            n_removed);
+        if(n_removed > 0) {
+            cerr << "Removed " << n_removed << " dead write"
+                 << (n_removed == 1 ? "" : "s") << " in '" << src_file
+                 << "'"
+                 << endl;
+        }
+    }
+
+    // if `-O clc` or `-R carry` options enabled, track the carry flag
+    if(opts.clc_flag || opts.carry_report_flag) {
+        unsigned n_removed = 0;
+        track_carry(prog, opts.clc_flag, opts.carry_report_flag, n_removed);
+        if(n_removed > 0) {
+            cerr << "Removed " << n_removed << " redundant CLC"
+                 << (n_removed == 1 ? "" : "s") << " in '" << src_file
+                 << "'"
+                 << endl;
+        }
+    }
+
+    // if `-O sched` or `-R hazards` options enabled, schedule program
+    if(opts.sched_flag || opts.hazard_report_flag) {
+        schedule_program(prog, opts.pipe_model, opts.sched_flag,
+            opts.hazard_report_flag);
+    }
+
+    // if `-b` option enabled, relax out-of-range branches
+    if(opts.relax_flag) {
+        unsigned n_relaxed = 0;
+        bool relax_success = relax_branches(prog, opts.relax_reg,
+            opts.relax_use_scratch, opts.relax_scratch_reg, n_relaxed);
+        if(!relax_success) {
+            cerr << "Error: failed to relax branches in '" << src_file
+                 << "', aborting..."
+                 << endl;
+            return false;
+        }
+        if(n_relaxed > 0) {
+            cerr << "Relaxed " << n_relaxed << " branch"
+                 << (n_relaxed == 1 ? "" : "es") << " in '" << src_file
+                 << "' (" << prog.insts.size() << " instructions)"
+                 << endl;
+        }
+    }
+
+    // encode parsed program
+    bool encode_success = encode_program(prog);
+    if(!encode_success) {
+        cerr << "Error: failed to encode '" << src_file
+             << "' into valid program, aborting..." 
+             << endl;
+        return false;
+    }
+
+    // encode data section
+    bool encode_data_success = encode_data(prog);
+    if(!encode_data_success) {
+        cerr << "Error: failed to encode data of '" << src_file
+             << "', aborting..."
+             << endl;
+        return false;
+    }
+
+    // signal success
+    return true;
+}
+
+/* ------------------------------------------------------------------------- *
+ * run_interactive
+ * - Assembles lines from standard input as they are typed (`-i`), keeping
+ *     a single `prog_s` and printing the listing row of each instruction.
+ * - Branches to labels that aren't defined yet wait in `pending` and are
+ *     encoded once a later line defines the label.
+ * - Lines starting with `:` are commands:
+ *   - `:undo` takes back the last line, along with the branches it patched
+ *   - `:save [file]` writes the Logisim image (default: the object file)
+ *   - `:list` prints the full listing, `:help` the commands, `:quit` exits
+ * - Returns false if any line or command failed, so scripted sessions can
+ *     check for errors.
+ * ------------------------------------------------------------------------- */
+bool run_interactive(const prog_opts_s& opts) {
+    // set up session vars
+    // ---------------------------------------------------------------------
+    prog_s prog;
+    vector<repl_line_s> history;
+    map<string, vector<unsigned>> pending;
+    const map<string, macro_s> macros;
+    unsigned n_expanded = 0;
+    bool success = true;
+    string line_buf;
+    smatch m;
+    const bool prompt = isatty(STDIN_FILENO);
+
+    if(prompt)
+        cout << "alarmas interactive mode, `:help` lists commands" << endl;
+    while(true) {
+        if(prompt) {
+            cout << "0x" << to_hex_string(prog.insts.size(), IMM) << "> "
+                 << flush;
+        }
+        if(!getline(cin, line_buf))
+            break;
+        trim_head(trim_tail(line_buf));
+        if(line_buf.empty() || line_buf[0] == ';')
+            continue;
+
+        // run commands
+        // -----------------------------------------------------------------
+        if(line_buf[0] == ':') {
+            const string::size_type cmd_end = line_buf.find_first_of(" \t");
+            const string cmd = line_buf.substr(1, cmd_end - 1);
+            string arg = cmd_end == string::npos ? ""
+                : line_buf.substr(cmd_end);
+            trim_head(arg);
+            if(cmd == "quit" || cmd == "q")
+                break;
+            else if(cmd == "help") {
+                cout << "  :undo         take back the last line" << endl
+                     << "  :save [file]  write the Logisim image" << endl
+                     << "  :list         print the full listing" << endl
+                     << "  :quit         leave (without saving)" << endl;
+            }
+            else if(cmd == "list")
+                print_program_listing(prog);
+            else if(cmd == "undo") {
+                // error: empty history
+                if(history.empty()) {
+                    cerr << "Error: nothing to undo" << endl;
+                    success = false;
+                    continue;
+                }
+                undo_repl_line(prog, history.back(), pending);
+                cout << "undid line " << history.size() << ": "
+                     << history.back().src << endl;
+                history.pop_back();
+            }
+            else if(cmd == "save") {
+                const char* path = arg.empty() ? opts.out_file : arg.c_str();
+                // error: nowhere to save, or unresolved branches
+                if(path == nullptr || !pending.empty()) {
+                    cerr << "Error: could not save, ";
+                    if(path == nullptr)
+                        cerr << "expected `:save file`";
+                    else {
+                        cerr << "branches wait for " << pending.size()
+                             << " undefined label"
+                             << (pending.size() == 1 ? "" : "s") << ":";
+                        auto it = pending.begin();
+                        for(unsigned n=0; n<5 && it!=pending.end(); n++, ++it)
+                            cerr << " '" << it->first << "'";
+                        if(it != pending.end())
+                            cerr << " ...";
+                    }
+                    cerr << endl;
+                    success = false;
+                    continue;
+                }
+                ofstream fout;
+                fout.open(path);
+                if(fout.fail()) {
+                    cerr << "Error: could not open destination file '" << path
+                         << "'" << endl;
+                    success = false;
+                    continue;
+                }
+                write_program(fout, prog);
+                fout.close();
+                cout << "saved " << prog.mcode.size() << " instruction"
+                     << (prog.mcode.size() == 1 ? "" : "s") << " to '"
+                     << path << "'" << endl;
+            }
+            else {
+                cerr << "Error: unrecognized command ':" << cmd
+                     << "', `:help` lists commands" << endl;
+                success = false;
+            }
+            continue;
+        }
+
+        // error: directives need passes over the whole file
+        const unsigned file_line = history.size() + 1;
+        if(regex_match(line_buf, m, directive_re)) {
+            cerr << "Error: line[" << file_line << "]: "
+                 << "directive '." << m[2].str() << "' isn't supported in "
+                 << "interactive mode:"
+                 << endl;
+            line_error_marker(line_buf, m.position(2)-1, m[2].length()+1);
+            success = false;
+            continue;
+        }
+
+        // parse the line onto the program and encode its instructions,
+        //   leaving branches to labels that aren't defined yet
+        // -----------------------------------------------------------------
+        repl_line_s line = { line_buf, static_cast<unsigned>(
+            prog.insts.size()), static_cast<unsigned>(prog.labels.size()),
+            {} };
+        bool line_success = parse_inst_line(line_buf, file_line,
+            opts.strict_flag, macros, n_expanded, prog);
+        prog.mcode.resize(prog.insts.size());
+        for(unsigned i=line.n_insts; line_success && i<prog.insts.size();
+                i++) {
+            const inst_tokens_t& toks = prog.insts[i].second;
+            if(OPC_TO_FMT.at(prog.insts[i].first) == B_TYPE
+                    && prog.label_lookup.count(toks[1]) == 0
+                    && regex_match(toks[1], data_label_re)
+                    && is_reserved_name(toks[1])) {
+                pending[toks[1]].push_back(i);
+                prog.mcode[i] = prog.insts[i].first;
+                prog.debug_notes[i] = REPL_PENDING_NOTE;
+            }
+            else
+                line_success = encode_inst(prog, i, prog.mcode[i]);
+        }
+
+        // patch the earlier branches to labels the line defined
+        // -----------------------------------------------------------------
+        for(unsigned l=line.n_labels; line_success && l<prog.labels.size();
+                l++) {
+            auto pt = pending.find(prog.labels[l].name);
+            if(pt == pending.end())
+                continue;
+            vector<unsigned> refs;
+            refs.swap(pt->second);
+            pending.erase(pt);
+            for(unsigned r=0; r<refs.size(); r++) {
+                line_success = encode_inst(prog, refs[r], prog.mcode[refs[r]]);
+                if(!line_success) {
+                    pending[prog.labels[l].name].assign(refs.begin()+r,
+                        refs.end());
+                    break;
+                }
+                prog.debug_notes[refs[r]] = "(patched by line "
+                    + to_string(file_line) + ")";
+                line.patched.push_back(refs[r]);
+            }
+        }
+        if(!line_success) {
+            undo_repl_line(prog, line, pending);
+            success = false;
+            continue;
+        }
+
+        // print the rows the line added or patched
+        // -----------------------------------------------------------------
+        for(unsigned i=line.n_insts; i<prog.insts.size(); i++)
+            cout << listing_row(prog, i) << endl;
+        for(auto it=line.patched.begin(); it!=line.patched.end(); ++it)
+            cout << listing_row(prog, *it) << endl;
+        history.push_back(line);
+    }
+
+    // signal success
+    return success;
+}
+
 /* ------------------------------------------------------------------------- *
  * parse_program
  * - First pass of input file, builds list of tokenized instructions
@@ -485,246 +1807,278 @@ int main(int argc, char** argv) {
 bool parse_program(ifstream& fin, prog_s& prog, bool strict_parsing) {
     // set up parsing vars
     // ---------------------------------------------------------------------
-    string label_buf;
-    string label_raw_buf;
     string line_buf;
-    string mne;
-    string oprs;
     smatch m;
-    smatch oprs_m;
-    inst_tokens_t inst_buf;
-    inst_tokens_t inst_raw_buf;
-    sregex_iterator reit_begin;
-    sregex_iterator reit_end;
-    OPCODE inst_opcode;
     unsigned file_line = 0;
+    bool in_data = false;
+    map<string, macro_s> macros;
+    macro_s macro_buf;
+    string macro_line_buf;
+    bool in_macro = false;
+    long long rept_count = 0;
+    unsigned n_expanded = 0;
+    map<string, pair<unsigned,string>> link_decls;
+
+    // read source lines, resolve conditional assembly, and lay out the
+    //   data section first, so instructions can use data labels from
+    //   anywhere in the file
+    // ---------------------------------------------------------------------
+    vector<string> src_lines;
+    while(getline(fin, line_buf))
+        src_lines.push_back(line_buf);
+    if(!preprocess_program(src_lines, strict_parsing, prog)
+            || !parse_data(src_lines, prog, strict_parsing))
+        return false;
 
     // parse file, line by line
     // ---------------------------------------------------------------------
-    while(getline(fin, line_buf)) {
+    for(auto line_it=src_lines.begin(); line_it!=src_lines.end(); ++line_it) {
+        line_buf = *line_it;
         trim_head(trim_tail(line_buf));
         file_line++;
 
-        // match line with instruction extractor
-        // -----------------------------------------------------------------
-        if(!regex_match(line_buf, m, extract_inst_re)) {
-            cerr << "Error: line[" << file_line << "]: "
-                 << "unparseable line, could not extract instruction. "
-                 << "This shouldn't happen, but it did, sorry:"
-                 << endl;
-            line_error_marker(line_buf, 0, line_buf.size());
-            return false;
-        }
-
-        // extract labels
+        // collect macro and `.rept` bodies, templating them at their end
         // -----------------------------------------------------------------
-        if(m[1].length() > 0) {
-            const string& labels = m[1].str();
-            reit_begin = sregex_iterator(
-                labels.begin(), labels.end(), label_re);
-            for(auto it=reit_begin; it!=reit_end; ++it) {
-                label_raw_buf = (*it)[1].str();
-                label_buf = str_to_upper(label_raw_buf);
-
-                // error: empty label
-                if(label_buf.size() == 0) {
-                    cerr << "Error: line[" << file_line << "]: "
-                         << "expected label name before ':', "
-                         << "but found empty string:"
-                         << endl;
-                    line_error_marker(line_buf, 
-                        m.position(1)+it->position(1), 1);
-                    return false;
-                }
-
-                // error: illegal label, reserved
-                if(!is_reserved_name(label_buf)) {
-                    cerr << "Error: line[" << file_line << "]: "
-                         << "illegal label name '"
-                         << label_raw_buf << "', reserved by ISA:"
-                         << endl;
-                    line_error_marker(line_buf, 
-                        m.position(1)+it->position(1), it->length());
-                    return false;
-                }
-
-                // error: invalid label (leading digit)
-                if(isdigit(label_buf[0])) {
-                    cerr << "Error: line[" << file_line << "]: "
-                         << "invalid label name '"
-                         << label_raw_buf << "', can't start with a digit:"
-                         << endl;
-                    line_error_marker(line_buf, 
-                        m.position(1)+it->position(1), it->length());
-                    return false;
-                }
-
-                // error: repeated label
-                if(prog.label_lookup.count(label_buf) != 0) {
-                    cerr << "Error: line[" << file_line << "]: "
-                         << "repeat instance of label '"
-                         << label_raw_buf << "':"
-                         << endl;
-                    line_error_marker(line_buf, 
-                        m.position(1)+it->position(1), it->length());
-                    return false;
-                }
-
-                // insert label list and lookup
-                mword_t target_addr = prog.insts.size();
-                prog.label_lookup[label_buf] = target_addr;
-                prog.labels.push_back({ label_buf, target_addr });
+        if(in_macro) {
+            const bool is_dir = regex_match(line_buf, m, directive_re);
+            const string dir = is_dir ? m[2].str() : "";
+            const string dir_key = str_to_upper(dir);
+            const bool is_rept = macro_buf.name.empty();
+            if(!is_dir) {
+                macro_buf.lines.push_back({ file_line, line_buf });
+                continue;
             }
-        }
-
-        // extract mnemonic
-        // -----------------------------------------------------------------
-        // error: line content with no mnemonic
-        if(m[2].length() == 0) {
-            if(m[3].length() > 0) {
+            // error: directive inside a body, or mismatched end directive
+            if((dir_key != "ENDM" && dir_key != "ENDR")
+                    || (dir_key == "ENDR") != is_rept) {
                 cerr << "Error: line[" << file_line << "]: "
-                     << "could not locate instruction mnemonic:"
+                     << "unexpected directive '." << dir << "' in "
+                     << (is_rept ? "'.rept' block starting on line "
+                        : "macro '" + macro_buf.name + "' starting on line ")
+                     << macro_buf.line_num << ", expected '."
+                     << (is_rept ? "endr" : "endm") << "':"
                      << endl;
-                line_error_marker(line_buf, 
-                    m.position(3), m[3].length());
+                line_error_marker(line_buf, m.position(2)-1, m[2].length()+1);
+                return false;
+            }
+            if(m[1].length() > 0)
+                macro_buf.lines.push_back({ file_line, m[1].str() });
+            in_macro = false;
+            if(!build_macro(macro_buf, macros, strict_parsing))
                 return false;
+            if(!is_rept) {
+                macros[macro_buf.name] = macro_buf;
+                continue;
+            }
+            for(long long r=0; r<rept_count; r++) {
+                if(!expand_macro(macro_buf, {}, macro_line_buf,
+                        macro_buf.line_num, n_expanded, prog))
+                    return false;
             }
+            continue;
         }
-        else {
-            mne = m[2].str();
-            string mne_key = str_to_upper(mne);
 
-            // check for psuedo-instruction
+        // follow sections, the data section was laid out by `parse_data`
+        // -----------------------------------------------------------------
+        if(regex_match(line_buf, m, directive_re)) {
+            const string dir = m[2].str();
+            const string dir_key = str_to_upper(dir);
+            if(dir_key == "DATA" || dir_key == "TEXT")
+                in_data = dir_key == "DATA";
+            if(dir_key == "TEXT" && !parse_labels(line_buf, m, file_line,
+                    prog.insts.size(), false, prog))
+                return false;
+
+            // declare labels shared with other objects
             // -------------------------------------------------------------
-            if(PSUEDO_ISA.count(mne_key)) {
-                // error: invalid format for psuedo-instruction
-                //        - should be empty string
-                oprs = m[3].str();
+            if(LINK_DIRECTIVES.count(dir_key)) {
+                string oprs = m[3].str();
                 trim_tail(oprs);
-                if(oprs.size() > 0) {
+                const vector<string> toks = split_operands(oprs,
+                    strict_parsing);
+                // error: linked labels are instruction labels
+                if(in_data || toks.empty()) {
                     cerr << "Error: line[" << file_line << "]: "
-                         << "invalid format for psuedoinstruction '"
-                         << mne << "', expected no operands:"
+                         << "directive '." << dir << "' "
+                         << (in_data ? "in data section, expected '.text' "
+                            "before it:" : "expects a list of labels:")
                          << endl;
-                    line_error_marker(line_buf, 
-                        m.position(3), m[3].length());
+                    line_error_marker(line_buf, m.position(2)-1,
+                        m[2].length()+1);
                     return false;
                 }
-
-                // replace line_buf and re-extract
-                string comment = m[4].str();
-                string psuedo_buf = "";
-                if(m[1].length())
-                    psuedo_buf += m[1].str() + " ";
-                psuedo_buf = PSUEDO_ISA.at(mne_key) + " ; (from "
-                            + mne_key + ")";
-                if(m[4].length()) {
-                    string comment = m[4].str().substr(1);
-                    trim_head(comment);
-                    psuedo_buf += " " + comment;
-                }
-                line_buf = psuedo_buf;
-
-                // error: failed psuedo-instruction conversion
-                if(!regex_match(line_buf, m, extract_inst_re)) {
-                    cerr << "Error: line[" << file_line << "]: "
-                         << "psuedo-instruction conversion failed, "
-                         << "unknown cause, report to maintainer:"
-                         << endl;
-                    line_error_marker(line_buf, 0, line_buf.size());
-                    return false;
+                for(auto it=toks.begin(); it!=toks.end(); ++it) {
+                    const string key = str_to_upper(*it);
+                    const bool is_global = dir_key == "GLOBAL";
+                    const bool conflict = is_global
+                        ? prog.extern_labels.count(key) > 0
+                        : prog.global_labels.count(key) > 0;
+                    // error: invalid or conflicting label name
+                    if(!regex_match(key, data_label_re)
+                            || !is_reserved_name(key) || conflict) {
+                        cerr << "Error: line[" << file_line << "]: "
+                             << "invalid label name '" << *it << "' for "
+                             << "directive '." << dir << "'"
+                             << (conflict ? string(", already declared '.")
+                                + (is_global ? "extern" : "global") + "'"
+                                : "")
+                             << ":"
+                             << endl;
+                        line_error_marker(line_buf, m.position(3),
+                            oprs.length());
+                        return false;
+                    }
+                    (is_global ? prog.global_labels : prog.extern_labels)
+                        .insert(key);
+                    link_decls[key] = { file_line, line_buf };
                 }
-
-                // re-set mne and mne_key
-                mne = m[2].str();
-                mne_key = str_to_upper(mne);
+                continue;
             }
 
-            // error: invalid mnemonic
-            if(ISA.count(mne_key) == 0) {
+            // error: end directive without a body
+            if(dir_key == "ENDM" || dir_key == "ENDR") {
                 cerr << "Error: line[" << file_line << "]: "
-                     << "invalid mnemonic '" << mne << "':"
+                     << "directive '." << dir << "' without a matching '."
+                     << (dir_key == "ENDM" ? "macro" : "rept") << "':"
                      << endl;
-                line_error_marker(line_buf, 
-                    m.position(2), m[2].length());
+                line_error_marker(line_buf, m.position(2)-1, m[2].length()+1);
                 return false;
             }
 
-            // grab mnemonic configs
-            const vector<OPCODE>& mne_opcodes = ISA.at(mne_key);
-
-            // extract operands
+            // start collecting a macro or `.rept` body
             // -------------------------------------------------------------
-            oprs = m[3];
-            trim_tail(oprs);
-
-            // iterate over and test all regex for instruction format
-            bool found_matching_fmt = false;
-            for(auto it=mne_opcodes.begin(); 
-                    !found_matching_fmt && it!=mne_opcodes.end();
-                    ++it) {
-                // choose between strict and relaxed parsing
-                regex fmt_re = strict_parsing 
-                    ? FMT_REGEX_STRICT[OPC_TO_FMT.at(*it)] 
-                    : FMT_REGEX[OPC_TO_FMT.at(*it)];
-
-                // perform regex match
-                if(regex_match(oprs, oprs_m, fmt_re)) {
-                    found_matching_fmt = true;
-                    inst_opcode = *it;
+            if(dir_key == "MACRO" || dir_key == "REPT") {
+                string oprs = m[3].str();
+                trim_tail(oprs);
+                // a macro name is followed by whitespace, then parameters
+                vector<string> toks;
+                if(dir_key == "MACRO" && !oprs.empty()) {
+                    const string::size_type name_end
+                        = oprs.find_first_of(" \t");
+                    string params = name_end == string::npos ? ""
+                        : oprs.substr(name_end);
+                    trim_head(params);
+                    toks = split_operands(params, strict_parsing);
+                    toks.insert(toks.begin(), oprs.substr(0, name_end));
                 }
-            }
-
-            // error: no valid operand format for mnemonic
-            if(!found_matching_fmt) {
-                cerr << "Error: line[" << file_line << "]: "
-                     << "could not match operand format for mnemonic '"
-                     << mne << "':"
-                     << endl;
-                line_error_marker(line_buf, m.position(3), oprs.length());
-                cerr << "--- Expected " 
-                     << (mne_opcodes.size() > 1 
-                        ? "one of the following formats:"
-                        : "the following format:") << endl;
-                for(auto it=mne_opcodes.begin(); 
-                        it!=mne_opcodes.end(); 
-                        ++it) {
-                    auto& expected_strs = FMT_EXPECTED[OPC_TO_FMT.at(*it)]; 
-                    for(auto jt=expected_strs.begin(); 
-                            jt!=expected_strs.end(); 
-                            ++jt) {
-                        cerr << "-----> " << mne << (*jt) << endl;
+                else
+                    toks = split_operands(oprs, strict_parsing);
+                macro_buf = macro_s();
+                macro_buf.line_num = file_line;
+                macro_line_buf = line_buf;
+                if(dir_key == "REPT") {
+                    // error: `.rept` outside of the text section
+                    if(in_data) {
+                        cerr << "Error: line[" << file_line << "]: "
+                             << "directive '." << dir << "' in data section, "
+                             << "expected '.text' before it:"
+                             << endl;
+                        line_error_marker(line_buf, m.position(2)-1,
+                            m[2].length()+1);
+                        return false;
+                    }
+                    // error: invalid repeat count
+                    if(toks.size() != 1
+                            || !parse_wide_immediate(str_to_upper(
+                                substitute_symbols(toks[0], prog.equs)),
+                                rept_count)
+                            || rept_count < 0 || rept_count > MAX_INST) {
+                        cerr << "Error: line[" << file_line << "]: "
+                             << "invalid format for directive '." << dir
+                             << "', expected a repeat count from 0 to "
+                             << MAX_INST << ":"
+                             << endl;
+                        line_error_marker(line_buf, m.position(3),
+                            oprs.length());
+                        return false;
                     }
+                    if(!parse_labels(line_buf, m, file_line,
+                            prog.insts.size(), false, prog))
+                        return false;
                 }
-                return false;
+                else {
+                    // error: missing, reserved, or repeated macro name, or
+                    //        malformed parameters
+                    for(unsigned t=0; t<toks.size(); t++) {
+                        const string key = str_to_upper(toks[t]);
+                        const bool reserved = !is_reserved_name(key)
+                            || PSUEDO_ISA.count(key) > 0;
+                        const bool repeated = t == 0 ? macros.count(key) > 0
+                            : find(macro_buf.params.begin(),
+                                macro_buf.params.end(), key)
+                                != macro_buf.params.end();
+                        if(!regex_match(key, data_label_re)
+                                || (t == 0 && (reserved || repeated))
+                                || (t > 0 && repeated)) {
+                            cerr << "Error: line[" << file_line << "]: "
+                                 << "invalid " << (t ? "parameter" : "macro")
+                                 << " name '" << toks[t] << "'"
+                                 << (repeated ? ", already defined"
+                                    : (t == 0 && reserved
+                                        ? ", reserved by ISA" : ""))
+                                 << ":"
+                                 << endl;
+                            line_error_marker(line_buf, m.position(3),
+                                oprs.length());
+                            return false;
+                        }
+                        if(t == 0)
+                            macro_buf.name = key;
+                        else
+                            macro_buf.params.push_back(key);
+                    }
+                    if(toks.empty()) {
+                        cerr << "Error: line[" << file_line << "]: "
+                             << "invalid format for directive '." << dir
+                             << "', expected a macro name:"
+                             << endl;
+                        line_error_marker(line_buf, 0, line_buf.size());
+                        return false;
+                    }
+                }
+                in_macro = true;
             }
+            continue;
+        }
+        if(in_data)
+            continue;
 
-            // extract tokenized operands from matched format
-            // -------------------------------------------------------------
-            inst_buf.clear();
-            inst_buf.push_back(mne_key);
-            inst_raw_buf.clear();
-            inst_raw_buf.push_back(mne);
-            for(auto it=oprs_m.begin()+1; it!=oprs_m.end(); ++it) {
-                inst_buf.push_back(str_to_upper(*it));
-                inst_raw_buf.push_back(*it);
-            }
+        // parse instructions of the text section
+        // -----------------------------------------------------------------
+        if(!parse_inst_line(line_buf, file_line, strict_parsing, macros,
+                n_expanded, prog))
+            return false;
+    }
 
-            // push onto instruction list
-            // -------------------------------------------------------------
-            prog.insts.emplace_back(inst_opcode, inst_buf);
-            prog.insts_raw.push_back(inst_raw_buf);
-            prog.debug_line_nums.push_back(file_line);
+    // error: unterminated macro or `.rept` body
+    if(in_macro) {
+        cerr << "Error: line[" << macro_buf.line_num << "]: "
+             << (macro_buf.name.empty() ? string("'.rept' block")
+                : "macro '" + macro_buf.name + "'")
+             << " is never closed, expected '."
+             << (macro_buf.name.empty() ? "endr" : "endm") << "':"
+             << endl;
+        line_error_marker(macro_line_buf, 0, macro_line_buf.size());
+        return false;
+    }
 
-            // error: instruction overflow
-            if(prog.insts.size() > MAX_INST) {
-                cerr << "Error: line[" << file_line << "]: "
-                     << "instruction count exceeds limit (" 
-                     << "max = " << MAX_INST << ")" 
-                     << endl;
-                return false;
-            }
-        }
+    // error: global labels need a definition, extern labels can't have one
+    for(auto it=link_decls.begin(); it!=link_decls.end(); ++it) {
+        const bool is_global = prog.global_labels.count(it->first) > 0;
+        const bool is_label = prog.label_lookup.count(it->first) > 0;
+        const bool is_data = prog.data_lookup.count(it->first) > 0;
+        if(is_global ? is_label : !is_label && !is_data)
+            continue;
+        cerr << "Error: line[" << it->second.first << "]: "
+             << (is_global ? "global" : "extern") << " label '" << it->first
+             << "' " << (!is_global ? "is defined in this file"
+                : is_data ? "names data, only instruction labels can be "
+                    "global"
+                : "is never defined")
+             << ":"
+             << endl;
+        line_error_marker(it->second.second, 0, it->second.second.size());
+        return false;
     }
 
     // cull out-of-bounds labels 
@@ -740,233 +2094,4399 @@ bool parse_program(ifstream& fin, prog_s& prog, bool strict_parsing) {
 }
 
 /* ------------------------------------------------------------------------- *
- * encode_program
- * - Second pass of input file, encodes tokenized instructions into their
- *     appropriate hex machine code representation to build `prog.mcode`.
+ * parse_inst_line
+ * - Parses a single (trimmed) line of the text section into `prog`, adding
+ *     its labels and the instructions of its mnemonic, psuedo-instruction,
+ *     `LDI` or use of one of `macros`.
+ * - Shared by `parse_program` and the interactive assembler.
  * - Returns true upon succesful completion.
- * - Returns false if any operand cannot be encoded.
+ * - Returns false if some syntax error is found.
  * ------------------------------------------------------------------------- */
-bool encode_program(prog_s& prog) {
-    // loop through parsed instruction list, encoding each instruction
+bool parse_inst_line(string line_buf, unsigned file_line,
+        bool strict_parsing, const map<string, macro_s>& macros,
+        unsigned& n_expanded, prog_s& prog) {
+    smatch m;
+    smatch oprs_m;
+    string mne;
+    string oprs;
+    inst_tokens_t inst_buf;
+    inst_tokens_t inst_raw_buf;
+    OPCODE inst_opcode = NOP;
+
+    // match line with instruction extractor
     // ---------------------------------------------------------------------
-    for(unsigned i=0; i<prog.insts.size(); i++) {
-        // fetch instruction opcode, tokens, and format
-        // -----------------------------------------------------------------
-        const OPCODE inst_opcode = prog.insts[i].first;
-        inst_tokens_t& inst_toks = prog.insts[i].second;
-        const inst_tokens_t& inst_raw_toks = prog.insts_raw[i];
-        const I_FMT inst_fmt = OPC_TO_FMT.at(inst_opcode);
-        const fmt_config_t fmt_config = FMT_CONFIG[inst_fmt];
+    if(!regex_match(line_buf, m, extract_inst_re)) {
+        cerr << "Error: line[" << file_line << "]: "
+             << "unparseable line, could not extract instruction. "
+             << "This shouldn't happen, but it did, sorry:"
+             << endl;
+        line_error_marker(line_buf, 0, line_buf.size());
+        return false;
+    }
 
-        // init encoded instruction buffer with the opcode set
-        // -----------------------------------------------------------------
-        mword_t enc_inst_buf = inst_opcode;
+    // extract labels
+    // ---------------------------------------------------------------------
+    if(!parse_labels(line_buf, m, file_line, prog.insts.size(), false,
+            prog))
+        return false;
+
+    // extract mnemonic
+    // ---------------------------------------------------------------------
+    // error: line content with no mnemonic
+    if(m[2].length() == 0) {
+        if(m[3].length() > 0) {
+            cerr << "Error: line[" << file_line << "]: "
+                 << "could not locate instruction mnemonic:"
+                 << endl;
+            line_error_marker(line_buf, 
+                m.position(3), m[3].length());
+            return false;
+        }
+    }
+    else {
+        mne = m[2].str();
+        string mne_key = str_to_upper(mne);
 
-        // iterate through operands, encode them, then add them to buffer
+        // check for macro use
         // -----------------------------------------------------------------
-        for(unsigned o=0; o<fmt_config.size(); o++) {
-            string& opr_str = inst_toks[1+o];
-            string opr_str_key = str_to_upper(opr_str);
-            // encode operand based on OPR_WIDTH for given instruction
-            auto opr_p = fmt_config[o].first;
-            auto opr_w = fmt_config[o].second;
-            mword_t opr_buf = 0;
-            if(opr_w == REG) {
-                // encode register
-                // error unknown register
-                if(!encode_register(opr_str, opr_buf)) {
-                    cerr << "Error: line[" << prog.debug_line_nums[i]
-                         << "]: could not encode " << ordinal_str(o+1)
-                         << " operand '" << opr_str
-                         << "', expected register between 'r0' and 'r"
-                         << MAX_REG << "':" 
+        if(macros.count(mne_key)) {
+            const macro_s& macro = macros.at(mne_key);
+            oprs = m[3].str();
+            trim_tail(oprs);
+            const vector<string> args = split_operands(oprs,
+                strict_parsing);
+            // error: wrong argument count
+            if(args.size() != macro.params.size()) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "macro '" << mne << "' expects "
+                     << macro.params.size() << " argument"
+                     << (macro.params.size() == 1 ? "" : "s")
+                     << ", but found " << args.size() << ":"
+                     << endl;
+                line_error_marker(line_buf,
+                    m.position(3), m[3].length());
+                return false;
+            }
+            if(!expand_macro(macro, args, line_buf, file_line,
+                    n_expanded, prog))
+                return false;
+            return true;
+        }
+
+        // check for psuedo-instruction
+        // -----------------------------------------------------------------
+        if(PSUEDO_ISA.count(mne_key)) {
+            // error: invalid format for psuedo-instruction
+            //        - should be empty string
+            oprs = m[3].str();
+            trim_tail(oprs);
+            if(oprs.size() > 0) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "invalid format for psuedoinstruction '"
+                     << mne << "', expected no operands:"
+                     << endl;
+                line_error_marker(line_buf, 
+                    m.position(3), m[3].length());
+                return false;
+            }
+
+            // replace line_buf and re-extract
+            string comment = m[4].str();
+            string psuedo_buf = "";
+            if(m[1].length())
+                psuedo_buf += m[1].str() + " ";
+            psuedo_buf = PSUEDO_ISA.at(mne_key) + " ; (from "
+                        + mne_key + ")";
+            if(m[4].length()) {
+                string comment = m[4].str().substr(1);
+                trim_head(comment);
+                psuedo_buf += " " + comment;
+            }
+            line_buf = psuedo_buf;
+
+            // error: failed psuedo-instruction conversion
+            if(!regex_match(line_buf, m, extract_inst_re)) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "psuedo-instruction conversion failed, "
+                     << "unknown cause, report to maintainer:"
+                     << endl;
+                line_error_marker(line_buf, 0, line_buf.size());
+                return false;
+            }
+
+            // re-set mne and mne_key
+            mne = m[2].str();
+            mne_key = str_to_upper(mne);
+        }
+
+        // check for constant materialization psuedo-instruction
+        // -----------------------------------------------------------------
+        if(mne_key == LDI_MNEMONIC) {
+            if(!parse_ldi(line_buf, m, file_line, strict_parsing, prog))
+                return false;
+            return true;
+        }
+
+        // error: invalid mnemonic
+        if(ISA.count(mne_key) == 0) {
+            cerr << "Error: line[" << file_line << "]: "
+                 << "invalid mnemonic '" << mne << "':"
+                 << endl;
+            line_error_marker(line_buf, 
+                m.position(2), m[2].length());
+            return false;
+        }
+
+        // grab mnemonic configs
+        const vector<OPCODE>& mne_opcodes = ISA.at(mne_key);
+
+        // extract operands
+        // -----------------------------------------------------------------
+        oprs = m[3];
+        trim_tail(oprs);
+
+        // iterate over and test all regex for instruction format
+        bool found_matching_fmt = false;
+        for(auto it=mne_opcodes.begin(); 
+                !found_matching_fmt && it!=mne_opcodes.end();
+                ++it) {
+            // choose between strict and relaxed parsing
+            regex fmt_re = strict_parsing 
+                ? FMT_REGEX_STRICT[OPC_TO_FMT.at(*it)] 
+                : FMT_REGEX[OPC_TO_FMT.at(*it)];
+
+            // perform regex match
+            if(regex_match(oprs, oprs_m, fmt_re)) {
+                found_matching_fmt = true;
+                inst_opcode = *it;
+            }
+        }
+
+        // error: no valid operand format for mnemonic
+        if(!found_matching_fmt) {
+            cerr << "Error: line[" << file_line << "]: "
+                 << "could not match operand format for mnemonic '"
+                 << mne << "':"
+                 << endl;
+            line_error_marker(line_buf, m.position(3), oprs.length());
+            cerr << "--- Expected " 
+                 << (mne_opcodes.size() > 1 
+                    ? "one of the following formats:"
+                    : "the following format:") << endl;
+            for(auto it=mne_opcodes.begin(); 
+                    it!=mne_opcodes.end(); 
+                    ++it) {
+                auto& expected_strs = FMT_EXPECTED[OPC_TO_FMT.at(*it)]; 
+                for(auto jt=expected_strs.begin(); 
+                        jt!=expected_strs.end(); 
+                        ++jt) {
+                    cerr << "-----> " << mne << (*jt) << endl;
+                }
+            }
+            return false;
+        }
+
+        // extract tokenized operands from matched format
+        // -----------------------------------------------------------------
+        inst_buf.clear();
+        inst_buf.push_back(mne_key);
+        inst_raw_buf.clear();
+        inst_raw_buf.push_back(mne);
+        for(auto it=oprs_m.begin()+1; it!=oprs_m.end(); ++it) {
+            inst_buf.push_back(str_to_upper(substitute_symbols(*it,
+                prog.equs)));
+            inst_raw_buf.push_back(*it);
+        }
+
+        // push onto instruction list
+        // -----------------------------------------------------------------
+        prog.insts.emplace_back(inst_opcode, inst_buf);
+        prog.insts_raw.push_back(inst_raw_buf);
+        prog.debug_line_nums.push_back(file_line);
+        prog.debug_macro_lines.push_back(0);
+        prog.debug_notes.push_back("");
+
+        // error: instruction overflow
+        if(prog.insts.size() > MAX_INST) {
+            cerr << "Error: line[" << file_line << "]: "
+                 << "instruction count exceeds limit (" 
+                 << "max = " << MAX_INST << ")" 
+                 << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- *
+ * parse_data
+ * - Lays out the data section of the source `lines` before instructions
+ *     are parsed, so data labels can be used anywhere in the program.
+ * - Lines after `.data` (until `.text`) place words in data memory:
+ *   - `.word v[, v...]` places 16-bit values or labels
+ *   - `.fill count[, v]` places `count` copies of `v` (default 0)
+ *   - `.org addr` and `.align n` skip ahead, leaving zeros
+ *   - `.incbin "file"` maps a binary file and places its bytes as
+ *       little-endian words, without copying them
+ * - Labels in the data section name data addresses, values are resolved
+ *     by `encode_data` once instruction labels are final.
+ * - Returns true upon succesful completion, builds `prog.data`,
+ *     `prog.data_lookup`, and `prog.data_labels`.
+ * - Returns false if a directive is malformed, a file can't be mapped, or
+ *     the data outgrows data memory.
+ * ------------------------------------------------------------------------- */
+bool parse_data(const vector<string>& lines, prog_s& prog,
+        bool strict_parsing) {
+    string line_buf;
+    smatch m;
+    bool in_data = false;
+    bool in_macro = false;
+    unsigned data_loc = 0;
+
+    // follow sections, laying out data directives line by line
+    // ---------------------------------------------------------------------
+    for(unsigned l=0; l<lines.size(); l++) {
+        line_buf = lines[l];
+        trim_head(trim_tail(line_buf));
+        const unsigned file_line = l+1;
+
+        // macro and `.rept` bodies are handled by `parse_program`
+        // -----------------------------------------------------------------
+        const bool is_dir = regex_match(line_buf, m, directive_re);
+        const string dir_key = is_dir ? str_to_upper(m[2].str()) : "";
+        if(MACRO_DIRECTIVES.count(dir_key)) {
+            in_macro = dir_key == "MACRO" || dir_key == "REPT";
+            continue;
+        }
+        if(in_macro || LINK_DIRECTIVES.count(dir_key))
+            continue;
+
+        // labels in the data section name the next data address
+        // -----------------------------------------------------------------
+        if(!is_dir) {
+            if(!in_data || !regex_match(line_buf, m, extract_inst_re))
+                continue;
+            // error: instruction in the data section
+            if(m[2].length() > 0) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "instruction '" << m[2].str() << "' in data section, "
+                     << "expected '.text' before it:"
+                     << endl;
+                line_error_marker(line_buf, m.position(2), m[2].length());
+                return false;
+            }
+            if(!parse_labels(line_buf, m, file_line, data_loc, true, prog))
+                return false;
+            continue;
+        }
+        const string dir = m[2].str();
+        string oprs = m[3].str();
+        trim_tail(oprs);
+
+        // switch sections
+        // -----------------------------------------------------------------
+        if(dir_key == "DATA" || dir_key == "TEXT") {
+            // error: section directives take no operands
+            if(oprs.size() > 0) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "invalid format for directive '." << dir
+                     << "', expected no operands:"
+                     << endl;
+                line_error_marker(line_buf, m.position(3), oprs.length());
+                return false;
+            }
+            in_data = dir_key == "DATA";
+            if(in_data && !parse_labels(line_buf, m, file_line, data_loc,
+                    true, prog))
+                return false;
+            continue;
+        }
+
+        // error: invalid directive
+        if(DATA_DIRECTIVES.count(dir_key) == 0) {
+            cerr << "Error: line[" << file_line << "]: "
+                 << "invalid directive '." << dir << "':"
+                 << endl;
+            line_error_marker(line_buf, m.position(2)-1, m[2].length()+1);
+            return false;
+        }
+
+        // error: data directive in the text section
+        if(!in_data) {
+            cerr << "Error: line[" << file_line << "]: "
+                 << "directive '." << dir << "' outside of data section, "
+                 << "expected '.data' before it:"
+                 << endl;
+            line_error_marker(line_buf, m.position(2)-1, m[2].length()+1);
+            return false;
+        }
+
+        // split operands on commas (or spaces unless parsing strictly)
+        // -----------------------------------------------------------------
+        inst_tokens_t toks;
+        if(dir_key != "INCBIN")
+            toks = split_operands(oprs, strict_parsing);
+        // error: malformed operands
+        const unsigned min_toks = dir_key == "INCBIN" ? 0 : 1;
+        const unsigned max_toks = dir_key == "WORD" ? MAX_DATA
+            : dir_key == "FILL" ? 2 : dir_key == "INCBIN" ? 0 : 1;
+        bool oprs_valid = toks.size() >= min_toks && toks.size() <= max_toks;
+        for(auto it=toks.begin(); oprs_valid && it!=toks.end(); ++it) {
+            long long val = 0;
+            oprs_valid = parse_wide_immediate(str_to_upper(
+                substitute_symbols(*it, prog.equs)), val)
+                || regex_match(*it, data_label_re);
+        }
+        smatch incbin_m;
+        if(dir_key == "INCBIN")
+            oprs_valid = regex_match(oprs, incbin_m, incbin_re);
+        if(!oprs_valid) {
+            cerr << "Error: line[" << file_line << "]: "
+                 << "could not match operand format for directive '."
+                 << dir << "':"
+                 << endl;
+            line_error_marker(line_buf, m.position(3), oprs.length());
+            cerr << "--- Expected the following format:" << endl
+                 << "-----> ." << dir
+                 << (dir_key == "WORD" ? " Value[, Value...]"
+                    : dir_key == "FILL" ? " Count[, Value]"
+                    : dir_key == "ORG" ? " Address"
+                    : dir_key == "ALIGN" ? " Words" : " \"file\"")
+                 << endl;
+            return false;
+        }
+
+        // place the directive's words
+        // -----------------------------------------------------------------
+        data_seg_s seg;
+        seg.line_num = file_line;
+        seg.src = "." + dir + (oprs.empty() ? "" : " " + oprs);
+        seg.length = 0;
+        long long val = 0;
+        if(dir_key == "WORD") {
+            seg.toks = toks;
+            seg.length = toks.size();
+        }
+        else if(dir_key == "FILL") {
+            seg.toks.push_back(toks.size() > 1 ? toks[1] : "0");
+            // error: count isn't a number of words
+            if(!parse_wide_immediate(str_to_upper(
+                    substitute_symbols(toks[0], prog.equs)), val) || val < 0) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "invalid count '" << toks[0] << "' for directive '."
+                     << dir << "', expected a number of words:"
+                     << endl;
+                line_error_marker(line_buf, m.position(3), oprs.length());
+                return false;
+            }
+            seg.length = val;
+        }
+        else if(dir_key == "ORG" || dir_key == "ALIGN") {
+            // error: address or alignment isn't a positive number
+            const bool is_org = dir_key == "ORG";
+            if(!parse_wide_immediate(str_to_upper(
+                    substitute_symbols(toks[0], prog.equs)), val) || val < 0
+                    || (!is_org && (val == 0 || (val & (val-1)) != 0))
+                    || (is_org && val < data_loc)) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "invalid " << (is_org ? "address" : "alignment")
+                     << " '" << toks[0] << "' for directive '." << dir
+                     << "', expected "
+                     << (is_org ? "an address at or after 0x"
+                            + to_hex_string(data_loc)
+                        : string("a power of two"))
+                     << ":"
+                     << endl;
+                line_error_marker(line_buf, m.position(3), oprs.length());
+                return false;
+            }
+            data_loc = is_org ? val : (data_loc + val - 1) & ~(val - 1);
+        }
+        else { // dir_key == "INCBIN"
+            const string path = incbin_m[1].str();
+            const int fd = open(path.c_str(), O_RDONLY);
+            struct stat st;
+            if(fd < 0 || fstat(fd, &st) != 0) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "could not open binary file '" << path << "':"
+                     << endl;
+                line_error_marker(line_buf, m.position(3), oprs.length());
+                if(fd >= 0)
+                    close(fd);
+                return false;
+            }
+            seg.n_bytes = st.st_size;
+            if(seg.n_bytes > 0 && seg.n_bytes <= 2ULL*MAX_DATA) {
+                void* mapped = mmap(nullptr, seg.n_bytes, PROT_READ,
+                    MAP_PRIVATE, fd, 0);
+                if(mapped == MAP_FAILED) {
+                    cerr << "Error: line[" << file_line << "]: "
+                         << "could not map binary file '" << path << "':"
                          << endl;
-                    inst_error_marker(inst_raw_toks, 1+o);
+                    line_error_marker(line_buf, m.position(3),
+                        oprs.length());
+                    close(fd);
                     return false;
                 }
-                // replace token with caps version
-                // inst_toks[1+o] = opr_str_key;
-            }
-            else if(opr_w == IMM) {
-                smatch num_m;
-                long long parsed = 0;
-                bool parse_success = false;
-                bool parse_decimal = false;
-                bool parse_label = false;
-                // try to find label and compute relative branch
-                if(inst_fmt == B_TYPE 
-                        && prog.label_lookup.count(opr_str_key) > 0) {
-                    parse_success = true;
-                    parse_label = true;
-                    parsed = prog.label_lookup[opr_str_key] - (i+1LL);
-                }
-                // try to parse as decimal
-                else if(regex_match(opr_str, num_m, dec_re)) {
-                    parse_success = true;
-                    parse_decimal = true;
-                    parsed = strtoll(num_m[1].str().c_str(), nullptr, 10);
-                }
-                // try to parse as hex
-                else if(regex_match(opr_str, num_m, hex_re)) {
-                    parse_success = true;
-                    parsed = strtoll(num_m[1].str().c_str(), nullptr, 16);
-                    if(num_m[1].length() > IMM_NIBS) {
-                        cerr << "Error: line[" << prog.debug_line_nums[i]
-                             << "]: could not encode " << ordinal_str(o+1)
-                             << " operand '" << opr_str
-                             << "', hex value has too many nibbles ("
-                             << "max = " << IMM_NIBS << "):" 
-                             << endl;
-                        inst_error_marker(inst_raw_toks, 1+o);
-                        return false;
-                    }
-                    // convert to negative
-                    if(parsed&(1<<(IMM-1)))
-                        parsed |= -1ULL<<IMM;
-                }
-                // try to parse as binary
-                else if(regex_match(opr_str, num_m, bin_re)) {
-                    parse_success = true;
-                    parsed = strtoll(num_m[1].str().c_str(), nullptr, 2);
-                    // error: too many bits
-                    if(num_m[1].length() > IMM) {
-                        cerr << "Error: line[" << prog.debug_line_nums[i]
-                             << "]: could not encode " << ordinal_str(o+1)
-                             << " operand '" << opr_str
-                             << "', binary value has too many bits ("
-                             << "max = " << IMM << "):" 
-                             << endl;
-                        inst_error_marker(inst_raw_toks, 1+o);
-                        return false;
-                    }
-                    // convert to negative
-                    if(parsed&(1<<(IMM-1)))
-                        parsed |= -1ULL<<IMM;
-                }
+                seg.bytes = static_cast<const uint8_t*>(mapped);
+            }
+            close(fd);
+            seg.length = (seg.n_bytes + 1) / 2;
+        }
 
-                // error: could not encode immediate
-                if(!parse_success) {
-                    cerr << "Error: line[" << prog.debug_line_nums[i]
-                         << "]: could not encode " << ordinal_str(o+1)
-                         << " operand '" << opr_str
-                         << "', expected immediate value"
-                         << (inst_fmt == B_TYPE ? " or valid label" : "")
-                         << (inst_opcode == MOVIM ? " or register" : "")
-                         << ":" 
+        // error: data overflow
+        if(data_loc > MAX_DATA || seg.length > MAX_DATA - data_loc) {
+            cerr << "Error: line[" << file_line << "]: "
+                 << "data exceeds data memory ("
+                 << "max = " << MAX_DATA << " words)"
+                 << endl;
+            if(seg.bytes != nullptr)
+                munmap(const_cast<uint8_t*>(seg.bytes), seg.n_bytes);
+            return false;
+        }
+
+        // labels name the first word placed (after `.org`/`.align`)
+        if(!parse_labels(line_buf, m, file_line, data_loc, true, prog)) {
+            if(seg.bytes != nullptr)
+                munmap(const_cast<uint8_t*>(seg.bytes), seg.n_bytes);
+            return false;
+        }
+        if(seg.length > 0) {
+            // warning: data placed over memory-mapped IO
+            if(data_loc + seg.length > IO_BASE) {
+                cerr << "Warning: line[" << file_line << "]: "
+                     << "data overlaps the addresses reserved for IO (0x"
+                     << to_hex_string(IO_BASE) << " and up):"
+                     << endl;
+                line_error_marker(line_buf, m.position(2)-1,
+                    line_buf.size()-m.position(2)+1);
+            }
+            seg.address = data_loc;
+            data_loc += seg.length;
+            prog.data.push_back(seg);
+        }
+        else if(seg.bytes != nullptr)
+            munmap(const_cast<uint8_t*>(seg.bytes), seg.n_bytes);
+    }
+
+    // signal success
+    // ---------------------------------------------------------------------
+    return true;
+}
+
+/* ------------------------------------------------------------------------- *
+ * preprocess_program
+ * - Resolves conditional assembly and symbols in the source `lines` before
+ *     any other pass sees them:
+ *   - `.if v [op v]` (`==`, `!=`, `<`, `<=`, `>`, `>=`, or nonzero),
+ *       `.ifdef NAME`, `.ifndef NAME`, `.else` and `.endif` blocks nest
+ *   - `.equ NAME, v` defines a symbol, like `-D NAME=v` (in `prog.equs`)
+ * - Lines of regions that aren't assembled are only scanned for the
+ *     conditional directive starting them, then emptied (keeping line
+ *     numbers), so they never reach label or operand parsing. Each
+ *     region is noted in `prog.skipped` for the listing.
+ * - Symbols are left in the lines, so errors quote the source as written,
+ *     and are replaced by their values where operands are parsed. Since
+ *     that's after every `.equ` is read, a symbol must be defined before
+ *     the first line using its name.
+ * - Returns true upon succesful completion.
+ * - Returns false if a condition or definition is malformed, a symbol is
+ *     used before its definition, or blocks are unbalanced.
+ * ------------------------------------------------------------------------- */
+bool preprocess_program(vector<string>& lines, bool strict_parsing,
+        prog_s& prog) {
+    smatch m;
+    vector<cond_block_s> conds;
+    bool active = true;
+    // first line and column using each name that isn't a symbol yet
+    map<string, pair<unsigned, unsigned>> first_uses;
+
+    // follow conditional blocks, line by line
+    // ---------------------------------------------------------------------
+    for(unsigned l=0; l<lines.size(); l++) {
+        string& line_buf = lines[l];
+        const unsigned file_line = l+1;
+        const string dir_key = line_directive(line_buf);
+        const bool is_cond = COND_DIRECTIVES.count(dir_key) != 0;
+
+        // skipped lines are dropped without being parsed
+        // -----------------------------------------------------------------
+        if(!active && !is_cond) {
+            line_buf.clear();
+            continue;
+        }
+
+        // lines that are kept are left for the other passes, noting the
+        //   names their operands use before any symbol is defined as one
+        // -----------------------------------------------------------------
+        if(!is_cond && dir_key != "EQU") {
+            bool has_oprs = false;
+            if(dir_key.empty())
+                has_oprs = regex_match(line_buf, m, macro_line_re);
+            else if((DATA_DIRECTIVES.count(dir_key) != 0
+                    && dir_key != "INCBIN") || dir_key == "REPT")
+                has_oprs = regex_match(line_buf, m, directive_re);
+            if(!has_oprs)
+                continue;
+            const auto words = symbol_words(m[3].str());
+            for(auto it=words.begin(); it!=words.end(); ++it) {
+                const string key = str_to_upper(it->second);
+                if(prog.equs.count(key) == 0 && first_uses.count(key) == 0)
+                    first_uses[key] = { l, m.position(3)+it->first };
+            }
+            continue;
+        }
+
+        // inner blocks of skipped regions only need to be matched up
+        // -----------------------------------------------------------------
+        string oprs;
+        if(active) {
+            regex_match(line_buf, m, directive_re);
+            oprs = m[3].str();
+            trim_tail(oprs);
+        }
+        const bool was_active = active;
+        string src = line_buf;
+        trim_head(trim_tail(src));
+        if(active)
+            src = "." + m[2].str() + (oprs.empty() ? "" : " " + oprs);
+
+        // define a symbol
+        // -----------------------------------------------------------------
+        if(dir_key == "EQU") {
+            const inst_tokens_t toks = split_operands(oprs, strict_parsing);
+            // error: malformed operands
+            if(toks.size() != 2 || !regex_match(toks[0], data_label_re)) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "invalid format for directive '." << m[2].str()
+                     << "', expected 'NAME, value':"
+                     << endl;
+                line_error_marker(line_buf, m.position(3), oprs.length());
+                return false;
+            }
+            const string name = str_to_upper(toks[0]);
+            const int pos = m.position(3) + oprs.find(toks[0]);
+            // error: illegal symbol, reserved
+            if(!is_reserved_name(name)) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "illegal symbol name '" << toks[0]
+                     << "', reserved by ISA:"
+                     << endl;
+                line_error_marker(line_buf, pos, toks[0].size());
+                return false;
+            }
+            // error: repeated symbol
+            if(prog.equs.count(name) != 0) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "repeat definition of symbol '" << toks[0] << "':"
+                     << endl;
+                line_error_marker(line_buf, pos, toks[0].size());
+                return false;
+            }
+            // error: symbol used on an earlier line
+            if(first_uses.count(name) != 0) {
+                const auto& use = first_uses.at(name);
+                cerr << "Error: line[" << use.first+1 << "]: "
+                     << "symbol '" << toks[0] << "' used before its "
+                     << "definition (line " << file_line << "):"
+                     << endl;
+                line_error_marker(lines[use.first], use.second,
+                    toks[0].size());
+                return false;
+            }
+            long long val = 0;
+            // error: value is neither a 16-bit number nor a known symbol
+            if(!symbol_value(toks[1], prog.equs, val)) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "invalid value '" << toks[1] << "' for symbol '"
+                     << toks[0] << "', expected a 16-bit number or "
+                     << "an earlier symbol:"
+                     << endl;
+                line_error_marker(line_buf, m.position(3)+oprs.rfind(toks[1]),
+                    toks[1].size());
+                return false;
+            }
+            prog.equs[name] = val;
+        }
+
+        // open a block, evaluating its condition if it can be assembled
+        // -----------------------------------------------------------------
+        else if(dir_key == "IF" || dir_key == "IFDEF" || dir_key == "IFNDEF") {
+            bool taken = false;
+            smatch cond_m;
+            if(active && dir_key == "IF") {
+                long long lhs = 0, rhs = 0;
+                // error: malformed condition
+                if(!regex_match(oprs, cond_m, cond_re)) {
+                    cerr << "Error: line[" << file_line << "]: "
+                         << "invalid condition for directive '." << m[2].str()
+                         << "', expected 'value' or 'value op value':"
                          << endl;
-                    inst_error_marker(inst_raw_toks, 1+o);
+                    line_error_marker(line_buf, m.position(3), oprs.length());
                     return false;
                 }
-                // error: out of bounds immediate
-                if(parsed < IMM_MIN || parsed > IMM_MAX) {
-                    cerr << "Error: line[" << prog.debug_line_nums[i]
-                         << "]: could not encode " << ordinal_str(o+1)
-                         << " operand '" << opr_str
-                         << "'" 
-                         << (parse_decimal 
-                                ? "" 
-                                : (" (" + to_string(parsed) + ")") )
-                         << ", "
-                         << (parse_label
-                                ? "branch offset from label "
-                                : "immediate value ")
-                         << "out of range ["
-                         << IMM_MIN << ", " << IMM_MAX << "]:"
+                // error: undefined symbol
+                for(unsigned s=1; s<=3; s+=2) {
+                    if(!cond_m[s].matched || symbol_value(cond_m[s].str(),
+                            prog.equs, s == 1 ? lhs : rhs))
+                        continue;
+                    cerr << "Error: line[" << file_line << "]: "
+                         << "undefined symbol '" << cond_m[s].str()
+                         << "' in condition:"
                          << endl;
-                    inst_error_marker(inst_raw_toks, 1+o);
+                    line_error_marker(line_buf,
+                        m.position(3)+cond_m.position(s), cond_m.length(s));
+                    return false;
+                }
+                const string op = cond_m[2].str();
+                taken = op.empty() ? lhs != 0
+                    : op == "==" ? lhs == rhs : op == "!=" ? lhs != rhs
+                    : op == "<" ? lhs < rhs : op == "<=" ? lhs <= rhs
+                    : op == ">" ? lhs > rhs : lhs >= rhs;
+            }
+            else if(active) {
+                // error: malformed symbol name
+                if(!regex_match(oprs, data_label_re)) {
+                    cerr << "Error: line[" << file_line << "]: "
+                         << "invalid format for directive '." << m[2].str()
+                         << "', expected 'NAME':"
+                         << endl;
+                    line_error_marker(line_buf, m.position(3), oprs.length());
                     return false;
                 }
+                taken = (prog.equs.count(str_to_upper(oprs)) != 0)
+                    == (dir_key == "IFDEF");
+            }
+            conds.push_back({ file_line, src, active, taken, false });
+        }
 
-                // place parsed immediate into operand buffer
-                opr_buf = static_cast<mword_t>(parsed);
-                
-                // replace inst token with sanitized hex version
-                inst_toks[1+o] = "0x" + to_hex_string(opr_buf, IMM)
-                    + (inst_fmt==B_TYPE ? "    " : "")
-                    + " ; (" + to_string(parsed) 
-                    + (parse_label ? (" -> " + opr_str_key) : "") + ")";
+        // switch to the other branch of, or close, the innermost block
+        // -----------------------------------------------------------------
+        else {
+            // error: `.else` and `.endif` take no operands
+            if(oprs.size() > 0) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "invalid format for directive '." << m[2].str()
+                     << "', expected no operands:"
+                     << endl;
+                line_error_marker(line_buf, m.position(3), oprs.length());
+                return false;
+            }
+            // error: no open block
+            if(conds.empty()) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "directive '." << m[2].str() << "' without "
+                     << "an open '.if' block:"
+                     << endl;
+                line_error_marker(line_buf, m.position(2)-1, m[2].length()+1);
+                return false;
             }
-            else { // opr_w == NON
-                opr_buf = 0;
+            cond_block_s& block = conds.back();
+            if(dir_key == "ENDIF")
+                conds.pop_back();
+            // error: repeated `.else`
+            else if(block.in_else) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "repeat '.else' for '" << block.src << "' (line "
+                     << block.line_num << "):"
+                     << endl;
+                line_error_marker(line_buf, 0, line_buf.size());
+                return false;
             }
-            // mask opr_buf for width (shouldn't be necessary, but stay safe)
-            opr_buf &= WIDTH_TO_BITS(opr_w);
-            // shift opr_buf to proper position
-            opr_buf <<= opr_p;
-            // insert opr_buf into instruction buffer
-            enc_inst_buf |= opr_buf;
+            else
+                block.in_else = true;
+        }
+
+        // note where skipped regions start and end
+        // -----------------------------------------------------------------
+        active = conds.empty() || (conds.back().outer
+            && conds.back().taken != conds.back().in_else);
+        if(was_active && !active)
+            prog.skipped.push_back({ file_line+1, 0, file_line, src });
+        else if(!was_active && active) {
+            if(prog.skipped.back().first < file_line)
+                prog.skipped.back().last = file_line-1;
+            else
+                prog.skipped.pop_back();
         }
 
-        // push encoded instruction
-        prog.mcode.push_back(enc_inst_buf);
+        // keep the labels in front of the directive, if it was assembled
+        string labels = was_active ? m[1].str() : "";
+        line_buf = trim_tail(labels);
+    }
+
+    // error: unclosed block
+    if(!conds.empty()) {
+        cerr << "Error: line[" << conds.back().line_num << "]: "
+             << "block '" << conds.back().src << "' is never closed, "
+             << "expected '.endif' after it:"
+             << endl;
+        line_error_marker(conds.back().src, 0, conds.back().src.size());
+        return false;
     }
 
     // signal success
+    // ---------------------------------------------------------------------
     return true;
 }
 
 /* ------------------------------------------------------------------------- *
- * write_program
- * - Writes the program to a given output file.
- * -  File should be opened before calling this function.
+ * layout_program
+ * - Reorders the basic blocks of the program so the hot paths measured in
+ *     `profile` fall through instead of taking branches.
+ * - Blocks are chained greedily along their hottest edges, and each
+ *     region's chains are placed hottest first after the chain holding
+ *     the region's first block.
+ * - Conditionals are inverted (`BEQ` <-> `BNE`) when their taken path now
+ *     falls through, `B` is added where a fall-through was broken, and a
+ *     `B` to the block that now follows is dropped. Branches refer to
+ *     labels, so offsets are recomputed when the program is encoded.
+ * - The first instruction, the labels in `entries` and the blocks that read
+ *     the PC keep their address, blocks only move within the regions
+ *     between them (padded with `NOP` when they shrink, left as typed when
+ *     they would grow). Programs that write the PC are left as typed, since
+ *     their computed jump targets can't follow the moved blocks.
+ * - Returns true upon succesful completion, counting the blocks that were
+ *     moved in `n_moved` and the inverted conditionals in `n_inverted`.
+ * - Returns false if an entry label is undefined, the profile doesn't fit
+ *     the program, or the program outgrows instruction memory.
  * ------------------------------------------------------------------------- */
-void write_program(ofstream& out, const prog_s& prog) {
-    out << "v2.0 raw";
-    for(auto it=prog.mcode.begin(); it!=prog.mcode.end(); ++it)
-        out << endl << to_hex_string(*it);
+bool layout_program(prog_s& prog, const profile_t& profile,
+        const vector<string>& entries, unsigned& n_moved,
+        unsigned& n_inverted) {
+    const unsigned n = prog.insts.size();
+    n_moved = 0;
+    n_inverted = 0;
+
+    // error: fixed entry points must be labels of the program
+    for(auto it=entries.begin(); it!=entries.end(); ++it) {
+        if(prog.label_lookup.count(str_to_upper(*it)) == 0) {
+            cerr << "Error: fixed entry point '" << *it << "' is not a label"
+                 << endl;
+            return false;
+        }
+    }
+
+    // error: profile taken from another program
+    if(!profile.empty() && profile.rbegin()->first >= n) {
+        cerr << "Error: profile address 0x"
+             << to_hex_string(profile.rbegin()->first) << " is past the end "
+             << "of the program (" << n << " instructions)"
+             << endl;
+        return false;
+    }
+
+    // computed jumps can't follow moved blocks, so leave the program as is
+    for(unsigned i=0; i<n; i++) {
+        unsigned uses, defs;
+        inst_regs(prog.insts[i].first, prog.insts[i].second, uses, defs);
+        if(defs & (1u<<PC_REG)) {
+            cerr << "Warning: line[" << line_ref(prog, i) << "]: "
+                 << "writes to the PC, so blocks aren't laid out to keep "
+                 << "computed jump targets valid:"
+                 << endl;
+            inst_error_marker(prog.insts_raw[i], MAX_OPR);
+            return true;
+        }
+    }
+
+    // split into blocks, unresolved branches are left for `encode_program`
+    // ---------------------------------------------------------------------
+    for(unsigned i=0; i<n; i++) {
+        if(OPC_TO_FMT.at(prog.insts[i].first) == B_TYPE
+                && branch_target(prog, i) < 0)
+            return true;
+    }
+    const inst_list_t typed_insts = prog.insts;
+    anchor_branch_offsets(prog);
+    const vector<unsigned> starts = block_starts(prog);
+    const unsigned nb = starts.size() - 1;
+    vector<unsigned> block_of(n+1, nb);
+    for(unsigned b=0; b<nb; b++) {
+        for(unsigned i=starts[b]; i<starts[b+1]; i++)
+            block_of[i] = b;
+    }
+
+    // weigh the fall-through and taken edges leaving each block, where
+    //   block `nb` stands for the end of the program
+    // ---------------------------------------------------------------------
+    vector<int> fall(nb, -1), taken(nb, -1);
+    vector<unsigned long long> w_fall(nb, 0), w_taken(nb, 0), heat(nb, 0);
+    for(unsigned b=0; b<nb; b++) {
+        const unsigned last = starts[b+1] - 1;
+        for(auto it=profile.lower_bound(starts[b]);
+                it!=profile.end() && it->first<=last; ++it)
+            heat[b] = max(heat[b], it->second.count);
+        const auto last_it = profile.find(last);
+        const unsigned long long exec = last_it != profile.end()
+            ? last_it->second.count : heat[b];
+        const OPCODE opc = prog.insts[last].first;
+        unsigned uses, defs;
+        inst_regs(opc, prog.insts[last].second, uses, defs);
+        if(OPC_TO_FMT.at(opc) == B_TYPE) {
+            taken[b] = block_of[branch_target(prog, last)];
+            w_taken[b] = opc == B ? exec : min(exec,
+                last_it != profile.end() ? last_it->second.taken : 0);
+        }
+        if(opc != B && opc != HALT && !(defs & (1u<<PC_REG))) {
+            fall[b] = b + 1;
+            w_fall[b] = exec - w_taken[b];
+        }
+    }
+
+    // fixed blocks start the regions that blocks are kept within
+    // ---------------------------------------------------------------------
+    vector<bool> fixed(nb+1, false);
+    fixed[0] = true;
+    fixed[nb] = true;
+    for(auto it=entries.begin(); it!=entries.end(); ++it)
+        fixed[block_of[prog.label_lookup.at(str_to_upper(*it))]] = true;
+    // the PC read by a block depends on where it is
+    for(unsigned i=0; i<n; i++) {
+        unsigned uses, defs;
+        inst_regs(prog.insts[i].first, prog.insts[i].second, uses, defs);
+        if(uses & (1u<<PC_REG))
+            fixed[block_of[i]] = true;
+    }
+    vector<unsigned> heads;
+    vector<unsigned> region_of(nb);
+    for(unsigned b=0; b<nb; b++) {
+        if(fixed[b])
+            heads.push_back(b);
+        region_of[b] = heads.size() - 1;
+    }
+    heads.push_back(nb);
+
+    // chain blocks along the hottest edges, a fixed block always heads
+    //   its chain so each region keeps its first block
+    // ---------------------------------------------------------------------
+    typedef tuple<unsigned long long,unsigned,unsigned> edge_t;
+    vector<edge_t> edges;
+    for(unsigned b=0; b<nb; b++) {
+        if(fall[b] >= 0 && w_fall[b] > 0)
+            edges.emplace_back(w_fall[b], b, fall[b]);
+        if(taken[b] >= 0 && w_taken[b] > 0)
+            edges.emplace_back(w_taken[b], b, taken[b]);
+    }
+    stable_sort(edges.begin(), edges.end(),
+        [](const edge_t& a, const edge_t& b) {
+            return get<0>(a) > get<0>(b);
+        });
+    vector<vector<unsigned>> chains(nb);
+    vector<unsigned> chain_of(nb);
+    for(unsigned b=0; b<nb; b++) {
+        chains[b] = { b };
+        chain_of[b] = b;
+    }
+    for(auto it=edges.begin(); it!=edges.end(); ++it) {
+        const unsigned src = get<1>(*it);
+        const unsigned dst = get<2>(*it);
+        if(fixed[dst] || region_of[src] != region_of[dst])
+            continue;
+        const unsigned c_src = chain_of[src];
+        const unsigned c_dst = chain_of[dst];
+        if(c_src == c_dst || chains[c_src].back() != src
+                || chains[c_dst].front() != dst)
+            continue;
+        for(auto b=chains[c_dst].begin(); b!=chains[c_dst].end(); ++b) {
+            chains[c_src].push_back(*b);
+            chain_of[*b] = c_src;
+        }
+        chains[c_dst].clear();
+    }
+
+    // order each region's chains, hottest first after the region's head
+    // ---------------------------------------------------------------------
+    vector<unsigned long long> chain_heat(nb, 0);
+    for(unsigned b=0; b<nb; b++)
+        chain_heat[chain_of[b]] = max(chain_heat[chain_of[b]], heat[b]);
+    vector<unsigned> order;
+    for(unsigned r=0; r+1<heads.size(); r++) {
+        vector<unsigned> region_chains;
+        for(unsigned c=heads[r]+1; c<heads[r+1]; c++) {
+            if(!chains[c].empty())
+                region_chains.push_back(c);
+        }
+        stable_sort(region_chains.begin(), region_chains.end(),
+            [&chain_heat](unsigned a, unsigned b) {
+                return chain_heat[a] > chain_heat[b];
+            });
+        region_chains.insert(region_chains.begin(), heads[r]);
+        for(auto c=region_chains.begin(); c!=region_chains.end(); ++c)
+            order.insert(order.end(), chains[*c].begin(), chains[*c].end());
+    }
+
+    // rebuild each region in its new order, fixing up the branches
+    // ---------------------------------------------------------------------
+    const vector<inst_row_s> old_rows = program_rows(prog);
+    // label naming a block, preferring the programmer's own labels
+    auto block_label = [&prog, &starts](unsigned b) {
+        for(auto it=prog.labels.begin(); it!=prog.labels.end(); ++it) {
+            if(it->address == starts[b])
+                return it->name;
+        }
+        return anchor_label(prog, starts[b]);
+    };
+    vector<inst_row_s> rows;
+    // blocks left empty by a dropped branch pass their labels on
+    map<unsigned, unsigned> redirects;
+    bool changed = false;
+    for(unsigned r=0, pos=0; r+1<heads.size(); r++) {
+        const unsigned first_row = rows.size();
+        const unsigned end_pos = pos + heads[r+1] - heads[r];
+        unsigned r_moved = 0, r_inverted = 0;
+        map<unsigned, unsigned> r_redirects;
+        for(; pos<end_pos; pos++) {
+            const unsigned b = order[pos];
+            const unsigned next = pos+1 < nb ? order[pos+1] : nb;
+            const unsigned last = starts[b+1] - 1;
+            const unsigned block_row = rows.size();
+            for(unsigned i=starts[b]; i<last; i++)
+                rows.push_back(old_rows[i]);
+            inst_row_s tail = old_rows[last];
+            const OPCODE opc = tail.opcode;
+            if(opc == B && taken[b] == static_cast<int>(next)
+                    && (last > starts[b] || !fixed[b])) {
+                // the branch target follows now, the branch isn't needed
+                if(last == starts[b])
+                    r_redirects[starts[b]] = starts[next];
+                changed = true;
+            }
+            else if((opc == BEQ || opc == BNE) && fall[b] >= 0
+                    && fall[b] != static_cast<int>(next)
+                    && taken[b] == static_cast<int>(next)) {
+                add_note(tail.note, "layout inverted " + to_string(tail.toks));
+                tail.opcode = opc == BEQ ? BNE : BEQ;
+                tail.toks = { opcode_mnemonic(tail.opcode),
+                    block_label(fall[b]) };
+                tail.toks_raw = tail.toks;
+                rows.push_back(tail);
+                r_inverted++;
+            }
+            else {
+                rows.push_back(tail);
+                if(fall[b] >= 0 && fall[b] != static_cast<int>(next)) {
+                    tail.opcode = B;
+                    tail.toks = { opcode_mnemonic(B), block_label(fall[b]) };
+                    tail.toks_raw = tail.toks;
+                    tail.note = "layout added for fall-through";
+                    tail.origin = -1;
+                    rows.push_back(tail);
+                    changed = true;
+                }
+            }
+            if(!fixed[b] && order[pos-1] != b-1 && rows.size() > block_row
+                    && block_row != starts[b]) {
+                add_note(rows[block_row].note, "layout moved from 0x"
+                    + to_hex_string(starts[b], IMM));
+                r_moved++;
+            }
+        }
+
+        // regions before a fixed block must keep their size
+        const unsigned old_size = starts[heads[r+1]] - starts[heads[r]];
+        const unsigned new_size = rows.size() - first_row;
+        if(heads[r+1] < nb && new_size > old_size) {
+            rows.resize(first_row);
+            rows.insert(rows.end(), old_rows.begin() + starts[heads[r]],
+                old_rows.begin() + starts[heads[r+1]]);
+            continue;
+        }
+        if(heads[r+1] < nb && new_size < old_size) {
+            // pad after the last unconditional transfer, or else at the end
+            unsigned pad_row = rows.size();
+            for(unsigned i=first_row; i<rows.size(); i++) {
+                unsigned uses, defs;
+                inst_regs(rows[i].opcode, rows[i].toks, uses, defs);
+                if(rows[i].opcode == B || rows[i].opcode == HALT
+                        || (defs & (1u<<PC_REG)))
+                    pad_row = i + 1;
+            }
+            inst_row_s pad = old_rows[starts[heads[r+1]]-1];
+            pad.opcode = NOP;
+            pad.toks = { opcode_mnemonic(NOP) };
+            pad.toks_raw = pad.toks;
+            pad.note = "layout padding";
+            pad.origin = -1;
+            rows.insert(rows.begin() + pad_row, old_size - new_size, pad);
+        }
+        n_moved += r_moved;
+        n_inverted += r_inverted;
+        redirects.insert(r_redirects.begin(), r_redirects.end());
+    }
+
+    // error: instruction overflow
+    if(rows.size() > MAX_INST) {
+        cerr << "Error: laid out program instruction count exceeds limit ("
+             << "max = " << MAX_INST << ")"
+             << endl;
+        return false;
+    }
+
+    // keep numeric offsets as typed when nothing moved
+    if(n_moved == 0 && n_inverted == 0 && !changed) {
+        prog.insts = typed_insts;
+        return true;
+    }
+    for(auto it=prog.label_lookup.begin(); it!=prog.label_lookup.end(); ++it) {
+        while(redirects.count(it->second) > 0)
+            it->second = redirects.at(it->second);
+    }
+    rewrite_program(prog, rows);
+
+    // signal success
+    return true;
+}
+
+// registers and flags (`FLAGS_BIT`) live after each instruction, skipping
+//   the instructions marked `dead`; everything (any bit of `uses`) is live
+//   after `HALT`, writes to the PC, and branches or fall-throughs out of
+//   the program
+vector<unsigned> live_after_insts(const prog_s& prog,
+        const vector<unsigned>& uses, const vector<unsigned>& defs,
+        const vector<bool>& dead) {
+    const unsigned n = prog.insts.size();
+    const unsigned all_live = ~0u;
+    vector<unsigned> live_after(n, 0);
+    vector<unsigned> live_before(n, 0);
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(unsigned i=n; i-->0; ) {
+            const OPCODE opc = prog.insts[i].first;
+            unsigned live = 0;
+            if(opc == HALT || (defs[i] & (1u<<PC_REG)))
+                live = all_live;
+            else {
+                if(opc != B)
+                    live |= i+1 < n ? live_before[i+1] : all_live;
+                if(OPC_TO_FMT.at(opc) == B_TYPE) {
+                    const int target = branch_target(prog, i);
+                    live |= target >= 0 && static_cast<unsigned>(target) < n
+                        ? live_before[target] : all_live;
+                }
+            }
+            const unsigned before = dead[i] ? live
+                : uses[i] | (live & ~defs[i]);
+            if(live != live_after[i] || before != live_before[i]) {
+                live_after[i] = live;
+                live_before[i] = before;
+                changed = true;
+            }
+        }
+    }
+    return live_after;
+}
+
+/* ------------------------------------------------------------------------- *
+ * peephole_program
+ * - Rewrites the sequences matching the pattern of a rule in `rules` into
+ *     its shorter replacement, as proven equivalent by `superopt`.
+ * - A pattern matches instructions with no label inside them, whose
+ *     registers map one-to-one onto its variables (never onto the PC) and
+ *     whose immediates are its own. A match is only rewritten when the
+ *     registers either side writes but the rule doesn't keep, and the
+ *     flags when either side sets them, are dead after it.
+ * - Rules are tried in file order at each instruction, over and over
+ *     until none applies. Each rewrite is noted in the listing.
+ * - Programs that read or write the PC are left as typed, since their
+ *     computed addresses can't follow the shorter code.
+ * - Counts the rewritten sequences in `n_rewritten`.
+ * ------------------------------------------------------------------------- */
+void peephole_program(prog_s& prog, const vector<peep_rule_s>& rules,
+    unsigned& n_rewritten) {
+    n_rewritten = 0;
+    if(rules.empty())
+        return;
+    const int pc_inst = find_pc_inst(prog);
+    if(pc_inst >= 0) {
+        cerr << "Warning: line[" << line_ref(prog, pc_inst) << "]: "
+             << "uses the PC, so peephole rules aren't applied to keep "
+             << "computed addresses valid:"
+             << endl;
+        inst_error_marker(prog.insts_raw[pc_inst], MAX_OPR);
+        return;
+    }
+    anchor_branch_offsets(prog);
+
+    // rewrite matches until no rule applies, each pass shortens the program
+    // ---------------------------------------------------------------------
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        const unsigned n = prog.insts.size();
+        vector<unsigned> uses(n), defs(n);
+        for(unsigned i=0; i<n; i++)
+            inst_regs(prog.insts[i].first, prog.insts[i].second, uses[i],
+                defs[i]);
+        const vector<unsigned> live_after = live_after_insts(prog, uses, defs,
+            vector<bool>(n, false));
+        vector<bool> is_target(n+1, false);
+        for(auto it=prog.label_lookup.begin(); it!=prog.label_lookup.end();
+                ++it) {
+            if(it->second <= n)
+                is_target[it->second] = true;
+        }
+
+        vector<inst_row_s> rows;
+        for(unsigned i=0; i<n; ) {
+            unsigned regs[MAX_REG];
+            auto rule = rules.begin();
+            while(rule != rules.end()
+                    && !match_rule(prog, *rule, i, is_target, live_after, regs))
+                ++rule;
+            if(rule == rules.end()) {
+                rows.push_back(program_rows(prog, i++));
+                continue;
+            }
+            // the replacement takes the labels and line of the match
+            const inst_row_s first = program_rows(prog, i);
+            for(unsigned k=0; k<rule->replacement.size(); k++) {
+                inst_row_s row = first;
+                row.opcode = rule->replacement[k].opcode;
+                row.toks = rule_inst_tokens(rule->replacement[k], regs);
+                row.toks_raw = row.toks;
+                row.origin = k == 0 ? static_cast<int>(i) : -1;
+                add_note(row.note, "peep " + to_string(k+1) + "/"
+                    + to_string(rule->replacement.size()) + " (rule line "
+                    + to_string(rule->line_num) + ")");
+                rows.push_back(row);
+            }
+            i += rule->pattern.size();
+            n_rewritten++;
+            changed = true;
+        }
+        if(changed)
+            rewrite_program(prog, rows);
+    }
+}
+
+/* ------------------------------------------------------------------------- *
+ * propagate_constants
+ * - Follows the bits of each register (and the carry) known along the
+ *     control flow of the program, visiting a basic block again only when
+ *     the values reaching it lose known bits. Registers are unknown at
+ *     reset and at global labels, and the carry starts clear.
+ * - ALU ops whose result is known are folded into `MOV Rd, Imm` when it
+ *     fits the immediate and the flags they set are dead.
+ * - `MUL` by a power of two becomes `LSL`, and `DIV`/`MOD` by a power of
+ *     two become `ASR`/`AND` when the dividend is known non-negative, so
+ *     the result and flags stay the same. The shift or mask comes from a
+ *     register known to hold it, or else is loaded into a dead register
+ *     when `MOV` and the new op cost no more cycles in `model`.
+ * - Each rewrite is noted in the listing. Programs that read or write the
+ *     PC are left as typed, since their computed jumps can't be followed.
+ * - Counts the folded and reduced instructions in `n_folded` and
+ *     `n_reduced`.
+ * ------------------------------------------------------------------------- */
+void propagate_constants(prog_s& prog, const pipe_model_s& model,
+    unsigned& n_folded, unsigned& n_reduced) {
+    const unsigned n = prog.insts.size();
+    n_folded = 0;
+    n_reduced = 0;
+    const int pc_inst = find_pc_inst(prog);
+    if(pc_inst >= 0) {
+        cerr << "Warning: line[" << line_ref(prog, pc_inst) << "]: "
+             << "uses the PC, so constants aren't propagated to keep computed "
+             << "addresses valid:"
+             << endl;
+        inst_error_marker(prog.insts_raw[pc_inst], MAX_OPR);
+        return;
+    }
+
+    // known values entering each block, revisiting blocks that lose bits
+    // ---------------------------------------------------------------------
+    const vector<unsigned> starts = block_starts(prog);
+    const unsigned n_blocks = starts.size()-1;
+    auto block_of = [&starts](unsigned i) -> unsigned {
+        return upper_bound(starts.begin(), starts.end(), i) - starts.begin()
+            - 1;
+    };
+    const_state_s unknown = {};
+    unknown.reached = true;
+    unknown.carry = { 0xFFFE, 0 };
+    vector<const_state_s> block_in(n_blocks, const_state_s());
+    vector<unsigned> work;
+    vector<bool> queued(n_blocks, false);
+    auto enter = [&](unsigned i, const const_state_s& state) {
+        if(i >= n)
+            return;
+        const unsigned b = block_of(i);
+        if(join_const_state(block_in[b], state) && !queued[b]) {
+            queued[b] = true;
+            work.push_back(b);
+        }
+    };
+    const_state_s reset = unknown;
+    if(!prog.relocatable)
+        reset.carry = known_const(0);
+    enter(0, reset);
+    // other objects may branch to global labels with anything
+    for(auto it=prog.labels.begin(); it!=prog.labels.end(); ++it) {
+        if(prog.global_labels.count(it->name))
+            enter(it->address, unknown);
+    }
+    while(!work.empty()) {
+        const unsigned b = work.back();
+        work.pop_back();
+        queued[b] = false;
+        const_state_s state = block_in[b];
+        const unsigned last = starts[b+1]-1;
+        for(unsigned i=starts[b]; i<=last; i++)
+            const_step(prog, i, state);
+        const OPCODE opc = prog.insts[last].first;
+        if(opc == HALT)
+            continue;
+        if(opc != B)
+            enter(last+1, state);
+        if(OPC_TO_FMT.at(opc) == B_TYPE) {
+            const int target = branch_target(prog, last);
+            if(target >= 0)
+                enter(target, state);
+        }
+    }
+
+    // fold known results and reduce `MUL`/`DIV`/`MOD` by powers of two
+    // ---------------------------------------------------------------------
+    vector<unsigned> uses(n), defs(n);
+    for(unsigned i=0; i<n; i++)
+        inst_regs(prog.insts[i].first, prog.insts[i].second, uses[i], defs[i]);
+    const vector<unsigned> live_after = live_after_insts(prog, uses, defs,
+        vector<bool>(n, false));
+    anchor_branch_offsets(prog);
+    vector<inst_row_s> rows;
+    for(unsigned b=0; b<n_blocks; b++) {
+        const_state_s state = block_in[b];
+        for(unsigned i=starts[b]; i<starts[b+1]; i++) {
+            const OPCODE opc = prog.insts[i].first;
+            const inst_tokens_t& toks = prog.insts[i].second;
+            const const_state_s before = state;
+            const_step(prog, i, state);
+            rows.push_back(program_rows(prog, i));
+            if(!before.reached || opc < ADD || opc >= CMP)
+                continue;
+
+            // operands of `NOT Rd, Rn` and `OP Rd, Rn, Rm`
+            mword_t regs[MAX_OPR] = {};
+            for(unsigned o=0; o<toks.size()-1; o++)
+                encode_register(toks[1+o], regs[o]);
+            const known_bits_s& n_bits = before.regs[regs[1]];
+            const known_bits_s& m_bits = before.regs[regs[2]];
+            known_bits_s carry_out;
+            const known_bits_s res = known_alu(opc, n_bits, m_bits,
+                before.carry, carry_out);
+            inst_row_s& row = rows.back();
+            if(is_known(res) && fits_imm(res.ones)
+                    && !(live_after[i] & (1u<<FLAGS_BIT))
+                    && cycle_cost(MOVIM, model) <= cycle_cost(opc, model)) {
+                row.opcode = MOVIM;
+                row.toks = { opcode_mnemonic(MOVIM), toks[1],
+                    to_string(static_cast<int16_t>(res.ones)) };
+                row.toks_raw = row.toks;
+                add_note(row.note, "folded " + opcode_mnemonic(opc)
+                    + ", result known");
+                n_folded++;
+                continue;
+            }
+
+            OPCODE red_opc;
+            unsigned src;
+            mword_t amount;
+            if(!reduced_op(opc, n_bits, m_bits, red_opc, src, amount))
+                continue;
+            const mword_t x = regs[1+src];
+            const string note = "reduced " + opcode_mnemonic(opc) + " by "
+                + to_string(before.regs[regs[2-src]].ones) + " to "
+                + opcode_mnemonic(red_opc);
+            // a register already holding the amount costs nothing
+            unsigned r = 0;
+            while(r < PC_REG && !(is_known(before.regs[r])
+                    && before.regs[r].ones == amount))
+                r++;
+            if(r < PC_REG
+                    && cycle_cost(red_opc, model) <= cycle_cost(opc, model)) {
+                row.opcode = red_opc;
+                row.toks = { opcode_mnemonic(red_opc), toks[1],
+                    reg_token(x), reg_token(r) };
+                row.toks_raw = row.toks;
+                add_note(row.note, note);
+                n_reduced++;
+                continue;
+            }
+            // otherwise the amount goes in `Rd` or a register dead after
+            if(!fits_imm(amount) || cycle_cost(MOVIM, model)
+                    + cycle_cost(red_opc, model) > cycle_cost(opc, model))
+                continue;
+            r = 0;
+            while(regs[0] == x && r < PC_REG
+                    && (r == x || (live_after[i] & (1u<<r))))
+                r++;
+            if(regs[0] != x)
+                r = regs[0];
+            if(r >= PC_REG)
+                continue;
+            inst_row_s red_row = row;
+            row.opcode = MOVIM;
+            row.toks = { opcode_mnemonic(MOVIM), reg_token(r),
+                to_string(amount) };
+            row.toks_raw = row.toks;
+            add_note(row.note, string(red_opc == AND ? "mask" : "shift")
+                + " for the " + opcode_mnemonic(red_opc) + " below");
+            red_row.opcode = red_opc;
+            red_row.toks = { opcode_mnemonic(red_opc), toks[1], reg_token(x),
+                reg_token(r) };
+            red_row.toks_raw = red_row.toks;
+            red_row.origin = -1;
+            red_row.note.clear();
+            add_note(red_row.note, note);
+            rows.push_back(red_row);
+            n_reduced++;
+        }
+    }
+    if(n_folded > 0 || n_reduced > 0)
+        rewrite_program(prog, rows);
+}
+
+/* ------------------------------------------------------------------------- *
+ * eliminate_dead_writes
+ * - Computes register and flag liveness over the whole program and finds
+ *     the `MOV` and ALU instructions whose results are never read, along
+ *     with the ones only read by those (repeated until none are left).
+ * - Everything is live at `HALT`, after writes to the PC, and past the
+ *     end of the program, and writes to the PC are never dead.
+ * - When `apply` is true, the dead instructions are removed, with labels
+ *     and branch targets moving to the next instruction that is kept.
+ *     Programs that read or write the PC are only reported, since their
+ *     computed addresses can't follow the removed instructions.
+ * - When `report` is true, prints the dead writes by source line to
+ *     standard error.
+ * - Counts the removed instructions in `n_removed`.
+ * ------------------------------------------------------------------------- */
+void eliminate_dead_writes(prog_s& prog, bool apply, bool report,
+        unsigned& n_removed) {
+    const unsigned n = prog.insts.size();
+    n_removed = 0;
+
+    // collect register and flag uses and writes
+    // ---------------------------------------------------------------------
+    vector<unsigned> uses(n), defs(n);
+    for(unsigned i=0; i<n; i++)
+        inst_regs(prog.insts[i].first, prog.insts[i].second, uses[i], defs[i]);
+
+    // mark dead writes until no more results lose their last reader
+    // ---------------------------------------------------------------------
+    vector<bool> dead(n, false);
+    unsigned n_dead = 0;
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        const vector<unsigned> live_after = live_after_insts(prog, uses, defs,
+            dead);
+        for(unsigned i=0; i<n; i++) {
+            const OPCODE opc = prog.insts[i].first;
+            const bool is_write = opc == MOVRR || opc == MOVIM
+                || opc == MOVRF || opc == MOVFR || (opc >= ADD && opc <= CMP);
+            if(dead[i] || !is_write || defs[i] == 0
+                    || (defs[i] & (1u<<PC_REG)) || (defs[i] & live_after[i]))
+                continue;
+            dead[i] = true;
+            n_dead++;
+            changed = true;
+        }
+    }
+
+    // report dead writes by source line
+    // ---------------------------------------------------------------------
+    if(report) {
+        cerr << "=== DEAD WRITE REPORT (" << n_dead << " of " << n
+             << " instructions) ===" << endl
+             << "  ADDR:  LINE | INSTRUCTION                  | WRITES" << endl
+             << "--------------+------------------------------+-------"
+             << endl;
+        for(unsigned i=0; i<n; i++) {
+            if(!dead[i])
+                continue;
+            string writes;
+            for(unsigned r=0; r<=FLAGS_BIT; r++) {
+                if(defs[i] & (1u<<r))
+                    writes += (writes.empty() ? "" : ", ")
+                        + (r == FLAGS_BIT ? string("FLAGS") : reg_token(r));
+            }
+            cerr << " 0x" << to_hex_string(i, IMM) << ": "
+                 << setw(5) << right << prog.debug_line_nums[i] << " | "
+                 << setw(28) << left << listing_str(prog, i) << right << " | "
+                 << writes
+                 << endl;
+        }
+        cerr << endl;
+    }
+
+    // remove dead writes unless addresses are computed from the PC
+    // ---------------------------------------------------------------------
+    if(!apply || n_dead == 0)
+        return;
+    const int pc_inst = find_pc_inst(prog);
+    if(pc_inst >= 0) {
+        cerr << "Warning: line[" << line_ref(prog, pc_inst) << "]: "
+             << "uses the PC, so dead writes are kept to keep computed "
+             << "addresses valid:"
+             << endl;
+        inst_error_marker(prog.insts_raw[pc_inst], MAX_OPR);
+        return;
+    }
+    anchor_branch_offsets(prog);
+    vector<inst_row_s> rows;
+    for(unsigned i=0; i<n; i++) {
+        if(!dead[i])
+            rows.push_back(program_rows(prog, i));
+    }
+    n_removed = n_dead;
+    rewrite_program(prog, rows);
+}
+
+/* ------------------------------------------------------------------------- *
+ * track_carry
+ * - Follows the state of the carry flag along the control flow of the
+ *     program, starting clear at reset: `ADD`, `SUB` and `MOV Flags, Rn`
+ *     leave a carry meant for the next instruction (chained), `CMP` leaves
+ *     a borrow nobody asked for, `AND` (`CLC`) clears it, and the carry
+ *     of every other ALU op isn't documented, so it's stale too.
+ * - A chained carry that reaches another block, along with the carry at
+ *     labels of programs that write the PC, is stale, and `ADD`/`SUB`
+ *     reading a stale carry are warned about.
+ * - A `CLC` is redundant when the carry is clear on every path reaching it
+ *     and the N and Z flags it sets are never read.
+ * - When `apply` is true, redundant `CLC`s are removed, unless the program
+ *     reads or writes the PC. Each decision is noted in the listing.
+ * - When `report` is true, prints the carry reaching each `CLC`, `ADD` and
+ *     `SUB` to standard error.
+ * - Counts the removed instructions in `n_removed`.
+ * ------------------------------------------------------------------------- */
+void track_carry(prog_s& prog, bool apply, bool report, unsigned& n_removed) {
+    const unsigned n = prog.insts.size();
+    n_removed = 0;
+
+    // collect uses and writes, splitting the carry (`CARRY_BIT`) from the
+    //   N and Z flags (`FLAGS_BIT`) since `ADD`/`SUB` only read the carry
+    // ---------------------------------------------------------------------
+    vector<unsigned> uses(n), defs(n);
+    vector<bool> is_clc(n, false);
+    bool writes_pc = false;
+    for(unsigned i=0; i<n; i++) {
+        const OPCODE opc = prog.insts[i].first;
+        const inst_tokens_t& toks = prog.insts[i].second;
+        inst_regs(opc, toks, uses[i], defs[i]);
+        if(defs[i] & (1u<<FLAGS_BIT))
+            defs[i] |= 1u<<CARRY_BIT;
+        if(opc == ADD || opc == SUB)
+            uses[i] = (uses[i] & ~(1u<<FLAGS_BIT)) | (1u<<CARRY_BIT);
+        else if(opc == MOVRF)
+            uses[i] |= 1u<<CARRY_BIT;
+        writes_pc |= (defs[i] & (1u<<PC_REG)) != 0;
+        // `CLC` is parsed as its expansion in `PSUEDO_ISA`
+        is_clc[i] = opc == AND && toks.size() == 4 && toks[1] == "R0"
+            && toks[2] == "R0" && toks[3] == "R0";
+    }
+
+    // carry reaching each instruction, joined to the worst state seen
+    // ---------------------------------------------------------------------
+    const vector<unsigned> starts = block_starts(prog);
+    vector<bool> is_start(n+1, false);
+    for(auto it=starts.begin(); it!=starts.end(); ++it)
+        is_start[*it] = true;
+    vector<CARRY_STATE> carry_in(n, CARRY_NONE);
+    if(n > 0)
+        carry_in[0] = prog.relocatable ? CARRY_STALE : CARRY_CLEAR;
+    // computed jumps may land on any label with any carry, and so may
+    //   other objects branching to global labels
+    for(auto it=prog.labels.begin(); it!=prog.labels.end(); ++it) {
+        if(it->address < n
+                && (writes_pc || prog.global_labels.count(it->name)))
+            carry_in[it->address] = CARRY_STALE;
+    }
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        // a chained carry only belongs to the next instruction of its block
+        auto join = [&](unsigned to, CARRY_STATE state) {
+            if(to >= n)
+                return;
+            if(state == CARRY_CHAINED && is_start[to])
+                state = CARRY_STALE;
+            if(state > carry_in[to]) {
+                carry_in[to] = state;
+                changed = true;
+            }
+        };
+        for(unsigned i=0; i<n; i++) {
+            if(carry_in[i] == CARRY_NONE)
+                continue;
+            const OPCODE opc = prog.insts[i].first;
+            CARRY_STATE out = carry_in[i];
+            if(opc == ADD || opc == SUB || opc == MOVFR)
+                out = CARRY_CHAINED;
+            else if(opc == AND)
+                out = CARRY_CLEAR;
+            else if(opc >= ADD && opc <= CMP)
+                out = CARRY_STALE;
+            if(opc == HALT || (defs[i] & (1u<<PC_REG)))
+                continue;
+            if(opc != B)
+                join(i+1, out);
+            if(OPC_TO_FMT.at(opc) == B_TYPE) {
+                const int target = branch_target(prog, i);
+                if(target >= 0)
+                    join(target, out);
+            }
+        }
+    }
+
+    // decide on each `CLC` and warn of stale carries
+    // ---------------------------------------------------------------------
+    const vector<unsigned> live_after = live_after_insts(prog, uses, defs,
+        vector<bool>(n, false));
+    vector<bool> redundant(n, false);
+    vector<string> decisions(n);
+    unsigned n_redundant = 0;
+    for(unsigned i=0; i<n; i++) {
+        const OPCODE opc = prog.insts[i].first;
+        if(carry_in[i] == CARRY_NONE)
+            continue;
+        if(is_clc[i]) {
+            if(carry_in[i] != CARRY_CLEAR)
+                decisions[i] = "CLC kept, carry may be set";
+            else if(live_after[i] & (1u<<FLAGS_BIT))
+                decisions[i] = "CLC kept, its N/Z flags are read";
+            else {
+                decisions[i] = "CLC redundant, carry already clear";
+                redundant[i] = true;
+                n_redundant++;
+            }
+        }
+        else if((opc == ADD || opc == SUB) && carry_in[i] == CARRY_STALE) {
+            decisions[i] = string("may ") + (opc == ADD ? "add" : "subtract")
+                + " a stale carry";
+            cerr << "Warning: line[" << line_ref(prog, i) << "]: "
+                 << decisions[i] << ", the carry isn't cleared on every "
+                 << "path reaching it:"
+                 << endl;
+            inst_error_marker(prog.insts_raw[i], MAX_OPR);
+        }
+        if(!decisions[i].empty())
+            add_note(prog.debug_notes[i], decisions[i]);
+    }
+
+    // report the carry reaching each instruction that reads or clears it
+    // ---------------------------------------------------------------------
+    if(report) {
+        cerr << "=== CARRY REPORT (" << n_redundant << " redundant CLC"
+             << (n_redundant == 1 ? "" : "s") << ") ===" << endl
+             << "  ADDR:  LINE | INSTRUCTION                  | CARRY IN  "
+             << "| DECISION" << endl
+             << "--------------+------------------------------+-----------"
+             << "+---------"
+             << endl;
+        for(unsigned i=0; i<n; i++) {
+            const OPCODE opc = prog.insts[i].first;
+            if(!is_clc[i] && opc != ADD && opc != SUB)
+                continue;
+            cerr << " 0x" << to_hex_string(i, IMM) << ": "
+                 << setw(5) << right << prog.debug_line_nums[i] << " | "
+                 << setw(28) << left << listing_str(prog, i) << " | "
+                 << setw(9) << CARRY_NAMES[carry_in[i]] << right << " | "
+                 << decisions[i]
+                 << endl;
+        }
+        cerr << endl;
+    }
+
+    // remove redundant `CLC`s unless addresses are computed from the PC
+    // ---------------------------------------------------------------------
+    if(!apply || n_redundant == 0)
+        return;
+    const int pc_inst = find_pc_inst(prog);
+    if(pc_inst >= 0) {
+        cerr << "Warning: line[" << line_ref(prog, pc_inst) << "]: "
+             << "uses the PC, so redundant CLCs are kept to keep computed "
+             << "addresses valid:"
+             << endl;
+        inst_error_marker(prog.insts_raw[pc_inst], MAX_OPR);
+        return;
+    }
+    anchor_branch_offsets(prog);
+    vector<inst_row_s> rows;
+    vector<unsigned> removed_lines;
+    for(unsigned i=0; i<n; i++) {
+        if(redundant[i]) {
+            removed_lines.push_back(prog.debug_line_nums[i]);
+            continue;
+        }
+        rows.push_back(program_rows(prog, i));
+        for(auto it=removed_lines.begin(); it!=removed_lines.end(); ++it)
+            add_note(rows.back().note, "removed redundant CLC of line "
+                + to_string(*it));
+        removed_lines.clear();
+    }
+    n_removed = n_redundant;
+    rewrite_program(prog, rows);
+}
+
+// issue distance after which the result of `opc` can be read without stalls
+unsigned result_distance(OPCODE opc, const pipe_model_s& model) {
+    const bool is_load = opc == LDR || opc == LDRO;
+    const unsigned writeback = max(1u, model.stages-2);
+    const unsigned ready = 1 + (is_load ? model.load_latency : 0);
+    switch(model.forwarding) {
+        case FWD_ALL:   return ready;
+        case FWD_ALU:   return is_load ? max(ready, writeback) : 1;
+        default:        return max(ready, writeback);
+    }
+}
+
+// estimates data hazard stall cycles of issuing `order` in sequence,
+//   assuming every value from before the sequence is ready
+unsigned estimate_stalls(const prog_s& prog, const vector<unsigned>& order,
+        const vector<unsigned>& uses, const vector<unsigned>& defs,
+        const pipe_model_s& model) {
+    long long ready[FLAGS_BIT+1] = { 0 };
+    long long t = 0;
+    unsigned stalls = 0;
+    for(auto it=order.begin(); it!=order.end(); ++it) {
+        long long issue = t;
+        for(unsigned r=0; r<=FLAGS_BIT; r++) {
+            if(r != PC_REG && (uses[*it] & (1u<<r)))
+                issue = max(issue, ready[r]);
+        }
+        stalls += issue - t;
+        for(unsigned r=0; r<=FLAGS_BIT; r++) {
+            if(defs[*it] & (1u<<r))
+                ready[r] = issue + result_distance(prog.insts[*it].first,
+                    model);
+        }
+        t = issue + 1;
+    }
+    return stalls;
+}
+
+// list schedules the window `[b, e)`, returning the new order of indices
+vector<unsigned> schedule_window(const prog_s& prog, unsigned b, unsigned e,
+        const vector<unsigned>& uses, const vector<unsigned>& defs,
+        const pipe_model_s& model) {
+    const unsigned n = e-b;
+    const unsigned reg_mask = (1u<<FLAGS_BIT)-1;
+    const unsigned flag_bit = 1u<<FLAGS_BIT;
+    vector<vector<unsigned>> succs(n);
+    vector<unsigned> n_preds(n, 0);
+    vector<unsigned> lats(n, 0);
+    auto add_edge = [&](unsigned i, unsigned j) {
+        if(find(succs[i].begin(), succs[i].end(), j) == succs[i].end()) {
+            succs[i].push_back(j);
+            n_preds[j]++;
+        }
+    };
+
+    // register and memory dependencies
+    // ---------------------------------------------------------------------
+    for(unsigned j=0; j<n; j++) {
+        const OPCODE opc_j = prog.insts[b+j].first;
+        const bool load_j = opc_j == LDR || opc_j == LDRO;
+        const bool store_j = opc_j == STR || opc_j == STRO;
+        lats[j] = result_distance(opc_j, model);
+        for(unsigned i=0; i<j; i++) {
+            const OPCODE opc_i = prog.insts[b+i].first;
+            const bool load_i = opc_i == LDR || opc_i == LDRO;
+            const bool store_i = opc_i == STR || opc_i == STRO;
+            if((defs[b+i] & (uses[b+j] | defs[b+j]) & reg_mask)
+                    || (uses[b+i] & defs[b+j] & reg_mask)
+                    || (store_i && (load_j || store_j))
+                    || (load_i && store_j))
+                add_edge(i, j);
+        }
+    }
+
+    // flag dependencies: each reader keeps the write it sees, and the last
+    //   write stays last since the flags may be tested after the window
+    // ---------------------------------------------------------------------
+    vector<unsigned> pending;   // writes since the last read
+    vector<unsigned> readers;   // reads of the last write before `pending`
+    int last_write = -1;
+    for(unsigned j=0; j<n; j++) {
+        if(uses[b+j] & flag_bit) {
+            if(!pending.empty()) {
+                for(auto it=pending.begin(); it!=pending.end(); ++it) {
+                    if(static_cast<int>(*it) != last_write)
+                        add_edge(*it, last_write);
+                }
+                pending.clear();
+                readers.clear();
+            }
+            if(last_write >= 0)
+                add_edge(last_write, j);
+            readers.push_back(j);
+        }
+        if(defs[b+j] & flag_bit) {
+            for(auto it=readers.begin(); it!=readers.end(); ++it) {
+                if(*it != j)
+                    add_edge(*it, j);
+            }
+            pending.push_back(j);
+            last_write = j;
+        }
+    }
+    for(auto it=pending.begin(); it!=pending.end(); ++it) {
+        if(static_cast<int>(*it) != last_write)
+            add_edge(*it, last_write);
+    }
+
+    // block terminators stay last
+    // ---------------------------------------------------------------------
+    if(ends_block(prog.insts[e-1].first, defs[e-1])) {
+        for(unsigned i=0; i+1<n; i++)
+            add_edge(i, n-1);
+    }
+
+    // critical path heights, latency only counts along true dependencies
+    // ---------------------------------------------------------------------
+    vector<unsigned> heights(n, 0);
+    for(unsigned i=n; i-->0; ) {
+        for(auto it=succs[i].begin(); it!=succs[i].end(); ++it) {
+            const unsigned lat = (defs[b+i] & uses[b+*it]) ? lats[i] : 0;
+            heights[i] = max(heights[i], lat + heights[*it]);
+        }
+    }
+
+    // greedily issue the ready instruction that stalls least, preferring
+    //   the longest critical path, then source order
+    // ---------------------------------------------------------------------
+    long long ready[FLAGS_BIT+1] = { 0 };
+    long long t = 0;
+    vector<unsigned> order;
+    vector<bool> done(n, false);
+    while(order.size() < n) {
+        int best = -1;
+        long long best_issue = 0;
+        for(unsigned j=0; j<n; j++) {
+            if(done[j] || n_preds[j] > 0)
+                continue;
+            long long issue = t;
+            for(unsigned r=0; r<=FLAGS_BIT; r++) {
+                if(r != PC_REG && (uses[b+j] & (1u<<r)))
+                    issue = max(issue, ready[r]);
+            }
+            if(best < 0 || issue < best_issue
+                    || (issue == best_issue && heights[j] > heights[best])) {
+                best = j;
+                best_issue = issue;
+            }
+        }
+        done[best] = true;
+        order.push_back(b+best);
+        for(auto it=succs[best].begin(); it!=succs[best].end(); ++it)
+            n_preds[*it]--;
+        for(unsigned r=0; r<=FLAGS_BIT; r++) {
+            if(defs[b+best] & (1u<<r))
+                ready[r] = best_issue + lats[best];
+        }
+        t = best_issue + 1;
+    }
+    return order;
+}
+
+/* ------------------------------------------------------------------------- *
+ * schedule_program
+ * - Reorders independent instructions within basic blocks to hide the
+ *     load-use and flag hazards of the pipeline described by `model`.
+ * - Blocks are split at labels, branch targets, and after branches,
+ *     `HALT`, and writes to the PC. Reads of the PC are never moved, and
+ *     blocks are scheduled in windows of at most `SCHED_WINDOW` insts.
+ * - Register, flag and memory dependencies are kept, with the last flag
+ *     write of each window kept last since a later block may test it.
+ * - A window is only reordered when its estimated stall count drops.
+ * - When `apply` is false, nothing is reordered and only the estimates
+ *     are computed, for a report of the unscheduled program.
+ * - When `report` is true, prints per-block stall cycles before and after
+ *     scheduling to standard error.
+ * ------------------------------------------------------------------------- */
+void schedule_program(prog_s& prog, const pipe_model_s& model, bool apply,
+        bool report) {
+    const unsigned n = prog.insts.size();
+    vector<unsigned> uses(n);
+    vector<unsigned> defs(n);
+    for(unsigned i=0; i<n; i++)
+        inst_regs(prog.insts[i].first, prog.insts[i].second, uses[i], defs[i]);
+
+    // first label name at each address, for the report
+    map<unsigned, string> label_names;
+    for(auto it=prog.labels.rbegin(); it!=prog.labels.rend(); ++it)
+        label_names[it->address] = it->name;
+
+    if(report) {
+        cerr << "=== HAZARD REPORT (stages=" << model.stages
+             << ", fwd=" << FWD_NAMES[model.forwarding]
+             << ", load=" << model.load_latency
+             << ", branch=" << model.branch_penalty << ") ===" << endl
+             << "  ADDR: INSTS | STALLS BEFORE -> AFTER | BRANCH | LABEL"
+             << endl
+             << "-------------+------------------------+--------+------"
+             << endl;
+    }
+
+    // schedule each basic block in windows
+    // ---------------------------------------------------------------------
+    const vector<unsigned> starts = block_starts(prog);
+    vector<inst_row_s> rows = program_rows(prog);
+    bool reordered = false;
+    unsigned total_before = 0;
+    unsigned total_after = 0;
+    unsigned total_branch = 0;
+    for(unsigned k=0; k+1<starts.size(); k++) {
+        unsigned block_before = 0;
+        unsigned block_after = 0;
+        unsigned b = starts[k];
+        while(b < starts[k+1]) {
+            // PC reads are pinned into windows of their own
+            unsigned e = b+1;
+            while(e < starts[k+1] && e-b < SCHED_WINDOW
+                    && !(uses[b] & (1u<<PC_REG))
+                    && !(uses[e] & (1u<<PC_REG)))
+                e++;
+            vector<unsigned> order(e-b);
+            for(unsigned i=b; i<e; i++)
+                order[i-b] = i;
+            const unsigned before = estimate_stalls(prog, order, uses, defs,
+                model);
+            unsigned after = before;
+            if(apply && before > 0) {
+                order = schedule_window(prog, b, e, uses, defs, model);
+                const unsigned sched_stalls = estimate_stalls(prog, order,
+                    uses, defs, model);
+                if(sched_stalls < before) {
+                    // rows keep their positions so labels stay put
+                    after = sched_stalls;
+                    for(unsigned i=b; i<e; i++) {
+                        rows[i] = program_rows(prog, order[i-b]);
+                        rows[i].origin = i;
+                    }
+                    reordered = true;
+                }
+            }
+            block_before += before;
+            block_after += after;
+            b = e;
+        }
+
+        // taken branches refill the pipeline
+        const unsigned last = starts[k+1]-1;
+        const unsigned branch = OPC_TO_FMT.at(prog.insts[last].first) == B_TYPE
+                || (defs[last] & (1u<<PC_REG))
+            ? model.branch_penalty : 0;
+        total_before += block_before;
+        total_after += block_after;
+        total_branch += branch;
+        if(report) {
+            cerr << " 0x" << to_hex_string(starts[k], IMM) << ": "
+                 << setw(5) << right << starts[k+1]-starts[k] << " | "
+                 << setw(13) << block_before << " -> "
+                 << setw(5) << block_after << " | "
+                 << setw(6) << branch << " | "
+                 << (label_names.count(starts[k]) ? label_names[starts[k]] : "")
+                 << endl;
+        }
+    }
+    if(report) {
+        cerr << "-------------+------------------------+--------+------"
+             << endl
+             << "      " << setw(6) << right << n << " | "
+             << setw(13) << total_before << " -> "
+             << setw(5) << total_after << " | "
+             << setw(6) << total_branch << " | (TOTAL, every branch taken)"
+             << endl << endl;
+    }
+
+    if(reordered)
+        rewrite_program(prog, rows);
+}
+
+/* ------------------------------------------------------------------------- *
+ * relax_branches
+ * - Layout pass run between parsing and encoding, rewrites every B-type
+ *     branch whose target is out of range of the 12-bit offset into a
+ *     long branch through register `reg` (and `scratch_reg` if given):
+ *   - `B L`   -> `LDI reg, L[, scratch_reg]`, `MOV R7, reg`
+ *   - `BEQ L` -> `BNE` over the long branch above (`BNE` likewise)
+ * - Repeats until no more addresses change, long branches never shrink
+ *     back (they are padded with `NOP` instead) so the layout converges.
+ * - Returns true upon succesful completion, counting the branches that
+ *     were relaxed in `n_relaxed`.
+ * - Returns false if a target can't be loaded with the given registers,
+ *     a branch of a relocatable program (`-c`, `-L` sources) is out of
+ *     range, or the program outgrows instruction memory.
+ * ------------------------------------------------------------------------- */
+bool relax_branches(prog_s& prog, mword_t reg, bool use_scratch,
+        mword_t scratch_reg, unsigned& n_relaxed) {
+    const unsigned n = prog.insts.size();
+    const mword_t regs[2] = { reg, scratch_reg };
+    n_relaxed = 0;
+
+    // resolve branch targets as instruction indices
+    // ---------------------------------------------------------------------
+    vector<int> targets(n, -1);
+    for(unsigned i=0; i<n; i++) {
+        if(OPC_TO_FMT.at(prog.insts[i].first) == B_TYPE)
+            targets[i] = branch_target(prog, i);
+    }
+
+    // grow out-of-range branches until addresses settle
+    // ---------------------------------------------------------------------
+    vector<unsigned> lens(n, 1);
+    vector<unsigned> addrs(n+1, 0);
+    vector<ldi_seq_t> seqs(n);
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(unsigned i=0; i<n; i++)
+            addrs[i+1] = addrs[i] + lens[i];
+
+        // error: instruction overflow
+        if(addrs[n] > MAX_INST) {
+            cerr << "Error: relaxed program instruction count exceeds limit ("
+                 << "max = " << MAX_INST << ")"
+                 << endl;
+            return false;
+        }
+
+        for(unsigned i=0; i<n; i++) {
+            if(targets[i] < 0)
+                continue;
+            const mword_t target_addr = addrs[targets[i]];
+            const long long offset = addrs[targets[i]] - (addrs[i]+1LL);
+            if(seqs[i].empty() && offset >= IMM_MIN && offset <= IMM_MAX)
+                continue;
+
+            // error: long branches load absolute addresses, which an
+            //        object only gets once it's linked
+            if(prog.relocatable) {
+                cerr << "Error: line[" << line_ref(prog, i)
+                     << "]: branch out of range can't be relaxed in a "
+                     << "relocatable object, since its addresses are only "
+                     << "known once it's linked:"
+                     << endl;
+                inst_error_marker(prog.insts_raw[i], MAX_OPR);
+                return false;
+            }
+
+            // error: target can't be loaded with the given registers
+            if(!materialize_constant(target_addr, use_scratch, seqs[i])) {
+                cerr << "Error: line[" << line_ref(prog, i)
+                     << "]: could not relax branch to address 0x"
+                     << to_hex_string(target_addr) << " using only '"
+                     << reg_token(reg) << "', add a scratch register to `-b`:"
+                     << endl;
+                inst_error_marker(prog.insts_raw[i], 1);
+                return false;
+            }
+
+            // conditionals branch over the long branch when not taken
+            const unsigned len = (prog.insts[i].first != B)
+                + seqs[i].size() + 1;
+            if(len > lens[i]) {
+                lens[i] = len;
+                changed = true;
+            }
+        }
+    }
+
+    // warn about computed jumps, they can't follow the moved code
+    // ---------------------------------------------------------------------
+    if(addrs[n] == n)
+        return true;
+    for(unsigned i=0; i<n; i++) {
+        unsigned uses, defs;
+        inst_regs(prog.insts[i].first, prog.insts[i].second, uses, defs);
+        if(defs & (1u<<PC_REG)) {
+            cerr << "Warning: line[" << line_ref(prog, i) << "]: "
+                 << "writes to the PC, but relaxed branches move code so "
+                 << "computed jump targets may be stale:"
+                 << endl;
+            inst_error_marker(prog.insts_raw[i], MAX_OPR);
+            break;
+        }
+    }
+
+    // rebuild instruction list with long branches spliced in
+    // ---------------------------------------------------------------------
+    anchor_branch_offsets(prog);
+    const vector<inst_row_s> old_rows = program_rows(prog);
+    vector<inst_row_s> rows;
+    for(unsigned i=0; i<n; i++) {
+        if(seqs[i].empty()) {
+            rows.push_back(old_rows[i]);
+            continue;
+        }
+        n_relaxed++;
+        const unsigned first = rows.size();
+        const OPCODE opc = prog.insts[i].first;
+        inst_row_s row = old_rows[i];
+        row.origin = -1;
+        if(opc != B) {
+            row.opcode = opc == BEQ ? BNE : BEQ;
+            row.toks = { opcode_mnemonic(row.opcode),
+                to_string(lens[i]-1) };
+            rows.push_back(row);
+        }
+        for(auto it=seqs[i].begin(); it!=seqs[i].end(); ++it) {
+            row.opcode = it->opcode;
+            row.toks = ldi_step_tokens(*it, regs);
+            rows.push_back(row);
+        }
+        row.opcode = MOVRR;
+        row.toks = { opcode_mnemonic(MOVRR), reg_token(PC_REG),
+            reg_token(reg) };
+        rows.push_back(row);
+        while(rows.size()-first < lens[i]) {
+            row.opcode = NOP;
+            row.toks = { opcode_mnemonic(NOP) };
+            rows.push_back(row);
+        }
+        // first row takes the branch's labels, all rows note the branch
+        rows[first].origin = i;
+        for(unsigned r=first; r<rows.size(); r++) {
+            rows[r].toks_raw = rows[r].toks;
+            rows[r].note = "relaxed " + to_string(prog.insts_raw[i])
+                + " (" + to_string(r-first+1) + " of " + to_string(lens[i])
+                + ")";
+        }
+    }
+    rewrite_program(prog, rows);
+
+    // signal success
+    return true;
+}
+
+/* ------------------------------------------------------------------------- *
+ * encode_program
+ * - Second pass of input file, encodes tokenized instructions into their
+ *     appropriate hex machine code representation to build `prog.mcode`.
+ * - Returns true upon succesful completion.
+ * - Returns false if any operand cannot be encoded.
+ * ------------------------------------------------------------------------- */
+bool encode_program(prog_s& prog) {
+    // loop through parsed instruction list, encoding each instruction
+    // ---------------------------------------------------------------------
+    prog.mcode.resize(prog.insts.size());
+    for(unsigned i=0; i<prog.insts.size(); i++) {
+        if(!encode_inst(prog, i, prog.mcode[i]))
+            return false;
+    }
+
+    // signal success
+    return true;
+}
+
+/* ------------------------------------------------------------------------- *
+ * encode_inst
+ * - Encodes instruction `i` of `prog` into `enc_inst_buf`, replacing its
+ *     immediate tokens with their hex (and its extern branches with a
+ *     relocation).
+ * - Returns true upon succesful completion.
+ * - Returns false if any operand cannot be encoded.
+ * ------------------------------------------------------------------------- */
+bool encode_inst(prog_s& prog, unsigned i, mword_t& enc_inst_buf) {
+    // fetch instruction opcode, tokens, and format
+    // ---------------------------------------------------------------------
+    const OPCODE inst_opcode = prog.insts[i].first;
+    inst_tokens_t& inst_toks = prog.insts[i].second;
+    const inst_tokens_t& inst_raw_toks = prog.insts_raw[i];
+    const I_FMT inst_fmt = OPC_TO_FMT.at(inst_opcode);
+    const fmt_config_t fmt_config = FMT_CONFIG[inst_fmt];
+
+    // init encoded instruction buffer with the opcode set
+    // ---------------------------------------------------------------------
+    enc_inst_buf = inst_opcode;
+
+    // iterate through operands, encode them, then add them to buffer
+    // ---------------------------------------------------------------------
+    for(unsigned o=0; o<fmt_config.size(); o++) {
+        string& opr_str = inst_toks[1+o];
+        string opr_str_key = str_to_upper(opr_str);
+        // encode operand based on OPR_WIDTH for given instruction
+        auto opr_p = fmt_config[o].first;
+        auto opr_w = fmt_config[o].second;
+        mword_t opr_buf = 0;
+        if(opr_w == REG) {
+            // encode register
+            // error unknown register
+            if(!encode_register(opr_str, opr_buf)) {
+                cerr << "Error: line[" << line_ref(prog, i)
+                     << "]: could not encode " << ordinal_str(o+1)
+                     << " operand '" << opr_str
+                     << "', expected register between 'r0' and 'r"
+                     << MAX_REG << "':" 
+                     << endl;
+                inst_error_marker(inst_raw_toks, 1+o);
+                return false;
+            }
+            // replace token with caps version
+            // inst_toks[1+o] = opr_str_key;
+        }
+        else if(opr_w == IMM) {
+            smatch num_m;
+            long long parsed = 0;
+            bool parse_success = false;
+            bool parse_decimal = false;
+            bool parse_label = false;
+            bool parse_data_label = false;
+            bool parse_extern = false;
+            // try to find label and compute relative branch
+            if(inst_fmt == B_TYPE 
+                    && prog.label_lookup.count(opr_str_key) > 0) {
+                parse_success = true;
+                parse_label = true;
+                parsed = prog.label_lookup[opr_str_key] - (i+1LL);
+            }
+            // leave branches to extern labels for the linker
+            else if(inst_fmt == B_TYPE
+                    && prog.extern_labels.count(opr_str_key) > 0) {
+                // error: nothing to link with
+                if(!prog.linking) {
+                    cerr << "Error: line[" << line_ref(prog, i)
+                         << "]: could not encode " << ordinal_str(o+1)
+                         << " operand '" << opr_str
+                         << "', extern labels are only resolved by "
+                         << "linking (`-c` or `-L`):"
+                         << endl;
+                    inst_error_marker(inst_raw_toks, 1+o);
+                    return false;
+                }
+                parse_success = true;
+                parse_extern = true;
+                prog.relocs.push_back({ i, opr_str_key });
+            }
+            // try to find data label, sign-extended like the immediate
+            else if(inst_fmt != B_TYPE
+                    && prog.data_lookup.count(opr_str_key) > 0) {
+                parse_success = true;
+                parse_data_label = true;
+                parsed = static_cast<int16_t>(
+                    prog.data_lookup[opr_str_key]);
+            }
+            // try to parse as decimal
+            else if(regex_match(opr_str, num_m, dec_re)) {
+                parse_success = true;
+                parse_decimal = true;
+                parsed = strtoll(num_m[1].str().c_str(), nullptr, 10);
+            }
+            // try to parse as hex
+            else if(regex_match(opr_str, num_m, hex_re)) {
+                parse_success = true;
+                parsed = strtoll(num_m[1].str().c_str(), nullptr, 16);
+                if(num_m[1].length() > IMM_NIBS) {
+                    cerr << "Error: line[" << line_ref(prog, i)
+                         << "]: could not encode " << ordinal_str(o+1)
+                         << " operand '" << opr_str
+                         << "', hex value has too many nibbles ("
+                         << "max = " << IMM_NIBS << "):" 
+                         << endl;
+                    inst_error_marker(inst_raw_toks, 1+o);
+                    return false;
+                }
+                // convert to negative
+                if(parsed&(1<<(IMM-1)))
+                    parsed |= -1ULL<<IMM;
+            }
+            // try to parse as binary
+            else if(regex_match(opr_str, num_m, bin_re)) {
+                parse_success = true;
+                parsed = strtoll(num_m[1].str().c_str(), nullptr, 2);
+                // error: too many bits
+                if(num_m[1].length() > IMM) {
+                    cerr << "Error: line[" << line_ref(prog, i)
+                         << "]: could not encode " << ordinal_str(o+1)
+                         << " operand '" << opr_str
+                         << "', binary value has too many bits ("
+                         << "max = " << IMM << "):" 
+                         << endl;
+                    inst_error_marker(inst_raw_toks, 1+o);
+                    return false;
+                }
+                // convert to negative
+                if(parsed&(1<<(IMM-1)))
+                    parsed |= -1ULL<<IMM;
+            }
+
+            // error: could not encode immediate
+            if(!parse_success) {
+                cerr << "Error: line[" << line_ref(prog, i)
+                     << "]: could not encode " << ordinal_str(o+1)
+                     << " operand '" << opr_str
+                     << "', expected immediate value"
+                     << (inst_fmt == B_TYPE ? " or valid label" : "")
+                     << (inst_opcode == MOVIM
+                        ? ", register or data label" : "")
+                     << ":" 
+                     << endl;
+                inst_error_marker(inst_raw_toks, 1+o);
+                return false;
+            }
+            // error: out of bounds immediate
+            if(parsed < IMM_MIN || parsed > IMM_MAX) {
+                cerr << "Error: line[" << line_ref(prog, i)
+                     << "]: could not encode " << ordinal_str(o+1)
+                     << " operand '" << opr_str
+                     << "'" 
+                     << (parse_decimal 
+                            ? "" 
+                            : (" (" + to_string(parsed) + ")") )
+                     << ", "
+                     << (parse_label
+                            ? "branch offset from label "
+                            : parse_data_label
+                            ? "address of data label "
+                            : "immediate value ")
+                     << "out of range ["
+                     << IMM_MIN << ", " << IMM_MAX << "]:"
+                     << endl;
+                inst_error_marker(inst_raw_toks, 1+o);
+                return false;
+            }
+
+            // place parsed immediate into operand buffer
+            opr_buf = static_cast<mword_t>(parsed);
+            
+            // replace inst token with sanitized hex version, the offset
+            //   to an extern label is only known once linked
+            inst_toks[1+o] = parse_extern
+                ? opr_str_key + " ; (extern)"
+                : "0x" + to_hex_string(opr_buf, IMM)
+                + (inst_fmt==B_TYPE ? "    " : "")
+                + " ; (" + to_string(parsed)
+                + (parse_label || parse_data_label
+                    ? (" -> " + opr_str_key) : "") + ")";
+        }
+        else { // opr_w == NON
+            opr_buf = 0;
+        }
+        // mask opr_buf for width (shouldn't be necessary, but stay safe)
+        opr_buf &= WIDTH_TO_BITS(opr_w);
+        // shift opr_buf to proper position
+        opr_buf <<= opr_p;
+        // insert opr_buf into instruction buffer
+        enc_inst_buf |= opr_buf;
+    }
+
+    // signal success
+    return true;
+}
+
+/* ------------------------------------------------------------------------- *
+ * write_program
+ * - Writes the program to a given output file.
+ * -  File should be opened before calling this function.
+ * ------------------------------------------------------------------------- */
+void write_program(ofstream& out, const prog_s& prog) {
+    out << "v2.0 raw";
+    for(auto it=prog.mcode.begin(); it!=prog.mcode.end(); ++it)
+        out << endl << to_hex_string(*it);
+}
+
+/* ------------------------------------------------------------------------- *
+ * encode_data
+ * - Resolves the values of the data section into `prog.data` words, with
+ *     labels naming data addresses or (final) instruction addresses.
+ * - Returns true upon succesful completion.
+ * - Returns false if any value cannot be encoded.
+ * ------------------------------------------------------------------------- */
+bool encode_data(prog_s& prog) {
+    for(auto it=prog.data.begin(); it!=prog.data.end(); ++it) {
+        it->words.clear();
+        for(auto jt=it->toks.begin(); jt!=it->toks.end(); ++jt) {
+            const string key = str_to_upper(*jt);
+            long long parsed = 0;
+            if(parse_wide_immediate(substitute_symbols(key, prog.equs),
+                    parsed))
+                it->words.push_back(static_cast<mword_t>(parsed));
+            else if(prog.data_lookup.count(key) > 0)
+                it->words.push_back(prog.data_lookup.at(key));
+            else if(prog.label_lookup.count(key) > 0)
+                it->words.push_back(prog.label_lookup.at(key));
+            // error: undefined label
+            else {
+                cerr << "Error: line[" << it->line_num << "]: "
+                     << "could not encode data value '" << *jt
+                     << "', expected 16-bit value or valid label:"
+                     << endl;
+                line_error_marker(it->src, it->src.find(*jt), jt->size());
+                return false;
+            }
+        }
+    }
+
+    // signal success
+    return true;
+}
+
+/* ------------------------------------------------------------------------- *
+ * write_data
+ * - Writes the data section as a data memory image to a given output file,
+ *     with gaps and repeated values run-length encoded (`count*value`).
+ * - Words of `.incbin` files are written straight from their mapping.
+ * -  File should be opened before calling this function.
+ * ------------------------------------------------------------------------- */
+void write_data(ofstream& out, const prog_s& prog) {
+    out << "v2.0 raw";
+    unsigned address = 0;
+    for(auto it=prog.data.begin(); it!=prog.data.end(); ++it) {
+        // gaps left by `.org` and `.align` are zeros
+        if(it->address > address)
+            out << endl << (it->address - address) << "*0";
+        if(it->bytes != nullptr) {
+            for(size_t b=0; b<it->n_bytes; b+=2) {
+                const mword_t hi = b+1 < it->n_bytes ? it->bytes[b+1] : 0;
+                out << endl << to_hex_string(it->bytes[b] | hi<<8);
+            }
+        }
+        else if(it->words.size() == 1 && it->length > 1)
+            out << endl << it->length << "*" << to_hex_string(it->words[0]);
+        else {
+            for(auto jt=it->words.begin(); jt!=it->words.end(); ++jt)
+                out << endl << to_hex_string(*jt);
+        }
+        address = it->address + it->length;
+    }
+}
+
+/* ------------------------------------------------------------------------- *
+ * build_object
+ * - Lays out the encoded program as a relocatable object in `buf`: its
+ *     words, every label as a symbol (bound `.global` or local), every
+ *     `.extern` label, a relocation for each branch to one, and the source
+ *     line of each word.
+ * - `src_file` is stat'd so an unchanged source can reuse the object.
+ * ------------------------------------------------------------------------- */
+void build_object(const prog_s& prog, const char* src_file,
+        uint64_t opts_hash, string& buf) {
+    // string table starts with the source path
+    // ---------------------------------------------------------------------
+    string strs = string(src_file) + '\0';
+    auto add_str = [&strs](const string& str) -> uint32_t {
+        const uint32_t offset = strs.size();
+        strs += str + '\0';
+        return offset;
+    };
+
+    // symbols (without the hidden anchor labels), relocations and lines
+    // ---------------------------------------------------------------------
+    vector<obj_sym_s> syms;
+    map<string, uint32_t> sym_index;
+    for(auto it=prog.label_lookup.begin(); it!=prog.label_lookup.end(); ++it) {
+        if(it->first[0] == '@')
+            continue;
+        sym_index[it->first] = syms.size();
+        syms.push_back({ add_str(it->first), it->second,
+            prog.global_labels.count(it->first) ? SYM_GLOBAL : SYM_LOCAL });
+    }
+    for(auto it=prog.extern_labels.begin(); it!=prog.extern_labels.end();
+            ++it) {
+        sym_index[*it] = syms.size();
+        syms.push_back({ add_str(*it), 0, SYM_EXTERN });
+    }
+    vector<obj_reloc_s> relocs;
+    for(auto it=prog.relocs.begin(); it!=prog.relocs.end(); ++it)
+        relocs.push_back({ it->first, sym_index.at(it->second) });
+    vector<obj_line_s> lines;
+    for(unsigned i=0; i<prog.mcode.size(); i++)
+        lines.push_back({ prog.debug_line_nums[i], prog.debug_macro_lines[i] });
+
+    // header, then each array padded to 4 bytes
+    // ---------------------------------------------------------------------
+    obj_header_s hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, OBJ_MAGIC, sizeof(hdr.magic));
+    hdr.version = OBJ_VERSION;
+    hdr.n_words = prog.mcode.size();
+    hdr.n_syms = syms.size();
+    hdr.n_relocs = relocs.size();
+    hdr.str_size = strs.size();
+    struct stat st;
+    if(stat(src_file, &st) == 0) {
+        hdr.src_size = st.st_size;
+        hdr.src_mtime = mtime_ns(st);
+    }
+    hdr.opts_hash = opts_hash;
+    auto put = [&buf](const void* data, size_t size) {
+        buf.append(static_cast<const char*>(data), size);
+        buf.append((4 - size%4) % 4, '\0');
+    };
+    buf.clear();
+    put(&hdr, sizeof(hdr));
+    put(prog.mcode.data(), prog.mcode.size()*sizeof(mword_t));
+    put(syms.data(), syms.size()*sizeof(obj_sym_s));
+    put(relocs.data(), relocs.size()*sizeof(obj_reloc_s));
+    put(lines.data(), lines.size()*sizeof(obj_line_s));
+    put(strs.data(), strs.size());
+}
+
+/* ------------------------------------------------------------------------- *
+ * map_object
+ * - Maps the object file `obj.path` into memory and checks it, pointing
+ *     the arrays of `obj` into the mapping.
+ * - Returns false if the file can't be mapped or isn't a valid object,
+ *     only printing why if `quiet` isn't set.
+ * ------------------------------------------------------------------------- */
+bool map_object(obj_file_s& obj, bool quiet) {
+    const int fd = open(obj.path.c_str(), O_RDONLY);
+    struct stat st;
+    void* mapped = MAP_FAILED;
+    if(fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0)
+        mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(fd >= 0)
+        close(fd);
+    if(mapped == MAP_FAILED) {
+        if(!quiet) {
+            cerr << "Error: could not map object file '" << obj.path << "'"
+                 << endl;
+        }
+        return false;
+    }
+    if(!view_object(obj, static_cast<const char*>(mapped), st.st_size)) {
+        if(!quiet) {
+            cerr << "Error: '" << obj.path << "' is not an alARM object "
+                 << "(version " << OBJ_VERSION << ")"
+                 << endl;
+        }
+        munmap(mapped, st.st_size);
+        return false;
+    }
+    obj.mapped = static_cast<const char*>(mapped);
+    obj.size = st.st_size;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- *
+ * load_link_file
+ * - Loads a file given to `-L` into `obj`, mapping it if it's an object.
+ * - A source file is assembled into the object next to it (`.s` replaced
+ *     by `.o`), unless that object was built from the same source size,
+ *     modification time and options (including the `-r` rules file's
+ *     size and modification time), in which case it's reused as is.
+ * - Sources given to `-L` don't get `-O layout`, listings or reports.
+ * - Returns false if the file can't be assembled or loaded.
+ * ------------------------------------------------------------------------- */
+bool load_link_file(const prog_opts_s& opts, const string& path,
+        obj_file_s& obj) {
+    // objects are linked as they are
+    obj.path = path;
+    if(is_object_path(path))
+        return map_object(obj);
+    if(map_object(obj, true))
+        return true;
+
+    // error: missing file
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0) {
+        cerr << "Error: could not open linked file '" << path << "'" << endl;
+        return false;
+    }
+
+    // reuse the object of an unchanged source
+    // ---------------------------------------------------------------------
+    prog_opts_s src_opts = opts;
+    src_opts.list_flag = false;
+    src_opts.hazard_report_flag = false;
+    src_opts.dead_report_flag = false;
+    src_opts.carry_report_flag = false;
+    src_opts.layout_flag = false;
+    src_opts.profile_file = nullptr;
+    src_opts.entry_labels.clear();
+    const uint64_t hash = options_hash(src_opts);
+    obj.path = object_path(path);
+    if(map_object(obj, true)) {
+        if(obj.hdr->src_size == static_cast<uint64_t>(st.st_size)
+                && obj.hdr->src_mtime == mtime_ns(st)
+                && obj.hdr->opts_hash == hash) {
+            cerr << "Reused '" << obj.path << "' of unchanged '" << path << "'"
+                 << endl;
+            return true;
+        }
+        unmap_object(obj);
+    }
+
+    // assemble the source into its object
+    // ---------------------------------------------------------------------
+    prog_s prog;
+    prog.linking = true;
+    prog.relocatable = true;
+    if(!assemble_program(src_opts, path.c_str(), prog))
+        return false;
+    unmap_data(prog);
+    // error: data can't be relocated
+    if(!prog.data.empty()) {
+        cerr << "Error: data section of '" << path << "' can't be linked, "
+             << "only the source file of a link can have data"
+             << endl;
+        return false;
+    }
+    build_object(prog, path.c_str(), hash, obj.buf);
+    ofstream fobj;
+    fobj.open(obj.path, ios::binary);
+    if(fobj.fail()) {
+        cerr << "Error: could not open object file '" << obj.path << "'"
+             << endl;
+        return false;
+    }
+    fobj.write(obj.buf.data(), obj.buf.size());
+    fobj.close();
+    cerr << "Assembled '" << path << "' into '" << obj.path << "'" << endl;
+    return view_object(obj, obj.buf.data(), obj.buf.size());
+}
+
+/* ------------------------------------------------------------------------- *
+ * link_objects
+ * - Places `objs` one after another from address 0 into `image`,
+ *     resolving each `.extern` label to the `.global` label of the same
+ *     name and patching the branches to it.
+ * - Returns false if a label is global in two objects, an extern label
+ *     isn't global anywhere, a patched branch is out of range, or the
+ *     image outgrows instruction memory.
+ * ------------------------------------------------------------------------- */
+bool link_objects(const vector<obj_file_s>& objs, vector<mword_t>& image) {
+    // place objects and collect their global labels
+    // ---------------------------------------------------------------------
+    vector<unsigned> bases(objs.size());
+    map<string, pair<unsigned,unsigned>> globals;
+    unsigned n_words = 0;
+    for(unsigned o=0; o<objs.size(); o++) {
+        const obj_file_s& obj = objs[o];
+        bases[o] = n_words;
+        n_words += obj.hdr->n_words;
+        // error: instruction overflow
+        if(n_words > MAX_INST) {
+            cerr << "Error: linked program outgrows instruction memory at '"
+                 << obj.path << "' ("
+                 << "max = " << MAX_INST << ")"
+                 << endl;
+            return false;
+        }
+        for(unsigned s=0; s<obj.hdr->n_syms; s++) {
+            if(obj.syms[s].bind != SYM_GLOBAL)
+                continue;
+            const string name = obj.strs + obj.syms[s].name;
+            // error: global label defined twice
+            if(globals.count(name) > 0) {
+                cerr << "Error: label '" << name << "' is global in both '"
+                     << objs[globals[name].first].path << "' and '"
+                     << obj.path << "'"
+                     << endl;
+                return false;
+            }
+            globals[name] = { o, bases[o] + obj.syms[s].address };
+        }
+    }
+
+    // copy words and patch the branches to extern labels
+    // ---------------------------------------------------------------------
+    image.clear();
+    image.reserve(n_words);
+    for(auto it=objs.begin(); it!=objs.end(); ++it)
+        image.insert(image.end(), it->words, it->words + it->hdr->n_words);
+    for(unsigned o=0; o<objs.size(); o++) {
+        const obj_file_s& obj = objs[o];
+        for(unsigned r=0; r<obj.hdr->n_relocs; r++) {
+            const unsigned index = obj.relocs[r].index;
+            const string name = obj.strs + obj.syms[obj.relocs[r].sym].name;
+            const auto found = globals.find(name);
+            // error: unresolved extern label
+            if(found == globals.end()) {
+                cerr << "Error: " << object_line_ref(obj, index) << ": "
+                     << "extern label '" << name << "' isn't global in any "
+                     << "linked file"
+                     << endl;
+                return false;
+            }
+            // error: out of bounds branch offset
+            const long long offset = found->second.second
+                - (bases[o] + index + 1LL);
+            if(offset < IMM_MIN || offset > IMM_MAX) {
+                cerr << "Error: " << object_line_ref(obj, index) << ": "
+                     << "branch offset to extern label '" << name << "' ("
+                     << offset << ") out of range [" << IMM_MIN << ", "
+                     << IMM_MAX << "] after linking"
+                     << endl;
+                return false;
+            }
+            mword_t& word = image[bases[o] + index];
+            word = (word & ~WIDTH_TO_BITS(IMM))
+                | (static_cast<mword_t>(offset) & WIDTH_TO_BITS(IMM));
+        }
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- *
+ * print_program_listing
+ * - Prints more verbose program listing to standard error.
+ * ------------------------------------------------------------------------- */
+void print_program_listing(const prog_s& prog) {
+    cerr << "=== LABEL LIST ===" << endl;
+    string::size_type longest_label = 0; //5;
+    for(auto it=prog.labels.begin(); it!=prog.labels.end(); ++it) {
+        if(it->name.size() > longest_label)
+            longest_label = it->name.size();
+    }
+    for(auto it=prog.data_labels.begin(); it!=prog.data_labels.end(); ++it) {
+        if(it->name.size() > longest_label)
+            longest_label = it->name.size();
+    }
+    longest_label += 1;
+    // cerr << setw(longest_label) << "LABEL"
+    //      << " : ADDR" << endl
+    //      << setfill('-') << setw(longest_label+1) << ""
+    //      << "+"
+    //      << setw(max(0UL,18-(longest_label+2))) << ""
+    //      << setfill(' ') << endl;
+    for(auto it=prog.labels.begin(); it!=prog.labels.end(); ++it) {
+        cerr << setw(longest_label) << it->name 
+             << ": 0x" << to_hex_string(it->address, IMM)
+             << endl;
+    }
+    if(!prog.data_labels.empty()) {
+        cerr << endl << "=== DATA LABEL LIST ===" << endl;
+        for(auto it=prog.data_labels.begin(); it!=prog.data_labels.end();
+                ++it) {
+            cerr << setw(longest_label) << it->name
+                 << ": 0x" << to_hex_string(it->address)
+                 << endl;
+        }
+    }
+    if(!prog.skipped.empty()) {
+        cerr << endl << "=== SKIPPED LINES ===" << endl;
+        for(auto it=prog.skipped.begin(); it!=prog.skipped.end(); ++it) {
+            if(it->first == it->last)
+                cerr << " line " << it->first;
+            else
+                cerr << " lines " << it->first << "-" << it->last;
+            cerr << ": " << it->cond << " (line " << it->cond_line << ")"
+                 << endl;
+        }
+    }
+    cerr << endl
+         << "====== MACHINE PROGRAM ======" << endl
+         << "  ADDR: MCODE  | ASSEMBLY    " << endl
+         << "---------------+-------------" << endl;
+    for(unsigned i=0; i<prog.insts.size(); i++)
+        cerr << listing_row(prog, i) << endl;
+    if(prog.data.empty())
+        return;
+    cerr << endl
+         << "======= DATA MEMORY =======" << endl
+         << "   ADDR: WORDS | DIRECTIVE" << endl
+         << "---------------+-----------" << endl;
+    for(auto it=prog.data.begin(); it!=prog.data.end(); ++it) {
+        cerr << " 0x" << to_hex_string(it->address) << ": "
+             << setw(5) << it->length << " | " << it->src
+             << " ; (line " << it->line_num << ")"
+             << endl;
+    }
+}
+
+// range of cycles as `best..worst`, or `-` when no path ends
+string cfg_cycles_str(unsigned long long best, unsigned long long worst) {
+    if(best == CYCLES_UNKNOWN)
+        return "-";
+    return best == worst ? to_string(best)
+        : to_string(best) + ".." + to_string(worst);
+}
+
+// best/worst cycles from each block of `region` until the path ends, which
+//   is a loop-closing edge into `header` or, with no header, an exit of the
+//   program, where other loops are left through their exits after one pass
+void cfg_path_cycles(const cfg_s& cfg, const vector<bool>& region, int header,
+        vector<unsigned long long>& best, vector<unsigned long long>& worst) {
+    const unsigned nb = cfg.blocks.size();
+    map<unsigned, unsigned> loop_of_header;
+    for(unsigned l=0; l<cfg.loops.size(); l++)
+        loop_of_header[cfg.loops[l].header] = l;
+
+    // moves out of each block, a target of -1 ends the path
+    vector<vector<pair<int,unsigned long long>>> moves(nb);
+    vector<vector<unsigned>> move_preds(nb);
+    vector<unsigned> pending(nb, 0);
+    auto add_move = [&](unsigned b, int to, unsigned long long cycles) {
+        moves[b].emplace_back(to, cycles);
+        if(to >= 0) {
+            move_preds[to].push_back(b);
+            pending[b]++;
+        }
+    };
+    for(unsigned b=0; b<nb; b++) {
+        if(!region[b])
+            continue;
+        const cfg_block_s& block = cfg.blocks[b];
+        if(header < 0 && block.exit != EXIT_NONE)
+            add_move(b, -1, block.exit_cycles);
+        for(auto e=block.succs.begin(); e!=block.succs.end(); ++e) {
+            if(!e->back) {
+                if(region[e->to])
+                    add_move(b, e->to, e->cycles);
+            }
+            else if(static_cast<int>(e->to) == header)
+                add_move(b, -1, e->cycles);
+            else {
+                // run the other loop once, continuing at its exits
+                const cfg_loop_s& loop = cfg.loops[loop_of_header[e->to]];
+                for(auto x=loop.blocks.begin(); x!=loop.blocks.end(); ++x) {
+                    const cfg_block_s& from = cfg.blocks[*x];
+                    if(header < 0 && from.exit != EXIT_NONE)
+                        add_move(b, -1, e->cycles + from.exit_cycles);
+                    for(auto f=from.succs.begin(); f!=from.succs.end(); ++f) {
+                        if(binary_search(loop.blocks.begin(),
+                                loop.blocks.end(), f->to))
+                            continue;
+                        if(f->back && static_cast<int>(f->to) == header)
+                            add_move(b, -1, e->cycles + f->cycles);
+                        else if(!f->back && region[f->to])
+                            add_move(b, f->to, e->cycles + f->cycles);
+                    }
+                }
+            }
+        }
+    }
+
+    // settle blocks once all their targets are settled, blocks caught in
+    //   a cycle of moves stay unknown
+    best.assign(nb, CYCLES_UNKNOWN);
+    worst.assign(nb, CYCLES_UNKNOWN);
+    vector<unsigned> ready;
+    for(unsigned b=0; b<nb; b++) {
+        if(region[b] && pending[b] == 0)
+            ready.push_back(b);
+    }
+    while(!ready.empty()) {
+        const unsigned b = ready.back();
+        ready.pop_back();
+        for(auto m=moves[b].begin(); m!=moves[b].end(); ++m) {
+            const unsigned long long to_best = m->first < 0 ? 0 : best[m->first];
+            const unsigned long long to_worst = m->first < 0 ? 0
+                : worst[m->first];
+            if(to_best == CYCLES_UNKNOWN)
+                continue;
+            best[b] = min(best[b], m->second + to_best);
+            worst[b] = worst[b] == CYCLES_UNKNOWN ? m->second + to_worst
+                : max(worst[b], m->second + to_worst);
+        }
+        if(best[b] != CYCLES_UNKNOWN) {
+            best[b] += cfg.blocks[b].cycles_min;
+            worst[b] += cfg.blocks[b].cycles_max;
+        }
+        for(auto p=move_preds[b].begin(); p!=move_preds[b].end(); ++p) {
+            if(--pending[*p] == 0)
+                ready.push_back(*p);
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- *
+ * build_cfg
+ * - Builds the control-flow graph of the encoded program in `prog.mcode`,
+ *     split into basic blocks at labels, branch targets, and after
+ *     branches, `HALT`, and writes to the PC.
+ * - Edges follow `B`/`BEQ`/`BNE` offsets and fall-throughs, while `HALT`,
+ *     writes to the PC (indirect jumps), branches out of the program and
+ *     falling past its last instruction are exits.
+ * - Blocks not reachable from address 0 (or a `.global` label) are
+ *     marked, and loops are the natural loops of the edges that close a
+ *     cycle in a depth-first walk from address 0 (edges into the same
+ *     header share a loop).
+ * - Cycles come from the per-opcode costs of `model`, taken branches and
+ *     writes to the PC add its branch penalty, and loads add its load
+ *     latency to the worst case. Each loop gets its best and worst cycles
+ *     per iteration, and each block its best and worst cycles until the
+ *     program exits, with every loop on the way run once.
+ * ------------------------------------------------------------------------- */
+void build_cfg(const prog_s& prog, const pipe_model_s& model, cfg_s& cfg) {
+    const unsigned n = prog.mcode.size();
+    cfg = cfg_s();
+
+    // decode opcodes, branch targets and PC writes
+    // ---------------------------------------------------------------------
+    vector<OPCODE> opcs(n);
+    vector<long long> targets(n, -1);
+    vector<bool> writes_pc(n, false);
+    vector<bool> is_start(n+1, false);
+    is_start[0] = true;
+    is_start[n] = true;
+    for(auto it=prog.labels.begin(); it!=prog.labels.end(); ++it) {
+        if(it->address < n)
+            is_start[it->address] = true;
+    }
+    for(unsigned i=0; i<n; i++) {
+        const mword_t word = prog.mcode[i];
+        opcs[i] = decode_opcode(word);
+        const I_FMT inst_fmt = OPC_TO_FMT.at(opcs[i]);
+        if(inst_fmt == B_TYPE) {
+            // offsets are relative to the PC read as PC+1
+            const mword_t imm = word & WIDTH_TO_BITS(IMM);
+            targets[i] = i + 1LL + (imm > IMM_MAX ? imm - (1LL<<IMM) : imm);
+            if(targets[i] >= 0 && targets[i] < n)
+                is_start[targets[i]] = true;
+        }
+        // the destination register is always the first field
+        const bool has_rd = inst_fmt == R1_TYPE || inst_fmt == R2_TYPE
+            || inst_fmt == R3_TYPE || inst_fmt == I_TYPE
+            || inst_fmt == FL_TYPE || opcs[i] == LDR || opcs[i] == LDRO;
+        if(has_rd) {
+            const pair<uint8_t,OPR_WIDTH>& rd = FMT_CONFIG[inst_fmt].at(0);
+            writes_pc[i] = ((word >> rd.first) & WIDTH_TO_BITS(rd.second))
+                == PC_REG;
+        }
+        if(inst_fmt == B_TYPE || opcs[i] == HALT || writes_pc[i])
+            is_start[i+1] = true;
+    }
+    // branches to extern labels leave for another object
+    vector<bool> is_extern(n, false);
+    for(auto it=prog.relocs.begin(); it!=prog.relocs.end(); ++it)
+        is_extern[it->first] = true;
+
+    // split into blocks and connect them
+    // ---------------------------------------------------------------------
+    cfg.block_of.assign(n, 0);
+    for(unsigned i=0; i<n; i++) {
+        if(is_start[i]) {
+            cfg_block_s block = cfg_block_s();
+            block.first = i;
+            block.loop = -1;
+            cfg.blocks.push_back(block);
+        }
+        cfg_block_s& block = cfg.blocks.back();
+        block.last = i;
+        block.cycles_min += cycle_cost(opcs[i], model);
+        block.cycles_max += cycle_cost(opcs[i], model)
+            + (opcs[i] == LDR || opcs[i] == LDRO ? model.load_latency : 0);
+        cfg.block_of[i] = cfg.blocks.size() - 1;
+    }
+    const unsigned nb = cfg.blocks.size();
+    vector<vector<unsigned>> preds(nb);
+    for(unsigned b=0; b<nb; b++) {
+        cfg_block_s& block = cfg.blocks[b];
+        const OPCODE opc = opcs[block.last];
+        if(OPC_TO_FMT.at(opc) == B_TYPE) {
+            const long long t = targets[block.last];
+            if(t >= 0 && t < n && !is_extern[block.last])
+                block.succs.push_back({ cfg.block_of[t], model.branch_penalty,
+                    true, false });
+            else {
+                block.exit = is_extern[block.last] ? EXIT_EXTERN
+                    : EXIT_OUTSIDE;
+                block.exit_cycles = model.branch_penalty;
+            }
+        }
+        if(opc == HALT)
+            block.exit = EXIT_HALT;
+        else if(writes_pc[block.last]) {
+            block.exit = EXIT_INDIRECT;
+            block.exit_cycles = model.branch_penalty;
+        }
+        else if(opc != B && block.last+1 < n)
+            block.succs.push_back({ b+1, 0, false, false });
+        else if(opc != B)
+            block.exit = EXIT_END;
+        for(auto e=block.succs.begin(); e!=block.succs.end(); ++e)
+            preds[e->to].push_back(b);
+    }
+
+    // walk from address 0 (and global labels, which other objects may
+    //   branch to) to find reachable blocks and loop-closing edges, then
+    //   from the leftover blocks so their loops are found too
+    // ---------------------------------------------------------------------
+    vector<uint8_t> state(nb, 0);
+    vector<unsigned> roots;
+    for(auto it=prog.labels.begin(); nb>0 && it!=prog.labels.end(); ++it) {
+        if(it->address < n && prog.global_labels.count(it->name))
+            roots.push_back(cfg.block_of[it->address]);
+    }
+    const unsigned n_entries = roots.size() + 1;
+    for(unsigned b=0; b<nb; b++)
+        roots.insert(b == 0 ? roots.begin() : roots.end(), b);
+    for(unsigned r=0; r<roots.size(); r++) {
+        const unsigned root = roots[r];
+        if(state[root] != 0)
+            continue;
+        vector<pair<unsigned,unsigned>> stack = { {root, 0} };
+        state[root] = 1;
+        while(!stack.empty()) {
+            const unsigned b = stack.back().first;
+            const unsigned e = stack.back().second++;
+            cfg.blocks[b].reachable = r < n_entries;
+            if(e == cfg.blocks[b].succs.size()) {
+                state[b] = 2;
+                stack.pop_back();
+                continue;
+            }
+            cfg_edge_s& edge = cfg.blocks[b].succs[e];
+            if(state[edge.to] == 1)
+                edge.back = true;
+            else if(state[edge.to] == 0) {
+                state[edge.to] = 1;
+                stack.push_back({ edge.to, 0 });
+            }
+        }
+    }
+
+    // gather the natural loop of each header, innermost loops first
+    // ---------------------------------------------------------------------
+    map<unsigned, set<unsigned>> bodies;
+    for(unsigned b=0; b<nb; b++) {
+        for(auto e=cfg.blocks[b].succs.begin(); e!=cfg.blocks[b].succs.end();
+                ++e) {
+            if(!e->back)
+                continue;
+            set<unsigned>& body = bodies[e->to];
+            body.insert(e->to);
+            vector<unsigned> work = { b };
+            while(!work.empty()) {
+                const unsigned w = work.back();
+                work.pop_back();
+                if(!body.insert(w).second)
+                    continue;
+                work.insert(work.end(), preds[w].begin(), preds[w].end());
+            }
+        }
+    }
+    for(auto it=bodies.begin(); it!=bodies.end(); ++it) {
+        cfg_loop_s loop = cfg_loop_s();
+        loop.header = it->first;
+        loop.blocks.assign(it->second.begin(), it->second.end());
+        loop.parent = -1;
+        cfg.loops.push_back(loop);
+    }
+    stable_sort(cfg.loops.begin(), cfg.loops.end(),
+        [](const cfg_loop_s& a, const cfg_loop_s& b) {
+            return a.blocks.size() < b.blocks.size();
+        });
+    const unsigned nl = cfg.loops.size();
+    for(unsigned l=0; l<nl; l++) {
+        cfg_loop_s& loop = cfg.loops[l];
+        for(auto b=loop.blocks.begin(); b!=loop.blocks.end(); ++b) {
+            if(cfg.blocks[*b].loop < 0)
+                cfg.blocks[*b].loop = l;
+        }
+        for(unsigned p=l+1; p<nl && loop.parent<0; p++) {
+            if(binary_search(cfg.loops[p].blocks.begin(),
+                    cfg.loops[p].blocks.end(), loop.header))
+                loop.parent = p;
+        }
+    }
+    for(unsigned l=nl; l-->0; ) {
+        cfg_loop_s& loop = cfg.loops[l];
+        loop.depth = loop.parent < 0 ? 1 : cfg.loops[loop.parent].depth + 1;
+    }
+
+    // estimate cycles per loop iteration and until the program exits
+    // ---------------------------------------------------------------------
+    vector<unsigned long long> best, worst;
+    for(unsigned l=0; l<nl; l++) {
+        cfg_loop_s& loop = cfg.loops[l];
+        vector<bool> region(nb, false);
+        for(auto b=loop.blocks.begin(); b!=loop.blocks.end(); ++b)
+            region[*b] = true;
+        cfg_path_cycles(cfg, region, loop.header, best, worst);
+        loop.best = best[loop.header];
+        loop.worst = worst[loop.header];
+    }
+    cfg_path_cycles(cfg, vector<bool>(nb, true), -1, best, worst);
+    for(unsigned b=0; b<nb; b++) {
+        cfg.blocks[b].best = best[b];
+        cfg.blocks[b].worst = worst[b];
+    }
+}
+
+/* ------------------------------------------------------------------------- *
+ * print_cfg_report
+ * - Prints the loops, unreachable code, exits past the end of the program,
+ *     and the cycle estimates of a control-flow graph to standard error.
+ * ------------------------------------------------------------------------- */
+void print_cfg_report(const prog_s& prog, const cfg_s& cfg) {
+    map<unsigned, string> label_names;
+    for(auto it=prog.labels.begin(); it!=prog.labels.end(); ++it) {
+        if(it->address < cfg.block_of.size()
+                && label_names.count(it->address) == 0)
+            label_names[it->address] = it->name;
+    }
+
+    // warn about runs of unreachable code and paths out of the program
+    for(auto b=cfg.blocks.begin(); b!=cfg.blocks.end(); ++b) {
+        if(!b->reachable && (b == cfg.blocks.begin() || (b-1)->reachable)) {
+            auto e = b;
+            while(e+1 != cfg.blocks.end() && !(e+1)->reachable)
+                e++;
+            cerr << "Warning: line[" << line_ref(prog, b->first) << "]: "
+                 << "unreachable from address 0x000 (" << e->last-b->first+1
+                 << " instruction" << (e->last == b->first ? "" : "s")
+                 << " at 0x" << to_hex_string(b->first, IMM) << "):"
+                 << endl;
+            inst_error_marker(prog.insts_raw[b->first], MAX_OPR);
+        }
+        // linked files fall through into the next one
+        if((b->exit == EXIT_END && !prog.linking)
+                || b->exit == EXIT_OUTSIDE) {
+            cerr << "Warning: line[" << line_ref(prog, b->last) << "]: "
+                 << (b->exit == EXIT_END ? "falls through" : "branches")
+                 << " past the end of the program into unprogrammed "
+                 << "instruction memory:"
+                 << endl;
+            inst_error_marker(prog.insts_raw[b->last], MAX_OPR);
+        }
+    }
+
+    cerr << "=== CONTROL FLOW REPORT (" << cfg.blocks.size() << " blocks, "
+         << cfg.loops.size() << " loops) ===" << endl
+         << "  HEAD: BLOCKS | DEPTH | CYCLES/ITERATION | LABEL" << endl
+         << "--------------+-------+------------------+------" << endl;
+    for(auto l=cfg.loops.begin(); l!=cfg.loops.end(); ++l) {
+        const unsigned first = cfg.blocks[l->header].first;
+        cerr << " 0x" << to_hex_string(first, IMM) << ": "
+             << setw(6) << right << l->blocks.size() << " | "
+             << setw(5) << l->depth << " | "
+             << setw(16) << cfg_cycles_str(l->best, l->worst) << " | "
+             << (label_names.count(first) ? label_names[first] : "")
+             << endl;
+    }
+    cerr << endl
+         << "  ADDR: CYCLES TO EXIT | LABEL" << endl
+         << "--------------------+------" << endl;
+    for(auto it=label_names.begin(); it!=label_names.end(); ++it) {
+        const cfg_block_s& b = cfg.blocks[cfg.block_of[it->first]];
+        cerr << " 0x" << to_hex_string(it->first, IMM) << ": "
+             << setw(14) << right << cfg_cycles_str(b.best, b.worst) << " | "
+             << it->second
+             << endl;
+    }
+    if(!cfg.blocks.empty()) {
+        cerr << "--------------------+------" << endl
+             << "        " << setw(14) << right
+             << cfg_cycles_str(cfg.blocks[0].best, cfg.blocks[0].worst)
+             << " | (PROGRAM, every loop once)"
+             << endl;
+    }
+    cerr << endl;
+}
+
+/* ------------------------------------------------------------------------- *
+ * write_cfg_dot
+ * - Writes a control-flow graph as a Graphviz digraph, with each block's
+ *     instructions and cycles as a node and each loop as a nested cluster.
+ * - Taken branches are solid, fall-throughs dashed, and loop-closing
+ *     edges bold, while unreachable blocks are grayed out.
+ * ------------------------------------------------------------------------- */
+void write_cfg_dot(ofstream& out, const prog_s& prog, const cfg_s& cfg) {
+    map<unsigned, vector<string>> label_names;
+    for(auto it=prog.labels.begin(); it!=prog.labels.end(); ++it)
+        label_names[it->address].push_back(it->name);
+
+    out << "digraph cfg {" << endl
+        << "    node [shape=box, fontname=\"monospace\"];" << endl;
+
+    // blocks are written inside the cluster of their innermost loop
+    vector<vector<unsigned>> loop_blocks(cfg.loops.size()+1);
+    vector<vector<unsigned>> loop_children(cfg.loops.size()+1);
+    for(unsigned b=0; b<cfg.blocks.size(); b++)
+        loop_blocks[cfg.blocks[b].loop+1].push_back(b);
+    for(unsigned l=0; l<cfg.loops.size(); l++)
+        loop_children[cfg.loops[l].parent+1].push_back(l);
+    function<void(int, const string&)> write_cluster =
+            [&](int l, const string& indent) {
+        if(l >= 0) {
+            out << indent << "subgraph cluster_loop" << l << " {" << endl
+                << indent << "    label=\"loop 0x"
+                << to_hex_string(cfg.blocks[cfg.loops[l].header].first, IMM)
+                << ", "
+                << cfg_cycles_str(cfg.loops[l].best, cfg.loops[l].worst)
+                << " cycles/iteration\";" << endl;
+        }
+        const string inner = l >= 0 ? indent + "    " : indent;
+        for(auto b=loop_blocks[l+1].begin(); b!=loop_blocks[l+1].end(); ++b) {
+            const cfg_block_s& block = cfg.blocks[*b];
+            out << inner << "b" << *b << " [label=\"";
+            if(label_names.count(block.first)) {
+                for(auto it=label_names[block.first].begin();
+                        it!=label_names[block.first].end(); ++it)
+                    out << *it << ":\\l";
+            }
+            for(unsigned i=block.first; i<=block.last; i++) {
+                out << "0x" << to_hex_string(i, IMM) << ": "
+                    << listing_str(prog, i) << "\\l";
+            }
+            out << "cycles " << cfg_cycles_str(block.cycles_min,
+                    block.cycles_max) << ", to exit "
+                << cfg_cycles_str(block.best, block.worst) << "\\l\"";
+            if(!block.reachable)
+                out << ", style=dashed, color=gray, fontcolor=gray";
+            out << "];" << endl;
+        }
+        for(auto c=loop_children[l+1].begin(); c!=loop_children[l+1].end();
+                ++c)
+            write_cluster(*c, inner);
+        if(l >= 0)
+            out << indent << "}" << endl;
+    };
+    write_cluster(-1, "    ");
+
+    // edges, exits lead to a node of their own
+    for(unsigned b=0; b<cfg.blocks.size(); b++) {
+        const cfg_block_s& block = cfg.blocks[b];
+        for(auto e=block.succs.begin(); e!=block.succs.end(); ++e) {
+            out << "    b" << b << " -> b" << e->to << " [style="
+                << (e->back ? "bold" : e->taken ? "solid" : "dashed")
+                << (e->taken ? ", label=\"taken\"" : "") << "];" << endl;
+        }
+        if(block.exit != EXIT_NONE) {
+            out << "    x" << b << " [shape=plaintext, label=\""
+                << CFG_EXIT_NAMES[block.exit] << "\"];" << endl
+                << "    b" << b << " -> x" << b << ";" << endl;
+        }
+    }
+    out << "}" << endl;
+}
+
+/* ------------------------------------------------------------------------- *
+ * write_cfg_json
+ * - Writes a control-flow graph as JSON, with `blocks`, `loops` and
+ *     `labels` arrays. Cycle estimates are `[best, worst]` pairs, or
+ *     `null` when no path ends.
+ * ------------------------------------------------------------------------- */
+void write_cfg_json(ofstream& out, const prog_s& prog, const cfg_s& cfg) {
+    auto cycles_json = [](unsigned long long lo, unsigned long long hi) {
+        if(lo == CYCLES_UNKNOWN)
+            return string("null");
+        return "[" + to_string(lo) + ", " + to_string(hi) + "]";
+    };
+
+    out << "{" << endl << "  \"blocks\": [";
+    for(unsigned b=0; b<cfg.blocks.size(); b++) {
+        const cfg_block_s& block = cfg.blocks[b];
+        out << (b ? "," : "") << endl
+            << "    {\"id\": " << b << ", \"first\": " << block.first
+            << ", \"last\": " << block.last
+            << ", \"reachable\": " << (block.reachable ? "true" : "false")
+            << ", \"loop\": ";
+        if(block.loop < 0)
+            out << "null";
+        else
+            out << cfg.loops[block.loop].header;
+        out << ", \"exit\": ";
+        if(block.exit == EXIT_NONE)
+            out << "null";
+        else
+            out << "\"" << CFG_EXIT_NAMES[block.exit] << "\"";
+        out << ", \"cycles\": "
+            << cycles_json(block.cycles_min, block.cycles_max)
+            << ", \"cycles_to_exit\": " << cycles_json(block.best, block.worst)
+            << ", \"succs\": [";
+        for(auto e=block.succs.begin(); e!=block.succs.end(); ++e) {
+            out << (e != block.succs.begin() ? ", " : "")
+                << "{\"to\": " << e->to << ", \"cycles\": " << e->cycles
+                << ", \"taken\": " << (e->taken ? "true" : "false")
+                << ", \"back\": " << (e->back ? "true" : "false") << "}";
+        }
+        out << "]}";
+    }
+    out << endl << "  ]," << endl << "  \"loops\": [";
+    for(unsigned l=0; l<cfg.loops.size(); l++) {
+        const cfg_loop_s& loop = cfg.loops[l];
+        out << (l ? "," : "") << endl
+            << "    {\"header\": " << loop.header << ", \"parent\": ";
+        if(loop.parent < 0)
+            out << "null";
+        else
+            out << cfg.loops[loop.parent].header;
+        out << ", \"depth\": " << loop.depth << ", \"blocks\": [";
+        for(auto b=loop.blocks.begin(); b!=loop.blocks.end(); ++b)
+            out << (b != loop.blocks.begin() ? ", " : "") << *b;
+        out << "], \"cycles_per_iteration\": "
+            << cycles_json(loop.best, loop.worst) << "}";
+    }
+    out << endl << "  ]," << endl << "  \"labels\": [";
+    bool first_label = true;
+    for(auto it=prog.labels.begin(); it!=prog.labels.end(); ++it) {
+        const label_s& label = *it;
+        if(label.address >= cfg.block_of.size())
+            continue;
+        const cfg_block_s& block = cfg.blocks[cfg.block_of[label.address]];
+        out << (first_label ? "" : ",") << endl
+            << "    {\"name\": \"" << label.name << "\", \"address\": "
+            << label.address << ", \"block\": "
+            << cfg.block_of[label.address] << ", \"cycles_to_exit\": "
+            << cycles_json(block.best, block.worst) << "}";
+        first_label = false;
+    }
+    out << endl << "  ]" << endl << "}" << endl;
+}
+
+/* ------------------------------------------------------------------------- *
+ * parse_ldi
+ * - Expands the `LDI Rd, Imm[, Rs]` psuedo-instruction extracted into `m`
+ *     by `extract_inst_re`, loading any 16-bit value into `Rd` and
+ *     optionally clobbering the scratch register `Rs`.
+ * - Pushes the sequence found by `materialize_constant` onto `prog`, with
+ *     each instruction noted in the listing along with the sequence cost.
+ * - Returns false if the operands are malformed or no sequence exists.
+ * ------------------------------------------------------------------------- */
+bool parse_ldi(const string& line_buf, const smatch& m, unsigned file_line,
+        bool strict_parsing, prog_s& prog) {
+    const string mne = m[2].str();
+    string oprs = m[3].str();
+    trim_tail(oprs);
+
+    // match operand format
+    // ---------------------------------------------------------------------
+    smatch oprs_m;
+    if(!regex_match(oprs, oprs_m, strict_parsing ? ldi_re_strict : ldi_re)) {
+        cerr << "Error: line[" << file_line << "]: "
+             << "could not match operand format for mnemonic '"
+             << mne << "':"
+             << endl;
+        line_error_marker(line_buf, m.position(3), oprs.length());
+        cerr << "--- Expected one of the following formats:" << endl
+             << "-----> " << mne << " Rd, Imm" << endl
+             << "-----> " << mne << " Rd, Imm, Rs" << endl;
+        return false;
+    }
+
+    // encode destination and scratch registers (neither can be the PC)
+    // ---------------------------------------------------------------------
+    const bool use_scratch = oprs_m[3].matched;
+    mword_t regs[2] = { 0, 0 };
+    for(unsigned o=0; o<(use_scratch ? 2u : 1u); o++) {
+        const unsigned g = o == 0 ? 1 : 3;
+        if(!encode_register(oprs_m[g].str(), regs[o]) || regs[o] == PC_REG) {
+            cerr << "Error: line[" << file_line << "]: "
+                 << "could not encode " << ordinal_str(g)
+                 << " operand '" << oprs_m[g].str()
+                 << "', expected register between 'r0' and 'r"
+                 << PC_REG-1 << "':"
+                 << endl;
+            line_error_marker(line_buf,
+                m.position(3)+oprs_m.position(g), oprs_m.length(g));
+            return false;
+        }
+    }
+    // error: scratch register is the destination register
+    if(use_scratch && regs[0] == regs[1]) {
+        cerr << "Error: line[" << file_line << "]: "
+             << "scratch register '" << oprs_m[3].str()
+             << "' must differ from destination register:"
+             << endl;
+        line_error_marker(line_buf,
+            m.position(3)+oprs_m.position(3), oprs_m.length(3));
+        return false;
+    }
+
+    // parse 16-bit immediate
+    // ---------------------------------------------------------------------
+    long long parsed = 0;
+    const string imm_key = str_to_upper(substitute_symbols(oprs_m[2].str(),
+        prog.equs));
+    if(prog.data_lookup.count(imm_key) > 0)
+        parsed = prog.data_lookup.at(imm_key);
+    else if(!parse_wide_immediate(imm_key, parsed)) {
+        cerr << "Error: line[" << file_line << "]: "
+             << "could not encode 2nd operand '" << oprs_m[2].str()
+             << "', expected 16-bit immediate value in range ["
+             << INT16_MIN << ", " << UINT16_MAX << "] or data label:"
+             << endl;
+        line_error_marker(line_buf,
+            m.position(3)+oprs_m.position(2), oprs_m.length(2));
+        return false;
+    }
+    const mword_t target = static_cast<mword_t>(parsed);
+
+    // search for the shortest sequence
+    // ---------------------------------------------------------------------
+    ldi_seq_t seq;
+    if(!materialize_constant(target, use_scratch, seq)) {
+        cerr << "Error: line[" << file_line << "]: "
+             << "could not load '" << oprs_m[2].str() << "' using only '"
+             << oprs_m[1].str() << "' in at most " << LDI_MAX_COST-1
+             << " instructions, add a scratch register operand:"
+             << endl;
+        line_error_marker(line_buf, m.position(3), oprs.length());
+        return false;
+    }
+
+    // push expanded instructions onto instruction list
+    // ---------------------------------------------------------------------
+    const string note = LDI_MNEMONIC + " " + reg_token(regs[0]) + ", 0x"
+        + to_hex_string(target)
+        + (use_scratch ? ", " + reg_token(regs[1]) : "");
+    for(unsigned k=0; k<seq.size(); k++) {
+        const inst_tokens_t toks = ldi_step_tokens(seq[k], regs);
+        prog.insts.emplace_back(seq[k].opcode, toks);
+        prog.insts_raw.push_back(toks);
+        prog.debug_line_nums.push_back(file_line);
+        prog.debug_macro_lines.push_back(0);
+        prog.debug_notes.push_back(note + " (" + to_string(k+1) + " of "
+            + to_string(seq.size()) + ")");
+    }
+
+    // error: instruction overflow
+    if(prog.insts.size() > MAX_INST) {
+        cerr << "Error: line[" << file_line << "]: "
+             << "instruction count exceeds limit (" 
+             << "max = " << MAX_INST << ")" 
+             << endl;
+        return false;
+    }
+
+    // signal success
+    return true;
+}
+
+/* ------------------------------------------------------------------------- *
+ * build_macro
+ * - Parses the body lines of a `.macro` or `.rept` block once into
+ *     instruction templates: mnemonics are looked up, `CLC` is replaced,
+ *     operands are split into tokens and checked against the formats of
+ *     the mnemonic, and each `\param` operand becomes a hole.
+ * - `\param` and `\@` (the expansion count) can also be part of a longer
+ *     label or operand name, such as `loop\@`.
+ * - The opcode is fixed unless a hole decides between formats (`MOV`).
+ * - Uses of the macros in `macros`, defined before this body, keep a copy
+ *     of the used macro to expand in place with the filled arguments.
+ * - Returns false if a body line is malformed, references an unknown
+ *     parameter, or uses a macro with the wrong number of arguments.
+ * ------------------------------------------------------------------------- */
+bool build_macro(macro_s& macro, const map<string, macro_s>& macros,
+        bool strict_parsing) {
+    smatch m;
+    vector<string> labels;
+    const string what = macro.name.empty() ? string("'.rept' block")
+        : "macro '" + macro.name + "'";
+    for(auto it=macro.lines.begin(); it!=macro.lines.end(); ++it) {
+        const unsigned file_line = it->first;
+        const string& line_buf = it->second;
+
+        // error: unparseable body line, or a directive
+        if(!regex_match(line_buf, m, macro_line_re)
+                || (m[2].length() == 0 && m[3].length() > 0)) {
+            cerr << "Error: line[" << file_line << "]: "
+                 << "could not locate instruction mnemonic in " << what
+                 << ":"
+                 << endl;
+            line_error_marker(line_buf, 0, line_buf.size());
+            return false;
+        }
+
+        // error: references to unknown parameters
+        for(sregex_iterator ref(line_buf.begin(), line_buf.end(),
+                    macro_ref_re), end; ref!=end; ++ref) {
+            const string name = str_to_upper((*ref)[1].str());
+            if(name != "@" && find(macro.params.begin(), macro.params.end(),
+                    name) == macro.params.end()) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "unknown parameter '" << ref->str() << "' in "
+                     << what << ":"
+                     << endl;
+                line_error_marker(line_buf, ref->position(), ref->length());
+                return false;
+            }
+        }
+
+        // labels are placed before the next instruction
+        const string label_str = m[1].str();
+        for(sregex_iterator lit(label_str.begin(), label_str.end(),
+                    macro_label_re), end; lit!=end; ++lit)
+            labels.push_back((*lit)[1].str());
+        if(m[2].length() == 0)
+            continue;
+
+        // look up mnemonic, replacing psuedo-instructions
+        // -----------------------------------------------------------------
+        string mne = m[2].str();
+        string mne_key = str_to_upper(mne);
+        string oprs = m[3].str();
+        trim_tail(oprs);
+        if(PSUEDO_ISA.count(mne_key) > 0 && oprs.empty()) {
+            const string& psuedo = PSUEDO_ISA.at(mne_key);
+            mne = psuedo.substr(0, psuedo.find(' '));
+            mne_key = mne;
+            oprs = psuedo.substr(psuedo.find(' ')+1);
+        }
+        const bool is_ldi = mne_key == LDI_MNEMONIC;
+        const bool is_use = macros.count(mne_key) > 0;
+        // error: invalid mnemonic
+        if(!is_ldi && !is_use && ISA.count(mne_key) == 0) {
+            cerr << "Error: line[" << file_line << "]: "
+                 << "invalid mnemonic '" << mne << "' in " << what
+                 << ", expected an instruction or an earlier macro:"
+                 << endl;
+            line_error_marker(line_buf, m.position(2), m[2].length());
+            return false;
+        }
+
+        // check operand formats with every hole standing in for a register
+        //   (which any immediate format also accepts)
+        // -----------------------------------------------------------------
+        const string check = regex_replace(oprs, macro_ref_re, "R0");
+        macro_inst_s inst;
+        inst.line_num = file_line;
+        inst.labels = labels;
+        labels.clear();
+        bool found_matching_fmt = is_use || (is_ldi && regex_match(check,
+            strict_parsing ? ldi_re_strict : ldi_re));
+        if(!is_ldi && !is_use) {
+            const vector<OPCODE>& mne_opcodes = ISA.at(mne_key);
+            for(auto ot=mne_opcodes.begin(); ot!=mne_opcodes.end(); ++ot) {
+                const I_FMT fmt = OPC_TO_FMT.at(*ot);
+                if(regex_match(check,
+                        strict_parsing ? FMT_REGEX_STRICT[fmt] : FMT_REGEX[fmt]))
+                    inst.opcodes.push_back(*ot);
+            }
+            found_matching_fmt = !inst.opcodes.empty();
+        }
+        // error: no valid operand format for mnemonic
+        if(!found_matching_fmt) {
+            cerr << "Error: line[" << file_line << "]: "
+                 << "could not match operand format for mnemonic '"
+                 << mne << "' in " << what << ":"
+                 << endl;
+            line_error_marker(line_buf, m.position(3), m[3].length());
+            return false;
+        }
+
+        // split operands into tokens, marking the holes
+        // -----------------------------------------------------------------
+        inst.toks.push_back(mne_key);
+        inst.toks_raw.push_back(mne);
+        inst.holes.push_back(-1);
+        for(sregex_token_iterator tok(oprs.begin(), oprs.end(),
+                    macro_opr_split_re, -1), end; tok!=end; ++tok) {
+            const string raw = tok->str();
+            if(raw.empty())
+                continue;
+            const string key = str_to_upper(raw);
+            int hole = -1;
+            if(key.find('\\') != string::npos) {
+                const auto param = find(macro.params.begin(),
+                    macro.params.end(), key.substr(1));
+                hole = key[0] == '\\' && param != macro.params.end()
+                    ? param - macro.params.begin() : -2;
+            }
+            inst.toks.push_back(key);
+            inst.toks_raw.push_back(raw);
+            inst.holes.push_back(hole);
+        }
+        if(is_use) {
+            inst.macro = make_shared<const macro_s>(macros.at(mne_key));
+            // error: wrong argument count
+            if(inst.toks.size()-1 != inst.macro->params.size()) {
+                cerr << "Error: line[" << file_line << "]: "
+                     << "macro '" << mne << "' expects "
+                     << inst.macro->params.size() << " argument"
+                     << (inst.macro->params.size() == 1 ? "" : "s")
+                     << ", but found " << inst.toks.size()-1 << " in " << what
+                     << ":"
+                     << endl;
+                line_error_marker(line_buf, m.position(3), m[3].length());
+                return false;
+            }
+        }
+        // keep a single opcode when no hole decides between formats
+        if(find_if(inst.holes.begin(), inst.holes.end(),
+                [](int h) { return h != -1; }) == inst.holes.end()
+                && inst.opcodes.size() > 1)
+            inst.opcodes.resize(1);
+        macro.body.push_back(inst);
+    }
+    macro.end_labels = labels;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- *
+ * expand_macro
+ * - Copies the instruction templates of `macro` onto `prog`, filling the
+ *     holes with `args` and `\@` with the running expansion count in
+ *     `n_expanded`.
+ * - Expanded instructions keep the call site as their line, the macro
+ *     body line in `prog.debug_macro_lines`, and are noted in the listing.
+ * - `LDI` templates are expanded by `parse_ldi` once their operands are
+ *     known, since the sequence depends on the value, and macro uses by
+ *     expanding the used macro.
+ * - Returns false if a label is repeated, an `LDI` fails, or the program
+ *     outgrows instruction memory.
+ * ------------------------------------------------------------------------- */
+bool expand_macro(const macro_s& macro, const vector<string>& args,
+        const string& line_buf, unsigned file_line, unsigned& n_expanded,
+        prog_s& prog) {
+    const string at = to_string(++n_expanded);
+    const string note = macro.name.empty() ? string(".rept") : macro.name;
+
+    // patches `\@` and parameters into a longer token
+    auto patch = [&](const string& tok, bool upper) -> string {
+        string res;
+        string::size_type prev = 0;
+        for(sregex_iterator ref(tok.begin(), tok.end(), macro_ref_re), end;
+                ref!=end; ++ref) {
+            res += tok.substr(prev, ref->position() - prev);
+            const string name = str_to_upper((*ref)[1].str());
+            if(name == "@")
+                res += at;
+            else {
+                const string& arg = args[find(macro.params.begin(),
+                    macro.params.end(), name) - macro.params.begin()];
+                res += upper ? str_to_upper(arg) : arg;
+            }
+            prev = ref->position() + ref->length();
+        }
+        return res + tok.substr(prev);
+    };
+
+    for(auto it=macro.body.begin(); it!=macro.body.end(); ++it) {
+        // place labels
+        for(auto lt=it->labels.begin(); lt!=it->labels.end(); ++lt) {
+            if(!add_label(patch(*lt, false), line_buf, 0, line_buf.size(),
+                    file_line, prog.insts.size(), false, prog))
+                return false;
+        }
+
+        // stamp the template, filling its holes
+        // -----------------------------------------------------------------
+        inst_tokens_t toks = it->toks;
+        inst_tokens_t toks_raw = it->toks_raw;
+        for(unsigned t=1; t<toks.size(); t++) {
+            if(it->holes[t] >= 0) {
+                toks_raw[t] = args[it->holes[t]];
+                toks[t] = str_to_upper(toks_raw[t]);
+            }
+            else if(it->holes[t] == -2) {
+                toks[t] = patch(toks[t], true);
+                toks_raw[t] = patch(toks_raw[t], false);
+            }
+            if(!prog.equs.empty())
+                toks[t] = substitute_symbols(toks[t], prog.equs);
+        }
+        const unsigned first = prog.insts.size();
+        if(it->macro) {
+            // uses of earlier macros expand with the filled arguments
+            if(!expand_macro(*it->macro, vector<string>(toks_raw.begin()+1,
+                    toks_raw.end()), line_buf, file_line, n_expanded, prog))
+                return false;
+        }
+        else if(it->opcodes.empty()) {
+            // `LDI` picks its sequence by value
+            string ldi_buf = toks_raw[0];
+            for(unsigned t=1; t<toks_raw.size(); t++)
+                ldi_buf += (t == 1 ? " " : ", ") + toks_raw[t];
+            smatch m;
+            regex_match(ldi_buf, m, extract_inst_re);
+            if(!parse_ldi(ldi_buf, m, file_line, false, prog))
+                return false;
+        }
+        else {
+            // pick the first format the filled tokens fit
+            OPCODE opc = it->opcodes[0];
+            for(auto ot=it->opcodes.begin(); ot!=it->opcodes.end(); ++ot) {
+                const fmt_config_t& fmt_config = FMT_CONFIG[OPC_TO_FMT.at(*ot)];
+                bool fits = fmt_config.size() + 1 == toks.size();
+                for(unsigned o=0; fits && o<fmt_config.size(); o++) {
+                    mword_t reg = 0;
+                    if(fmt_config[o].second == REG)
+                        fits = encode_register(toks[1+o], reg);
+                    else if(fmt_config[o].second == NON)
+                        fits = toks[1+o] == "FLAGS";
+                }
+                if(fits) {
+                    opc = *ot;
+                    break;
+                }
+            }
+            prog.insts.emplace_back(opc, toks);
+            prog.insts_raw.push_back(toks_raw);
+            prog.debug_line_nums.push_back(file_line);
+            prog.debug_macro_lines.push_back(0);
+            prog.debug_notes.push_back("");
+        }
+        for(unsigned i=first; i<prog.insts.size(); i++) {
+            // the innermost body line is kept for errors
+            if(prog.debug_macro_lines[i] == 0)
+                prog.debug_macro_lines[i] = it->line_num;
+            add_note(prog.debug_notes[i], "from " + note + " line "
+                + to_string(it->line_num));
+        }
+
+        // error: instruction overflow
+        if(prog.insts.size() > MAX_INST) {
+            cerr << "Error: line[" << file_line << "]: "
+                 << "instruction count exceeds limit ("
+                 << "max = " << MAX_INST << ")"
+                 << endl;
+            return false;
+        }
+    }
+    for(auto lt=macro.end_labels.begin(); lt!=macro.end_labels.end(); ++lt) {
+        if(!add_label(patch(*lt, false), line_buf, 0, line_buf.size(),
+                file_line, prog.insts.size(), false, prog))
+            return false;
+    }
+    return true;
+}
+
+// applies a sequence step to a search state, false if an operand is unknown
+bool ldi_apply(const ldi_step_s& step, ldi_state_s& st) {
+    if(step.opcode != MOVIM) {
+        const bool unary = step.opcode == NOT;
+        if(!(st.known & (1<<step.src_n))
+                || (!unary && !(st.known & (1<<step.src_m))))
+            return false;
+        mword_t res = 0;
+        if(!alu_eval(step.opcode, st.val[step.src_n], st.val[step.src_m],
+                false, res))
+            return false;
+        st.val[step.dst] = res;
+    }
+    else
+        st.val[step.dst] = step.imm;
+    st.known |= 1<<step.dst;
+    return true;
+}
+
+// collects immediates likely to appear partway through building `target`
+vector<mword_t> ldi_candidates(mword_t target) {
+    set<mword_t> cands;
+    for(unsigned k=0; k<WORD_SIZE; k++) {
+        mword_t piece = (target>>k) & WIDTH_TO_BITS(IMM);
+        if(piece & (1<<(IMM-1)))
+            piece |= ~WIDTH_TO_BITS(IMM);
+        const mword_t pieces[] = {
+            static_cast<mword_t>(k),
+            piece,
+            static_cast<mword_t>(target >> k),
+            static_cast<mword_t>(target << k),
+            static_cast<mword_t>((target << k) | (target >> (WORD_SIZE-k))),
+            static_cast<mword_t>((target >> k) | (target << (WORD_SIZE-k))),
+        };
+        for(auto it=begin(pieces); it!=end(pieces); ++it) {
+            if(fits_imm(*it))
+                cands.insert(*it);
+        }
+    }
+    if(fits_imm(~target))
+        cands.insert(~target);
+    return vector<mword_t>(cands.begin(), cands.end());
+}
+
+// solves an ALU op backwards for an operand `y` so that `op(x, y)` (or
+//   `op(y, x)` when `!y_is_m`) can equal `target`, candidates are unchecked
+void ldi_invert(OPCODE op, mword_t target, mword_t x, bool y_is_m,
+        vector<mword_t>& ys) {
+    const unsigned s = x & 0xF;
+    switch(op) {
+        case AND:
+            ys.push_back(target);
+            ys.push_back(target | ~x);
+            break;
+        case OR:
+            ys.push_back(target);
+            ys.push_back(target & ~x);
+            break;
+        case EOR:
+            ys.push_back(target ^ x);
+            break;
+        case MUL: {
+            // solve odd part of x with its inverse modulo 2^16, then try
+            //   every value of the high bits lost to its factors of two
+            unsigned tz = 0;
+            while(tz < WORD_SIZE && !(x & (1u<<tz)))
+                tz++;
+            if(tz == WORD_SIZE || tz > 4 || (target & WIDTH_TO_BITS(tz)))
+                break;
+            mword_t odd = x >> tz;
+            mword_t inv = odd;
+            for(unsigned i=0; i<4; i++)
+                inv *= 2 - odd*inv;
+            const mword_t base = (target >> tz) * inv;
+            for(unsigned hi=0; hi<(1u<<tz); hi++) {
+                ys.push_back((base & (0xFFFFu >> tz))
+                    | (hi << (WORD_SIZE-tz)));
+            }
+            break;
+        }
+        case LSL:
+        case LSR:
+        case ASR:
+        case ROL:
+        case ROR:
+            // y is the shift amount
+            if(y_is_m) {
+                for(unsigned k=0; k<WORD_SIZE; k++)
+                    ys.push_back(k);
+            }
+            // y is the shifted value, undo the shift by x
+            else if(op == LSL) {
+                ys.push_back(target >> s);
+                ys.push_back((target >> s) | ~(0xFFFFu >> s));
+            }
+            else if(op == LSR || op == ASR) {
+                ys.push_back(target << s);
+                ys.push_back((target << s) | WIDTH_TO_BITS(s));
+            }
+            else if(op == ROL)
+                ys.push_back((target >> s) | (target << (WORD_SIZE-s)));
+            else
+                ys.push_back((target << s) | (target >> (WORD_SIZE-s)));
+            break;
+        default:
+            break;
+    }
+}
+
+// extends single-register chains of `Rd, Rd, Rd` ops until `target`
+bool ldi_chain(mword_t val, mword_t target, unsigned depth, ldi_seq_t& seq) {
+    if(depth == 0)
+        return val == target;
+    for(auto it=LDI_SELF_OPS.begin(); it!=LDI_SELF_OPS.end(); ++it) {
+        mword_t res = 0;
+        if(!alu_eval(*it, val, val, false, res) || res == val)
+            continue;
+        seq.push_back({ *it, 0, 0, 0, 0 });
+        if(ldi_chain(res, target, depth-1, seq))
+            return true;
+        seq.pop_back();
+    }
+    return false;
+}
+
+// finishes a search state with one ALU op writing `target` to slot 0
+bool ldi_finish_one(const ldi_state_s& st, mword_t target, ldi_seq_t& seq) {
+    for(auto it=LDI_OPS.begin(); it!=LDI_OPS.end(); ++it) {
+        for(uint8_t n=0; n<2; n++) {
+            for(uint8_t m=0; m<2; m++) {
+                const ldi_step_s step = { *it, 0, n, m, 0 };
+                ldi_state_s next = st;
+                if(ldi_apply(step, next) && next.val[0] == target) {
+                    seq.push_back(step);
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// finishes a search state with an immediate solved backwards from `target`
+//   followed by the ALU op that combines it into slot 0
+bool ldi_finish_two(const ldi_state_s& st, mword_t target, ldi_seq_t& seq) {
+    vector<mword_t> ys;
+    for(uint8_t y_slot=0; y_slot<2; y_slot++) {
+        const uint8_t x_slot = 1-y_slot;
+        if(!(st.known & (1<<x_slot)))
+            continue;
+        const mword_t x = st.val[x_slot];
+        for(auto it=LDI_OPS.begin(); it!=LDI_OPS.end(); ++it) {
+            if(*it == NOT)
+                continue;
+            for(unsigned y_is_m=0; y_is_m<2; y_is_m++) {
+                ys.clear();
+                ldi_invert(*it, target, x, y_is_m, ys);
+                for(auto jt=ys.begin(); jt!=ys.end(); ++jt) {
+                    mword_t res = 0;
+                    if(!fits_imm(*jt)
+                            || !alu_eval(*it, y_is_m ? x : *jt,
+                                y_is_m ? *jt : x, false, res)
+                            || res != target)
+                        continue;
+                    seq.push_back({ MOVIM, y_slot, 0, 0, *jt });
+                    seq.push_back({ *it, 0,
+                        static_cast<uint8_t>(y_is_m ? x_slot : y_slot),
+                        static_cast<uint8_t>(y_is_m ? y_slot : x_slot), 0 });
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// enumerates two-register prefixes of length 1 or 2 and tries to finish
+//   them, a lone prefix instruction draws from every immediate value
+bool ldi_search_two(mword_t target, unsigned prefix_len, bool finish_two,
+        const vector<mword_t>& cands, ldi_seq_t& seq) {
+    const unsigned n_first = prefix_len == 1 ? (1u<<IMM) : cands.size();
+    for(uint8_t s=0; s<2; s++) {
+        // gather second prefix steps, skipped for single-step prefixes
+        vector<ldi_step_s> seconds;
+        if(prefix_len == 2) {
+            for(auto it=cands.begin(); it!=cands.end(); ++it)
+                seconds.push_back({ MOVIM, static_cast<uint8_t>(1-s), 0, 0,
+                    *it });
+            for(auto it=LDI_OPS.begin(); it!=LDI_OPS.end(); ++it) {
+                for(uint8_t d=0; d<2; d++)
+                    seconds.push_back({ *it, d, s, s, 0 });
+            }
+        }
+        for(unsigned i=0; i<n_first; i++) {
+            const mword_t imm = prefix_len == 1
+                ? static_cast<mword_t>(IMM_MIN + i) : cands[i];
+            const ldi_step_s first = { MOVIM, s, 0, 0, imm };
+            ldi_state_s st = { { 0, 0 }, 0 };
+            ldi_apply(first, st);
+            if(prefix_len == 1) {
+                seq.assign(1, first);
+                if(finish_two ? ldi_finish_two(st, target, seq)
+                        : ldi_finish_one(st, target, seq))
+                    return true;
+                continue;
+            }
+            for(auto it=seconds.begin(); it!=seconds.end(); ++it) {
+                ldi_state_s next = st;
+                if(!ldi_apply(*it, next))
+                    continue;
+                seq.assign(1, first);
+                seq.push_back(*it);
+                if(finish_two ? ldi_finish_two(next, target, seq)
+                        : ldi_finish_one(next, target, seq))
+                    return true;
+            }
+        }
+    }
+    seq.clear();
+    return false;
+}
+
+/* ------------------------------------------------------------------------- *
+ * materialize_constant
+ * - Searches for the shortest sequence that leaves `target` in the
+ *     destination register (slot 0), using the scratch register (slot 1)
+ *     only when `use_scratch` is set.
+ * - Sequences are built from `MOV Imm` and the carry-independent ALU ops
+ *     in `LDI_OPS`, so the result never depends on the incoming flags.
+ * - The search is exhaustive over single-register chains and over
+ *     two-register sequences whose last immediate is solved backwards
+ *     from `target`, falling back to the generic 5-instruction split.
+ * - Returns true and fills `seq` on success, false if no sequence of at
+ *     most `LDI_MAX_COST` instructions was found.
+ * ------------------------------------------------------------------------- */
+bool materialize_constant(mword_t target, bool use_scratch, ldi_seq_t& seq) {
+    // check cache, programs tend to load the same constants repeatedly
+    // ---------------------------------------------------------------------
+    static map<pair<mword_t,bool>, ldi_seq_t> cache;
+    const auto key = make_pair(target, use_scratch);
+    const auto cached = cache.find(key);
+    if(cached != cache.end()) {
+        seq = cached->second;
+        return !seq.empty();
+    }
+
+    // search by increasing cost
+    // ---------------------------------------------------------------------
+    seq.clear();
+    if(fits_imm(target))
+        seq.push_back({ MOVIM, 0, 0, 0, target });
+    const vector<mword_t> cands = ldi_candidates(target);
+    for(unsigned cost=2; seq.empty() && cost<LDI_MAX_COST; cost++) {
+        // single-register chains, exhaustive over the leading immediate
+        for(long long x=IMM_MIN; x<=IMM_MAX; x++) {
+            seq.assign(1, { MOVIM, 0, 0, 0, static_cast<mword_t>(x) });
+            if(ldi_chain(seq[0].imm, target, cost-1, seq))
+                break;
+            seq.clear();
+        }
+        if(!seq.empty() || !use_scratch)
+            continue;
+        // two-register sequences
+        if(cost-1 <= 2 && ldi_search_two(target, cost-1, false, cands, seq))
+            break;
+        if(cost >= 3 && cost-2 <= 2
+                && ldi_search_two(target, cost-2, true, cands, seq))
+            break;
+    }
+
+    // generic split: high 12 bits shifted into place, low nibble or-ed in
+    // ---------------------------------------------------------------------
+    if(seq.empty() && use_scratch) {
+        mword_t hi = (target>>4) & WIDTH_TO_BITS(IMM);
+        if(hi & (1<<(IMM-1)))
+            hi |= ~WIDTH_TO_BITS(IMM);
+        seq = {
+            { MOVIM, 0, 0, 0, hi },
+            { MOVIM, 1, 0, 0, 4 },
+            { LSL,   0, 0, 1, 0 },
+            { MOVIM, 1, 0, 0, static_cast<mword_t>(target & 0xF) },
+            { OR,    0, 0, 1, 0 },
+        };
+    }
+
+    cache[key] = seq;
+    return !seq.empty();
+}
+
+/* ------------------------------------------------------------------------- *
+ * Program rewriting helpers
+ * ------------------------------------------------------------------------- */
+// copies the parallel instruction vectors into rows, with origins set
+vector<inst_row_s> program_rows(const prog_s& prog) {
+    vector<inst_row_s> rows;
+    for(unsigned i=0; i<prog.insts.size(); i++)
+        rows.push_back(program_rows(prog, i));
+    return rows;
+}
+
+// copies a single row of the parallel instruction vectors
+inst_row_s program_rows(const prog_s& prog, unsigned i) {
+    return { prog.insts[i].first, prog.insts[i].second, prog.insts_raw[i],
+        prog.debug_line_nums[i], prog.debug_macro_lines[i],
+        prog.debug_notes[i], static_cast<int>(i) };
+}
+
+// replaces the instruction list with `rows`, moving labels to their origins
+void rewrite_program(prog_s& prog, const vector<inst_row_s>& rows) {
+    // map old indices to the first row that takes their labels, labels of
+    //   dropped instructions fall through to the next surviving one
+    const unsigned n = prog.insts.size();
+    vector<int> remap(n+1, -1);
+    for(unsigned r=rows.size(); r-->0; ) {
+        if(rows[r].origin >= 0)
+            remap[rows[r].origin] = r;
+    }
+    remap[n] = rows.size();
+    for(unsigned i=n; i-->0; ) {
+        if(remap[i] < 0)
+            remap[i] = remap[i+1];
+    }
+
+    // rebuild parallel instruction vectors
+    prog.insts.clear();
+    prog.insts_raw.clear();
+    prog.debug_line_nums.clear();
+    prog.debug_macro_lines.clear();
+    prog.debug_notes.clear();
+    prog.mcode.clear();
+    for(auto it=rows.begin(); it!=rows.end(); ++it) {
+        prog.insts.emplace_back(it->opcode, it->toks);
+        prog.insts_raw.push_back(it->toks_raw);
+        prog.debug_line_nums.push_back(it->line_num);
+        prog.debug_macro_lines.push_back(it->macro_line);
+        prog.debug_notes.push_back(it->note);
+    }
+
+    // move labels, including hidden ones that only live in the lookup
+    for(auto it=prog.label_lookup.begin(); it!=prog.label_lookup.end(); ++it) {
+        if(it->second <= n)
+            it->second = remap[it->second];
+    }
+    for(auto it=prog.labels.begin(); it!=prog.labels.end(); ++it)
+        it->address = prog.label_lookup[it->name];
+    stable_sort(prog.labels.begin(), prog.labels.end(),
+        [](const label_s& a, const label_s& b) {
+            return a.address < b.address;
+        });
+}
+
+// resolves the instruction index targeted by a B-type instruction, or -1
+int branch_target(const prog_s& prog, unsigned i) {
+    const string& opr = prog.insts[i].second.at(1);
+    long long target = 0;
+    const auto found = prog.label_lookup.find(opr);
+    if(found != prog.label_lookup.end())
+        target = found->second;
+    else {
+        long long offset = 0;
+        if(!parse_immediate(opr, offset))
+            return -1;
+        target = i + 1LL + offset;
+    }
+    if(target < 0 || target > static_cast<long long>(prog.insts.size()))
+        return -1;
+    return target;
+}
+
+// replaces numeric branch offsets with hidden labels so they survive moves
+void anchor_branch_offsets(prog_s& prog) {
+    for(unsigned i=0; i<prog.insts.size(); i++) {
+        if(OPC_TO_FMT.at(prog.insts[i].first) != B_TYPE)
+            continue;
+        string& opr = prog.insts[i].second.at(1);
+        const int target = branch_target(prog, i);
+        if(target < 0 || prog.label_lookup.count(opr) > 0)
+            continue;
+        opr = anchor_label(prog, target);
+    }
+}
+
+// finds or adds the hidden label naming an instruction index
+string anchor_label(prog_s& prog, unsigned target) {
+    // hidden labels start with '@', which user labels can't contain
+    string anchor = "@" + to_hex_string(target);
+    while(prog.label_lookup.count(anchor) > 0
+            && prog.label_lookup.at(anchor) != target)
+        anchor += '\'';
+    prog.label_lookup[anchor] = target;
+    return anchor;
+}
+
+// collects register/flag bitmasks (`FLAGS_BIT`) read and written by an inst
+//   - a branch's implicit write of the PC is not included
+void inst_regs(OPCODE opc, const inst_tokens_t& toks,
+        unsigned& uses, unsigned& defs) {
+    // bit for the register in the `o`th operand, 0 if it isn't one
+    auto reg_bit = [&toks](unsigned o) -> unsigned {
+        mword_t r = 0;
+        if(1+o >= toks.size() || !encode_register(toks[1+o], r))
+            return 0;
+        return 1u<<r;
+    };
+    const I_FMT inst_fmt = OPC_TO_FMT.at(opc);
+    uses = 0;
+    defs = 0;
+    switch(inst_fmt) {
+        case R1_TYPE:
+        case I_TYPE:
+            defs = reg_bit(0);
+            break;
+        case R2_TYPE:
+            defs = reg_bit(0);
+            uses = reg_bit(1);
+            break;
+        case R2NW_TYPE:
+            uses = reg_bit(0) | reg_bit(1);
+            break;
+        case R3_TYPE:
+            defs = reg_bit(0);
+            uses = reg_bit(1) | reg_bit(2);
+            break;
+        case FL_TYPE:
+            defs = reg_bit(0);
+            uses = 1u<<FLAGS_BIT;
+            break;
+        case FS_TYPE:
+            defs = 1u<<FLAGS_BIT;
+            uses = reg_bit(1);
+            break;
+        case LS_TYPE:
+        case LSO_TYPE:
+            uses = reg_bit(1) | (inst_fmt == LSO_TYPE ? reg_bit(2) : 0);
+            if(opc == LDR || opc == LDRO)
+                defs = reg_bit(0);
+            else
+                uses |= reg_bit(0);
+            break;
+        default:
+            break;
+    }
+    // ALU ops set the flags, ADD/SUB take the carry, conditionals test Z
+    if(opc >= ADD && opc <= CMP)
+        defs |= 1u<<FLAGS_BIT;
+    if(opc == ADD || opc == SUB || opc == BEQ || opc == BNE)
+        uses |= 1u<<FLAGS_BIT;
+}
+
+// finds the first instruction that reads or writes the PC, or -1
+int find_pc_inst(const prog_s& prog) {
+    for(unsigned i=0; i<prog.insts.size(); i++) {
+        unsigned uses, defs;
+        inst_regs(prog.insts[i].first, prog.insts[i].second, uses, defs);
+        if((uses | defs) & (1u<<PC_REG))
+            return i;
+    }
+    return -1;
+}
+
+// matches the pattern of `rule` at instruction `i`, mapping its variables
+//   to registers in `regs`, if what it doesn't keep is dead after it
+bool match_rule(const prog_s& prog, const peep_rule_s& rule, unsigned i,
+        const vector<bool>& is_target, const vector<unsigned>& live_after,
+        unsigned regs[MAX_REG]) {
+    const unsigned len = rule.pattern.size();
+    if(i+len > prog.insts.size())
+        return false;
+    fill(regs, regs+MAX_REG, MAX_REG);
+    unsigned used = 0;
+    for(unsigned k=0; k<len; k++) {
+        const peep_inst_s& inst = rule.pattern[k];
+        const OPCODE opc = prog.insts[i+k].first;
+        const inst_tokens_t& toks = prog.insts[i+k].second;
+        if((k > 0 && is_target[i+k]) || opc != inst.opcode)
+            return false;
+        const fmt_config_t& fmt_config = FMT_CONFIG[OPC_TO_FMT.at(opc)];
+        for(unsigned o=0; o<fmt_config.size(); o++) {
+            if(fmt_config[o].second == IMM) {
+                long long val = 0;
+                if(!parse_immediate(toks.at(1+o), val) || val != inst.imm)
+                    return false;
+                continue;
+            }
+            // variables map one-to-one onto registers other than the PC
+            mword_t r = 0;
+            unsigned& reg = regs[inst.vars[o]];
+            if(!encode_register(toks.at(1+o), r) || r == PC_REG
+                    || (reg == MAX_REG && (used & (1u<<r)))
+                    || (reg != MAX_REG && reg != r))
+                return false;
+            reg = r;
+            used |= 1u<<r;
+        }
+    }
+    unsigned must_die = rule.flags ? 1u<<FLAGS_BIT : 0;
+    for(unsigned v=0; v<rule.n_vars; v++) {
+        if((rule.writes & ~rule.keeps) & (1u<<v))
+            must_die |= 1u<<regs[v];
+    }
+    return (live_after[i+len-1] & must_die) == 0;
+}
+
+// builds the instruction tokens of a rule instruction on registers `regs`
+inst_tokens_t rule_inst_tokens(const peep_inst_s& inst,
+        const unsigned regs[MAX_REG]) {
+    inst_tokens_t toks;
+    toks.push_back(opcode_mnemonic(inst.opcode));
+    const fmt_config_t& fmt_config = FMT_CONFIG[OPC_TO_FMT.at(inst.opcode)];
+    for(unsigned o=0; o<fmt_config.size(); o++) {
+        toks.push_back(fmt_config[o].second == IMM ? to_string(inst.imm)
+            : reg_token(regs[inst.vars[o]]));
+    }
+    return toks;
+}
+
+// computes the known bits of an ALU result and the carry it leaves
+known_bits_s known_alu(OPCODE opc, const known_bits_s& n,
+        const known_bits_s& m, const known_bits_s& carry,
+        known_bits_s& carry_out) {
+    const known_bits_s unknown = { 0, 0 };
+    carry_out = opc == AND ? known_const(0) : unknown;
+    const bool reads_carry = opc == ADD || opc == SUB;
+    if(is_known(n) && (opc == NOT || is_known(m))
+            && (!reads_carry || is_known(carry))) {
+        uint16_t res = 0;
+        if(alu_carry_known(opc))
+            carry_out = known_const(alu_carry(opc, n.ones, m.ones,
+                carry.ones));
+        if(opc == CMP || !alu_eval(opc, n.ones, m.ones, carry.ones, res))
+            return unknown;
+        return known_const(res);
+    }
+    OPCODE red_opc;
+    unsigned src;
+    mword_t amount;
+    if(reduced_op(opc, n, m, red_opc, src, amount)) {
+        // the carry is still the one `opc` leaves, not the cheaper op's
+        const known_bits_s res = known_alu(red_opc, src == 0 ? n : m,
+            known_const(amount), carry, carry_out);
+        carry_out = unknown;
+        return res;
+    }
+
+    // shifts and rotates by a known amount move the known bits along
+    const unsigned s = m.ones & 0xF;
+    const bool s_known = ((m.zeros | m.ones) & 0xF) == 0xF;
+    switch(opc) {
+        case AND:
+            return { mword_t(n.zeros | m.zeros), mword_t(n.ones & m.ones) };
+        case OR:
+            return { mword_t(n.zeros & m.zeros), mword_t(n.ones | m.ones) };
+        case EOR:
+            return { mword_t((n.zeros & m.zeros) | (n.ones & m.ones)),
+                mword_t((n.zeros & m.ones) | (n.ones & m.zeros)) };
+        case NOT:
+            return { n.ones, n.zeros };
+        default:
+            break;
+    }
+    if(!s_known || opc < LSL || opc > ROR)
+        return unknown;
+    const mword_t low = (1u<<s)-1;
+    switch(opc) {
+        case LSL:
+            return { mword_t((n.zeros << s) | low), mword_t(n.ones << s) };
+        case LSR:
+            return { mword_t((n.zeros >> s) | ~(0xFFFFu >> s)),
+                mword_t(n.ones >> s) };
+        case ASR:
+            return { mword_t(static_cast<int16_t>(n.zeros) >> s),
+                mword_t(static_cast<int16_t>(n.ones) >> s) };
+        default: {
+            const unsigned l = opc == ROL ? s : (16-s) & 0xF;
+            return { mword_t((n.zeros << l) | (n.zeros >> (16-l))),
+                mword_t((n.ones << l) | (n.ones >> (16-l))) };
+        }
+    }
+}
+
+// finds the cheaper op computing a `MUL`, `DIV` or `MOD` by a power of two,
+//   with the operand it keeps (0 or 1) in `src` and its constant `amount`
+bool reduced_op(OPCODE opc, const known_bits_s& n, const known_bits_s& m,
+        OPCODE& red_opc, unsigned& src, mword_t& amount) {
+    // power of two in a known value, 16 if it isn't one
+    auto log2_known = [](const known_bits_s& k) -> unsigned {
+        unsigned l = 0;
+        while(l < 16 && (!is_known(k) || k.ones != 1u<<l))
+            l++;
+        return l;
+    };
+    if(opc == MUL) {
+        // either operand can be the power of two
+        src = log2_known(m) < 16 ? 0 : 1;
+        amount = log2_known(src == 0 ? m : n);
+        red_opc = LSL;
+        return amount < 16;
+    }
+    // signed division only shifts and masks like this for dividends that
+    //   are known non-negative, and 0x8000 is negative as a divisor
+    const unsigned l = log2_known(m);
+    if((opc != DIV && opc != MOD) || l >= 15 || !(n.zeros & 0x8000))
+        return false;
+    src = 0;
+    red_opc = opc == DIV ? ASR : AND;
+    amount = opc == DIV ? l : (1u<<l)-1;
+    return true;
+}
+
+// applies an instruction to the known register values and carry of `state`
+void const_step(const prog_s& prog, unsigned i, const_state_s& state) {
+    const OPCODE opc = prog.insts[i].first;
+    const inst_tokens_t& toks = prog.insts[i].second;
+    const known_bits_s unknown = { 0, 0 };
+    // known bits of the register in the `o`th operand, none for the PC
+    auto opr = [&toks, &state, &unknown](unsigned o) -> known_bits_s {
+        mword_t r = 0;
+        if(1+o >= toks.size() || !encode_register(toks[1+o], r)
+                || r == PC_REG)
+            return unknown;
+        return state.regs[r];
+    };
+    mword_t rd = 0;
+    const bool has_rd = toks.size() > 1 && encode_register(toks[1], rd);
+    long long imm = 0;
+    switch(opc) {
+        case MOVIM:
+            state.regs[rd] = parse_immediate(toks.at(2), imm)
+                ? known_const(imm) : unknown;
+            break;
+        case MOVRR:
+            state.regs[rd] = opr(1);
+            break;
+        case MOVRF:
+        case LDR:
+        case LDRO:
+            state.regs[rd] = unknown;
+            break;
+        case MOVFR: {
+            // the carry is bit 1 of the flags
+            const known_bits_s flags = opr(1);
+            state.carry = (flags.zeros & 0b10) ? known_const(0)
+                : (flags.ones & 0b10) ? known_const(1)
+                : known_bits_s{ 0xFFFE, 0 };
+            break;
+        }
+        default:
+            if(opc < ADD || opc > CMP)
+                break;
+            const known_bits_s carry = state.carry;
+            const known_bits_s res = known_alu(opc, opr(1), opr(2), carry,
+                state.carry);
+            if(opc != CMP && has_rd)
+                state.regs[rd] = res;
+            break;
+    }
+}
+
+// joins `from` into `to`, keeping the bits known alike, true if `to` changed
+bool join_const_state(const_state_s& to, const const_state_s& from) {
+    if(!from.reached)
+        return false;
+    if(!to.reached) {
+        to = from;
+        return true;
+    }
+    bool changed = false;
+    auto join = [&changed](known_bits_s& k, const known_bits_s& add) {
+        const known_bits_s joined = { mword_t(k.zeros & add.zeros),
+            mword_t(k.ones & add.ones) };
+        changed |= joined.zeros != k.zeros || joined.ones != k.ones;
+        k = joined;
+    };
+    for(unsigned r=0; r<MAX_REG; r++)
+        join(to.regs[r], from.regs[r]);
+    join(to.carry, from.carry);
+    return changed;
+}
+
+// builds the known bits of a constant
+known_bits_s known_const(mword_t val) {
+    return { mword_t(~val), val };
+}
+
+// checks if every bit of a value is known
+bool is_known(const known_bits_s& k) {
+    return mword_t(k.zeros | k.ones) == 0xFFFF;
 }
 
-/* ------------------------------------------------------------------------- *
- * print_program_listing
- * - Prints more verbose program listing to standard error.
- * ------------------------------------------------------------------------- */
-void print_program_listing(const prog_s& prog) {
-    cerr << "=== LABEL LIST ===" << endl;
-    string::size_type longest_label = 0; //5;
-    for(auto it=prog.labels.begin(); it!=prog.labels.end(); ++it) {
-        if(it->name.size() > longest_label)
-            longest_label = it->name.size();
+// finds the sorted indices that start basic blocks, `prog.insts.size()` last
+vector<unsigned> block_starts(const prog_s& prog) {
+    const unsigned n = prog.insts.size();
+    vector<bool> is_start(n+1, false);
+    is_start[0] = true;
+    is_start[n] = true;
+    for(auto it=prog.label_lookup.begin(); it!=prog.label_lookup.end(); ++it) {
+        if(it->second <= n)
+            is_start[it->second] = true;
     }
-    longest_label += 1;
-    // cerr << setw(longest_label) << "LABEL"
-    //      << " : ADDR" << endl
-    //      << setfill('-') << setw(longest_label+1) << ""
-    //      << "+"
-    //      << setw(max(0UL,18-(longest_label+2))) << ""
-    //      << setfill(' ') << endl;
-    for(auto it=prog.labels.begin(); it!=prog.labels.end(); ++it) {
-        cerr << setw(longest_label) << it->name 
-             << ": 0x" << to_hex_string(it->address, IMM)
-             << endl;
+    for(unsigned i=0; i<n; i++) {
+        unsigned uses, defs;
+        inst_regs(prog.insts[i].first, prog.insts[i].second, uses, defs);
+        if(ends_block(prog.insts[i].first, defs))
+            is_start[i+1] = true;
+        if(OPC_TO_FMT.at(prog.insts[i].first) == B_TYPE) {
+            const int target = branch_target(prog, i);
+            if(target >= 0)
+                is_start[target] = true;
+        }
     }
-    cerr << endl
-         << "====== MACHINE PROGRAM ======" << endl
-         << "  ADDR: MCODE  | ASSEMBLY    " << endl
-         << "---------------+-------------" << endl;
-    for(unsigned i=0; i<prog.insts.size(); i++) {
-        cerr << " 0x" << to_hex_string(static_cast<mword_t>(i), IMM) << ':'
-             << " 0x" << to_hex_string(prog.mcode[i]) << " | ";
-        const I_FMT inst_fmt = OPC_TO_FMT.at(prog.insts[i].first);
-        bool is_ls_type = inst_fmt == LS_TYPE || inst_fmt == LSO_TYPE;
-        const inst_tokens_t& toks = prog.insts[i].second;
-        cerr << setw(4) << setiosflags(ios_base::left) << toks.at(0);
-        for(unsigned t=1; t<toks.size(); t++) {
-            if(t > 1)
-                cerr << ',';
-            cerr << ' ';
-            if(t == 2 && is_ls_type)
-                cerr << '[';
-            cerr << toks.at(t);
-        }
-        if(is_ls_type)
-            cerr << ']';
-        cerr << endl;
+    vector<unsigned> starts;
+    for(unsigned i=0; i<=n; i++) {
+        if(is_start[i])
+            starts.push_back(i);
     }
+    // an empty program still ends at 0
+    if(starts.size() == 1)
+        starts.push_back(0);
+    return starts;
+}
+
+// checks if an instruction ends a basic block (branch, halt, PC write)
+bool ends_block(OPCODE opc, unsigned defs) {
+    return OPC_TO_FMT.at(opc) == B_TYPE || opc == HALT
+        || (defs & (1u<<PC_REG));
 }
 
 /* ------------------------------------------------------------------------- *
  * Smaller helper functions
  * ------------------------------------------------------------------------- */
+// builds the operand fields of each format from `FMT_FIELDS`
+array<fmt_config_t, FMT_LEN> build_fmt_config() {
+    array<fmt_config_t, FMT_LEN> config;
+    for(unsigned f=0; f<FMT_LEN; f++) {
+        for(unsigned o=0; o<FMT_FIELDS[f].n_oprs; o++)
+            config[f].emplace_back(FMT_FIELDS[f].oprs[o].pos,
+                FMT_FIELDS[f].oprs[o].width);
+    }
+    return config;
+}
+
+// builds the format of each opcode from `OPC_FMTS`
+map<OPCODE, I_FMT> build_opc_to_fmt() {
+    map<OPCODE, I_FMT> opc_to_fmt;
+    for(const opc_fmt_s& it : OPC_FMTS)
+        opc_to_fmt[it.opcode] = it.fmt;
+    return opc_to_fmt;
+}
+
+// builds the opcodes of each mnemonic from `MNEMONICS`
+map<string, vector<OPCODE>> build_isa() {
+    map<string, vector<OPCODE>> isa;
+    for(const mnemonic_s& it : MNEMONICS)
+        isa[it.name].assign(it.opcodes, it.opcodes+it.n_opcodes);
+    return isa;
+}
+
 // encodes an operand string into a register value
 bool encode_register(const string& str, mword_t& buf) {
     if(str.size() != 2 || toupper(str[0]) != 'R')
@@ -998,6 +6518,132 @@ string to_hex_string(mword_t enc_inst, int bits_to_convert) {
     return string(hex.rbegin(), hex.rend());
 }
 
+// parses a 12-bit immediate token the same way `encode_program` does
+bool parse_immediate(const string& str, long long& val) {
+    smatch num_m;
+    if(regex_match(str, num_m, dec_re)) {
+        val = strtoll(num_m[1].str().c_str(), nullptr, 10);
+        return val >= IMM_MIN && val <= IMM_MAX;
+    }
+    if(regex_match(str, num_m, hex_re) && num_m[1].length() <= IMM_NIBS)
+        val = strtoll(num_m[1].str().c_str(), nullptr, 16);
+    else if(regex_match(str, num_m, bin_re) && num_m[1].length() <= IMM)
+        val = strtoll(num_m[1].str().c_str(), nullptr, 2);
+    else
+        return false;
+    // convert to negative
+    if(val&(1<<(IMM-1)))
+        val |= -1ULL<<IMM;
+    return val >= IMM_MIN && val <= IMM_MAX;
+}
+
+// parses a 16-bit immediate (signed or unsigned decimal, hex or binary)
+bool parse_wide_immediate(const string& str, long long& val) {
+    smatch num_m;
+    if(regex_match(str, num_m, dec_re)) {
+        val = strtoll(num_m[1].str().c_str(), nullptr, 10);
+        return val >= INT16_MIN && val <= UINT16_MAX;
+    }
+    if(regex_match(str, num_m, hex_re)) {
+        val = strtoll(num_m[1].str().c_str(), nullptr, 16);
+        return num_m[1].length() <= WORD_SIZE/4;
+    }
+    if(regex_match(str, num_m, bin_re)) {
+        val = strtoll(num_m[1].str().c_str(), nullptr, 2);
+        return num_m[1].length() <= WORD_SIZE;
+    }
+    return false;
+}
+
+// checks if a word survives sign-extension from an immediate field
+bool fits_imm(mword_t val) {
+    const int16_t sval = static_cast<int16_t>(val);
+    return sval >= IMM_MIN && sval <= IMM_MAX;
+}
+
+// looks up the mnemonic that an opcode is written with
+const string& opcode_mnemonic(OPCODE opc) {
+    static const string unknown = "???";
+    for(auto it=ISA.begin(); it!=ISA.end(); ++it) {
+        if(find(it->second.begin(), it->second.end(), opc)
+                != it->second.end())
+            return it->first;
+    }
+    return unknown;
+}
+
+// appends to the listing note of a row, separating notes with `;`
+void add_note(string& note, const string& add) {
+    note += (note.empty() ? "" : "; ") + add;
+}
+
+// formats an encoded instruction the way the listing shows it
+string listing_str(const prog_s& prog, unsigned i) {
+    stringstream out;
+    const I_FMT inst_fmt = OPC_TO_FMT.at(prog.insts[i].first);
+    bool is_ls_type = inst_fmt == LS_TYPE || inst_fmt == LSO_TYPE;
+    const inst_tokens_t& toks = prog.insts[i].second;
+    out << setw(4) << setiosflags(ios_base::left) << toks.at(0);
+    for(unsigned t=1; t<toks.size(); t++) {
+        if(t > 1)
+            out << ',';
+        out << ' ';
+        if(t == 2 && is_ls_type)
+            out << '[';
+        out << toks.at(t);
+    }
+    if(is_ls_type)
+        out << ']';
+    return out.str();
+}
+
+// formats the listing row of an instruction, with its address and notes
+string listing_row(const prog_s& prog, unsigned i) {
+    string row = " 0x" + to_hex_string(static_cast<mword_t>(i), IMM) + ":"
+        + " 0x" + to_hex_string(prog.mcode[i]) + " | " + listing_str(prog, i);
+    if(!prog.debug_notes[i].empty())
+        row += " ; " + prog.debug_notes[i];
+    return row;
+}
+
+// decodes the opcode of an encoded instruction
+OPCODE decode_opcode(mword_t word) {
+    // B-type opcodes only use the top 4 bits, I-type only the top bit
+    if(word >> (WORD_SIZE-1))
+        return MOVIM;
+    const OPCODE b_opc = static_cast<OPCODE>(word & ~WIDTH_TO_BITS(IMM));
+    if(b_opc == B || b_opc == BEQ || b_opc == BNE)
+        return b_opc;
+    const OPCODE opc = static_cast<OPCODE>(word & (WIDTH_TO_BITS(7)<<9));
+    return OPC_TO_FMT.count(opc) ? opc : NOP;
+}
+
+// looks up the cycle cost of an opcode in the pipeline model
+unsigned cycle_cost(OPCODE opc, const pipe_model_s& model) {
+    const auto found = model.cycles.find(opc);
+    return found != model.cycles.end() ? found->second : 1;
+}
+
+// builds a register operand token from a register number
+string reg_token(unsigned r) {
+    return "R" + to_string(r);
+}
+
+// builds the instruction tokens of a materialization step
+inst_tokens_t ldi_step_tokens(const ldi_step_s& step, const mword_t regs[2]) {
+    inst_tokens_t toks;
+    toks.push_back(opcode_mnemonic(step.opcode));
+    toks.push_back(reg_token(regs[step.dst]));
+    if(step.opcode == MOVIM)
+        toks.push_back(to_string(static_cast<int16_t>(step.imm)));
+    else {
+        toks.push_back(reg_token(regs[step.src_n]));
+        if(OPC_TO_FMT.at(step.opcode) == R3_TYPE)
+            toks.push_back(reg_token(regs[step.src_m]));
+    }
+    return toks;
+}
+
 // checks label name against mnemonics, register formats, and illegal names
 set<string> illegal_label_cache;
 bool is_reserved_name(const string& str) {
@@ -1018,24 +6664,248 @@ bool is_reserved_name(const string& str) {
     return illegal_label_cache.count(str) == 0;
 }
 
+// checks and adds the labels extracted into `m` at `address`, naming data
+//   addresses when `is_data` is set
+bool parse_labels(const string& line_buf, const smatch& m, unsigned file_line,
+        unsigned address, bool is_data, prog_s& prog) {
+    if(m[1].length() == 0)
+        return true;
+    const string& labels = m[1].str();
+    sregex_iterator reit_begin(labels.begin(), labels.end(), label_re);
+    sregex_iterator reit_end;
+    for(auto it=reit_begin; it!=reit_end; ++it) {
+        if(!add_label((*it)[1].str(), line_buf, m.position(1)+it->position(1),
+                it->length(), file_line, address, is_data, prog))
+            return false;
+    }
+    return true;
+}
+
+// checks and adds a label at `address`, marking `line_buf` from `pos` on
+//   errors, naming a data address when `is_data` is set
+bool add_label(const string& label_raw_buf, const string& line_buf, int pos,
+        int len, unsigned file_line, unsigned address, bool is_data,
+        prog_s& prog) {
+    const string label_buf = str_to_upper(label_raw_buf);
+
+    // error: empty label
+    if(label_buf.size() == 0) {
+        cerr << "Error: line[" << file_line << "]: "
+             << "expected label name before ':', "
+             << "but found empty string:"
+             << endl;
+        line_error_marker(line_buf, pos, 1);
+        return false;
+    }
+
+    // error: illegal label, reserved
+    if(!is_reserved_name(label_buf)) {
+        cerr << "Error: line[" << file_line << "]: "
+             << "illegal label name '"
+             << label_raw_buf << "', reserved by ISA:"
+             << endl;
+        line_error_marker(line_buf, pos, len);
+        return false;
+    }
+
+    // error: invalid label (leading digit)
+    if(isdigit(label_buf[0])) {
+        cerr << "Error: line[" << file_line << "]: "
+             << "invalid label name '"
+             << label_raw_buf << "', can't start with a digit:"
+             << endl;
+        line_error_marker(line_buf, pos, len);
+        return false;
+    }
+
+    // error: label named like a symbol (`.equ`, `-D`)
+    if(prog.equs.count(label_buf) != 0) {
+        cerr << "Error: line[" << file_line << "]: "
+             << "illegal label name '"
+             << label_raw_buf << "', defined as a symbol:"
+             << endl;
+        line_error_marker(line_buf, pos, len);
+        return false;
+    }
+
+    // error: repeated label
+    if(prog.label_lookup.count(label_buf) != 0
+            || prog.data_lookup.count(label_buf) != 0) {
+        cerr << "Error: line[" << file_line << "]: "
+             << "repeat instance of label '"
+             << label_raw_buf << "':"
+             << endl;
+        line_error_marker(line_buf, pos, len);
+        return false;
+    }
+
+    // error: data label past the end of data memory
+    if(is_data && address >= MAX_DATA) {
+        cerr << "Error: line[" << file_line << "]: "
+             << "data label '" << label_raw_buf
+             << "' is past the end of data memory ("
+             << "max = " << MAX_DATA << " words):"
+             << endl;
+        line_error_marker(line_buf, pos, len);
+        return false;
+    }
+
+    // insert label list and lookup
+    mword_t target_addr = address;
+    if(is_data) {
+        prog.data_lookup[label_buf] = target_addr;
+        prog.data_labels.push_back({ label_buf, target_addr });
+    }
+    else {
+        prog.label_lookup[label_buf] = target_addr;
+        prog.labels.push_back({ label_buf, target_addr });
+    }
+    return true;
+}
+
+// name of the directive on `line` after any labels, uppercase, or empty if
+//   there is none (a cheap scan, without matching the whole line)
+string line_directive(const string& line) {
+    string::size_type i = line.find_first_not_of(" \t");
+    // skip labels
+    while(i != string::npos && i < line.size() && line[i] != '.') {
+        string::size_type j = i;
+        while(j < line.size() && (isalnum(line[j]) || line[j] == '_'))
+            j++;
+        if(j >= line.size() || line[j] != ':')
+            return "";
+        i = line.find_first_not_of(" \t", j+1);
+    }
+    if(i == string::npos || i >= line.size())
+        return "";
+    string::size_type j = i+1;
+    while(j < line.size() && (isalnum(line[j]) || line[j] == '_'))
+        j++;
+    return str_to_upper(line.substr(i+1, j-i-1));
+}
+
+// parses a 16-bit number or the value of a symbol in `syms`
+bool symbol_value(const string& str, const map<string, long long>& syms,
+        long long& val) {
+    const string key = str_to_upper(str);
+    if(parse_wide_immediate(key, val))
+        return true;
+    auto it = syms.find(key);
+    if(it == syms.end())
+        return false;
+    val = it->second;
+    return true;
+}
+
+// lists the words of the operands `oprs` that can name symbols, with their
+//   positions (numbers and macro parameters are left out)
+vector<pair<string::size_type, string>> symbol_words(const string& oprs) {
+    vector<pair<string::size_type, string>> words;
+    string::size_type i = 0;
+    while(i < oprs.size()) {
+        if(!isalnum(oprs[i]) && oprs[i] != '_') {
+            i++;
+            continue;
+        }
+        string::size_type j = i;
+        while(j < oprs.size() && (isalnum(oprs[j]) || oprs[j] == '_'))
+            j++;
+        if(!isdigit(oprs[i]) && (i == 0 || oprs[i-1] != '\\'))
+            words.push_back({ i, oprs.substr(i, j-i) });
+        i = j;
+    }
+    return words;
+}
+
+// replaces the symbols of `syms` in the operands `oprs` by their values
+string substitute_symbols(const string& oprs,
+        const map<string, long long>& syms) {
+    string out;
+    string::size_type last = 0;
+    const auto words = symbol_words(oprs);
+    for(auto it=words.begin(); it!=words.end(); ++it) {
+        auto sym = syms.find(str_to_upper(it->second));
+        if(sym == syms.end())
+            continue;
+        out += oprs.substr(last, it->first-last) + to_string(sym->second);
+        last = it->first + it->second.size();
+    }
+    return out + oprs.substr(last);
+}
+
+// formats the source line of an instruction, with its macro body line
+string line_ref(const prog_s& prog, unsigned i) {
+    if(prog.debug_macro_lines[i] == 0)
+        return to_string(prog.debug_line_nums[i]);
+    return to_string(prog.debug_line_nums[i]) + ", macro line "
+        + to_string(prog.debug_macro_lines[i]);
+}
+
+// takes back the instructions, labels and patched branches of a `-i` line
+void undo_repl_line(prog_s& prog, const repl_line_s& line,
+        map<string, vector<unsigned>>& pending) {
+    // branches the line patched wait for their label again
+    for(auto it=line.patched.begin(); it!=line.patched.end(); ++it) {
+        const string key = str_to_upper(prog.insts_raw[*it][1]);
+        prog.insts[*it].second[1] = key;
+        prog.mcode[*it] = prog.insts[*it].first;
+        prog.debug_notes[*it] = REPL_PENDING_NOTE;
+        pending[key].push_back(*it);
+    }
+    // drop the line's own branches, labels and instructions
+    for(auto it=pending.begin(); it!=pending.end(); ) {
+        vector<unsigned>& refs = it->second;
+        refs.erase(remove_if(refs.begin(), refs.end(), [&](unsigned i) {
+            return i >= line.n_insts; }), refs.end());
+        it = refs.empty() ? pending.erase(it) : next(it);
+    }
+    for(unsigned l=line.n_labels; l<prog.labels.size(); l++)
+        prog.label_lookup.erase(prog.labels[l].name);
+    prog.labels.resize(line.n_labels);
+    prog.insts.resize(line.n_insts);
+    prog.insts_raw.resize(line.n_insts);
+    prog.debug_line_nums.resize(line.n_insts);
+    prog.debug_macro_lines.resize(line.n_insts);
+    prog.debug_notes.resize(line.n_insts);
+    prog.mcode.resize(line.n_insts);
+}
+
 /* ------------------------------------------------------------------------- *
  * IO helper functions
  * ------------------------------------------------------------------------- */
 // validates and organizes command line options
 bool get_options(int argc, char** argv, prog_opts_s& opts) {
+    // interactive mode only takes an (optional) object file
+    int first_opt = 3;
+    if(argc > 1 && strcmp(argv[1], "-i") == 0) {
+        opts.interactive_flag = true;
+        first_opt = argc > 2 && argv[2][0] != '-' ? 3 : 2;
+        if(first_opt == 3)
+            opts.out_file = argv[2];
+    }
+
     // error: invalid number of arguments
-    if(argc < 3 || argc > 6) {
+    else if(argc < 3) {
         if(argc > 1)
             cerr << "Error: invalid number of arguments" << endl;
         return false;
     }
 
     // src and out file option is always 1st and 2nd arguments
-    opts.src_file = argv[1];
-    opts.out_file = argv[2];
+    else {
+        opts.src_file = argv[1];
+        opts.out_file = argv[2];
+    }
 
     // loop through other arguments 
-    for(int i=3; i<argc; i++) {
+    for(int i=first_opt; i<argc; i++) {
+        // error: interactive mode has no passes, reports or other outputs
+        if(opts.interactive_flag && strcmp(argv[i], "-s") != 0) {
+            cerr << "Error: only `-s` can be given with `-i`, found '"
+                 << argv[i] << "'"
+                 << endl;
+            return false;
+        }
         // parse list_flag option
         if(strcmp(argv[i], "-l") == 0) {
             opts.list_flag = true; 
@@ -1044,6 +6914,130 @@ bool get_options(int argc, char** argv, prog_opts_s& opts) {
         else if(strcmp(argv[i], "-s") == 0) {
             opts.strict_flag = true;
         }
+        // parse optimization pass list option
+        else if(strcmp(argv[i], "-O") == 0 && i+1 < argc) {
+            const vector<string> passes = split_str(argv[++i], ',');
+            for(auto it=passes.begin(); it!=passes.end(); ++it) {
+                if(*it == "sched")
+                    opts.sched_flag = true;
+                else if(*it == "layout")
+                    opts.layout_flag = true;
+                else if(*it == "dead")
+                    opts.dead_flag = true;
+                else if(*it == "clc")
+                    opts.clc_flag = true;
+                else if(*it == "peep")
+                    opts.peep_flag = true;
+                else if(*it == "const")
+                    opts.const_flag = true;
+                else {
+                    cerr << "Error: unrecognized optimization pass '" << *it
+                         << "'"
+                         << endl;
+                    return false;
+                }
+            }
+        }
+        // parse report list option
+        else if(strcmp(argv[i], "-R") == 0 && i+1 < argc) {
+            const vector<string> reports = split_str(argv[++i], ',');
+            for(auto it=reports.begin(); it!=reports.end(); ++it) {
+                if(*it == "hazards")
+                    opts.hazard_report_flag = true;
+                else if(*it == "cfg")
+                    opts.cfg_report_flag = true;
+                else if(*it == "dead")
+                    opts.dead_report_flag = true;
+                else if(*it == "carry")
+                    opts.carry_report_flag = true;
+                else {
+                    cerr << "Error: unrecognized report '" << *it << "'"
+                         << endl;
+                    return false;
+                }
+            }
+        }
+        // parse profile file option
+        else if(strcmp(argv[i], "-f") == 0 && i+1 < argc) {
+            opts.profile_file = argv[++i];
+        }
+        // parse peephole rules file option
+        else if(strcmp(argv[i], "-r") == 0 && i+1 < argc) {
+            opts.rules_file = argv[++i];
+        }
+        // parse fixed entry point list option
+        else if(strcmp(argv[i], "-e") == 0 && i+1 < argc) {
+            const vector<string> labels = split_str(argv[++i], ',');
+            opts.entry_labels.insert(opts.entry_labels.end(), labels.begin(),
+                labels.end());
+        }
+        // parse control-flow graph output options
+        else if(strcmp(argv[i], "-g") == 0 && i+1 < argc) {
+            opts.cfg_dot_file = argv[++i];
+        }
+        else if(strcmp(argv[i], "-j") == 0 && i+1 < argc) {
+            opts.cfg_json_file = argv[++i];
+        }
+        // parse data image output option
+        else if(strcmp(argv[i], "-d") == 0 && i+1 < argc) {
+            opts.data_file = argv[++i];
+        }
+        // parse relocatable object option
+        else if(strcmp(argv[i], "-c") == 0) {
+            opts.compile_flag = true;
+        }
+        // parse linked file list option
+        else if(strcmp(argv[i], "-L") == 0 && i+1 < argc) {
+            const vector<string> files = split_str(argv[++i], ',');
+            opts.link_files.insert(opts.link_files.end(), files.begin(),
+                files.end());
+        }
+        // parse symbol definition option (`NAME` or `NAME=value`)
+        else if(strcmp(argv[i], "-D") == 0 && i+1 < argc) {
+            const string def = argv[++i];
+            const string::size_type eq = def.find('=');
+            const string name = str_to_upper(def.substr(0, eq));
+            long long val = 1;
+            if(!regex_match(name, data_label_re) || !is_reserved_name(name)
+                    || (eq != string::npos && !parse_wide_immediate(
+                        str_to_upper(def.substr(eq+1)), val))) {
+                cerr << "Error: invalid symbol definition '" << def
+                     << "', expected 'NAME' or 'NAME=value' with a 16-bit"
+                     << " value"
+                     << endl;
+                return false;
+            }
+            opts.defines[name] = val;
+        }
+        // parse pipeline model option
+        else if(strcmp(argv[i], "-p") == 0 && i+1 < argc) {
+            if(!parse_pipe_model(argv[++i], opts.pipe_model))
+                return false;
+        }
+        // parse relax_flag option and its registers (`Rn` or `Rn,Rm`)
+        else if(strcmp(argv[i], "-b") == 0 && i+1 < argc) {
+            cmatch regs_m;
+            opts.relax_flag = true;
+            if(!regex_match(argv[++i], regs_m, relax_regs_re)
+                    || !encode_register(regs_m[1].str(), opts.relax_reg)
+                    || opts.relax_reg == PC_REG) {
+                cerr << "Error: invalid long branch register(s) '" << argv[i]
+                     << "', expected 'Rn' or 'Rn,Rm' below 'r" << PC_REG << "'"
+                     << endl;
+                return false;
+            }
+            opts.relax_use_scratch = regs_m[2].matched;
+            if(opts.relax_use_scratch
+                    && (!encode_register(regs_m[2].str(),
+                            opts.relax_scratch_reg)
+                        || opts.relax_scratch_reg == PC_REG
+                        || opts.relax_scratch_reg == opts.relax_reg)) {
+                cerr << "Error: invalid long branch scratch register '"
+                     << regs_m[2].str() << "'"
+                     << endl;
+                return false;
+            }
+        }
         else {
             cerr << "Error: unrecognized argument '" << argv[i] << "'"
                  << endl;
@@ -1051,15 +7045,389 @@ bool get_options(int argc, char** argv, prog_opts_s& opts) {
         }
     }
 
+    // error: an object is linked later, not while it's written
+    if(opts.compile_flag && !opts.link_files.empty()) {
+        cerr << "Error: `-c` and `-L` can't be given together" << endl;
+        return false;
+    }
+
+    // error: layout needs a profile to lay out by
+    if(opts.layout_flag != (opts.profile_file != nullptr)) {
+        cerr << "Error: `-O layout` and `-f` must be given together" << endl;
+        return false;
+    }
+
+    // error: peephole rewriting needs rules to rewrite by
+    if(opts.peep_flag != (opts.rules_file != nullptr)) {
+        cerr << "Error: `-O peep` and `-r` must be given together" << endl;
+        return false;
+    }
+
     // signal success
     return true;
 }
 
+// parses a pipeline model option (`key=value,...`)
+bool parse_pipe_model(const string& str, pipe_model_s& model) {
+    const vector<string> fields = split_str(str, ',');
+    for(auto it=fields.begin(); it!=fields.end(); ++it) {
+        const vector<string> kv = split_str(*it, '=');
+        smatch num_m;
+        const bool is_num = kv.size() == 2 && regex_match(kv[1], num_m, udec_re);
+        const unsigned val = is_num ? strtoul(kv[1].c_str(), nullptr, 10) : 0;
+        if(kv.size() == 2 && kv[0] == "stages" && is_num && val >= 2)
+            model.stages = val;
+        else if(kv.size() == 2 && kv[0] == "load" && is_num)
+            model.load_latency = val;
+        else if(kv.size() == 2 && kv[0] == "branch" && is_num)
+            model.branch_penalty = val;
+        else if(kv.size() == 2 && ISA.count(str_to_upper(kv[0])) && is_num) {
+            const vector<OPCODE>& opcs = ISA.at(str_to_upper(kv[0]));
+            for(auto opc=opcs.begin(); opc!=opcs.end(); ++opc)
+                model.cycles[*opc] = val;
+        }
+        else if(kv.size() == 2 && kv[0] == "fwd"
+                && find(FWD_NAMES.begin(), FWD_NAMES.end(), kv[1])
+                    != FWD_NAMES.end()) {
+            model.forwarding = static_cast<FWD_PATHS>(
+                find(FWD_NAMES.begin(), FWD_NAMES.end(), kv[1])
+                    - FWD_NAMES.begin());
+        }
+        else {
+            cerr << "Error: invalid pipeline model field '" << *it
+                 << "', expected one of stages=N (N >= 2), load=N, branch=N,"
+                 << " fwd=none|alu|all or a mnemonic's cycles (e.g. div=8)"
+                 << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// reads a profile file of `address count [taken]` lines
+bool read_profile(ifstream& in, profile_t& profile) {
+    string line_buf;
+    unsigned line_num = 0;
+    while(getline(in, line_buf)) {
+        line_num++;
+        smatch m;
+        string line = line_buf;
+        if(trim_head(line).empty() || line[0] == ';')
+            continue;
+        // error: malformed profile line
+        long long addr = 0;
+        if(!regex_match(line_buf, m, profile_re)
+                || !parse_wide_immediate(m[1].str(), addr)) {
+            cerr << "Error: profile line[" << line_num << "]: "
+                 << "expected 'address count [taken]':"
+                 << endl;
+            line_error_marker(line_buf, 0, line_buf.size());
+            return false;
+        }
+        profile_entry_s& entry = profile[static_cast<mword_t>(addr)];
+        entry.count += strtoull(m[2].str().c_str(), nullptr, 10);
+        if(m[3].matched)
+            entry.taken += strtoull(m[3].str().c_str(), nullptr, 10);
+    }
+    return true;
+}
+
+// reads a rules file of `pattern => replacement : keeps vars` lines
+bool read_rules(ifstream& in, vector<peep_rule_s>& rules) {
+    string line_buf;
+    unsigned line_num = 0;
+    while(getline(in, line_buf)) {
+        line_num++;
+        smatch m;
+        string line = line_buf;
+        if(trim_head(line).empty() || line[0] == ';')
+            continue;
+        peep_rule_s rule = {};
+        rule.line_num = line_num;
+        unsigned n_replaced = 0;
+        // error: malformed rule line
+        if(!regex_match(line_buf, m, rule_re)
+                || !parse_rule_insts(m[1].str(), rule.pattern, rule.n_vars)
+                || !parse_rule_insts(m[2].str(), rule.replacement, n_replaced)
+                || rule.pattern.empty()) {
+            cerr << "Error: rules line[" << line_num << "]: "
+                 << "expected 'pattern => replacement : keeps vars' with "
+                 << "`MOV` and ALU instructions on variables A-G:"
+                 << endl;
+            line_error_marker(line_buf, 0, line_buf.size());
+            return false;
+        }
+        // error: replacement isn't shorter or uses unknown variables
+        if(rule.replacement.size() >= rule.pattern.size()
+                || n_replaced > rule.n_vars) {
+            cerr << "Error: rules line[" << line_num << "]: "
+                 << "replacement must be shorter than its pattern and only "
+                 << "use its variables:"
+                 << endl;
+            line_error_marker(line_buf, m.position(2), m[2].length());
+            return false;
+        }
+        const vector<string> keeps = split_str(m[3].str(), ',');
+        for(auto it=keeps.begin(); it!=keeps.end(); ++it) {
+            string var = *it;
+            trim_head(trim_tail(var));
+            const unsigned v = toupper(var[0]) - 'A';
+            // error: kept variable isn't one of the pattern
+            if(!regex_match(var, rule_var_re) || v >= rule.n_vars) {
+                cerr << "Error: rules line[" << line_num << "]: "
+                     << "invalid kept variable '" << var << "':"
+                     << endl;
+                line_error_marker(line_buf, m.position(3), m[3].length());
+                return false;
+            }
+            rule.keeps |= 1u<<v;
+        }
+
+        // note what either side writes
+        for(unsigned side=0; side<2; side++) {
+            const vector<peep_inst_s>& insts = side == 0 ? rule.pattern
+                : rule.replacement;
+            for(auto it=insts.begin(); it!=insts.end(); ++it) {
+                if(it->opcode != CMP)
+                    rule.writes |= 1u<<it->vars[0];
+                rule.flags |= it->opcode >= ADD && it->opcode <= CMP;
+            }
+        }
+        rules.push_back(rule);
+    }
+    return true;
+}
+
+// parses the `|` separated instructions of a rule, counting its variables
+bool parse_rule_insts(const string& str, vector<peep_inst_s>& insts,
+        unsigned& n_vars) {
+    const vector<string> lines = split_str(str, '|');
+    for(auto it=lines.begin(); it!=lines.end(); ++it) {
+        string line = *it;
+        smatch m;
+        if(trim_head(trim_tail(line)).empty() && lines.size() == 1)
+            break;
+        if(!regex_match(line, m, rule_inst_re))
+            return false;
+        const string mne = str_to_upper(m[1].str());
+        const inst_tokens_t oprs = split_operands(m[2].str(), false);
+        if(ISA.count(mne) == 0)
+            return false;
+
+        // pick the `MOV` or ALU opcode whose operands fit
+        const vector<OPCODE>& opcodes = ISA.at(mne);
+        bool found = false;
+        for(auto ot=opcodes.begin(); !found && ot!=opcodes.end(); ++ot) {
+            const fmt_config_t& fmt_config = FMT_CONFIG[OPC_TO_FMT.at(*ot)];
+            if((*ot != MOVRR && *ot != MOVIM && (*ot < ADD || *ot > CMP))
+                    || oprs.size() != fmt_config.size())
+                continue;
+            peep_inst_s inst = { *ot, { 0, 0, 0 }, 0 };
+            found = true;
+            for(unsigned o=0; found && o<oprs.size(); o++) {
+                if(fmt_config[o].second == IMM)
+                    found = parse_immediate(str_to_upper(oprs[o]), inst.imm);
+                else if(regex_match(oprs[o], rule_var_re)) {
+                    inst.vars[o] = toupper(oprs[o][0]) - 'A';
+                    n_vars = max(n_vars, inst.vars[o]+1);
+                }
+                else
+                    found = false;
+            }
+            if(found)
+                insts.push_back(inst);
+        }
+        if(!found)
+            return false;
+    }
+    return true;
+}
+
+// unmaps the files mapped by `.incbin`
+void unmap_data(prog_s& prog) {
+    for(auto it=prog.data.begin(); it!=prog.data.end(); ++it) {
+        if(it->bytes != nullptr)
+            munmap(const_cast<uint8_t*>(it->bytes), it->n_bytes);
+        it->bytes = nullptr;
+    }
+}
+
+// points the arrays of `obj` into its bytes, checking that they fit
+bool view_object(obj_file_s& obj, const char* bytes, size_t size) {
+    if(size < sizeof(obj_header_s))
+        return false;
+    const obj_header_s* hdr = reinterpret_cast<const obj_header_s*>(bytes);
+    if(memcmp(hdr->magic, OBJ_MAGIC, sizeof(hdr->magic)) != 0
+            || hdr->version != OBJ_VERSION || hdr->n_words > MAX_INST)
+        return false;
+    auto padded = [](uint64_t n) { return (n + 3) & ~3ULL; };
+    const uint64_t off_words = padded(sizeof(obj_header_s));
+    const uint64_t off_syms = off_words
+        + padded(uint64_t(hdr->n_words)*sizeof(mword_t));
+    const uint64_t off_relocs = off_syms
+        + uint64_t(hdr->n_syms)*sizeof(obj_sym_s);
+    const uint64_t off_lines = off_relocs
+        + uint64_t(hdr->n_relocs)*sizeof(obj_reloc_s);
+    const uint64_t off_strs = off_lines
+        + uint64_t(hdr->n_words)*sizeof(obj_line_s);
+    if(off_strs + padded(hdr->str_size) != size || hdr->str_size == 0
+            || bytes[off_strs + hdr->str_size - 1] != '\0')
+        return false;
+    obj.hdr = hdr;
+    obj.words = reinterpret_cast<const mword_t*>(bytes + off_words);
+    obj.syms = reinterpret_cast<const obj_sym_s*>(bytes + off_syms);
+    obj.relocs = reinterpret_cast<const obj_reloc_s*>(bytes + off_relocs);
+    obj.lines = reinterpret_cast<const obj_line_s*>(bytes + off_lines);
+    obj.strs = bytes + off_strs;
+    for(unsigned s=0; s<hdr->n_syms; s++) {
+        if(obj.syms[s].name >= hdr->str_size)
+            return false;
+    }
+    for(unsigned r=0; r<hdr->n_relocs; r++) {
+        if(obj.relocs[r].index >= hdr->n_words
+                || obj.relocs[r].sym >= hdr->n_syms
+                || obj.syms[obj.relocs[r].sym].bind != SYM_EXTERN)
+            return false;
+    }
+    return true;
+}
+
+// unmaps an object mapped by `map_object`
+void unmap_object(obj_file_s& obj) {
+    if(obj.mapped != nullptr)
+        munmap(const_cast<char*>(obj.mapped), obj.size);
+    obj.mapped = nullptr;
+    obj.hdr = nullptr;
+}
+
+// names the object a source file given to `-L` is assembled into
+string object_path(const string& src_file) {
+    const string::size_type dot = src_file.rfind('.');
+    if(dot != string::npos && dot+2 == src_file.size()
+            && toupper(src_file[dot+1]) == 'S')
+        return src_file.substr(0, dot) + ".o";
+    return src_file + ".o";
+}
+
+// checks if a path names an object file (`.o`)
+bool is_object_path(const string& path) {
+    return path.size() > 2 && path.compare(path.size()-2, 2, ".o") == 0;
+}
+
+// hashes the options that change the code assembled for `-L` sources, with
+//   the size and modification time of the `-r` rules file
+uint64_t options_hash(const prog_opts_s& opts) {
+    stringstream key;
+    key << opts.strict_flag << opts.sched_flag << opts.dead_flag
+        << opts.clc_flag << opts.layout_flag << opts.const_flag
+        << opts.relax_flag << ' '
+        << opts.relax_reg << ',' << opts.relax_use_scratch << ','
+        << opts.relax_scratch_reg << ' ' << opts.pipe_model.stages << ','
+        << opts.pipe_model.forwarding << ',' << opts.pipe_model.load_latency
+        << ',' << opts.pipe_model.branch_penalty;
+    for(auto it=opts.pipe_model.cycles.begin();
+            it!=opts.pipe_model.cycles.end(); ++it)
+        key << ',' << it->first << '=' << it->second;
+    key << ' ' << (opts.profile_file != nullptr ? opts.profile_file : "");
+    key << ' ' << opts.peep_flag
+        << (opts.rules_file != nullptr ? opts.rules_file : "");
+    // edited rules change the code like options do
+    struct stat st;
+    if(opts.rules_file != nullptr && stat(opts.rules_file, &st) == 0)
+        key << ',' << st.st_size << ',' << mtime_ns(st);
+    for(auto it=opts.entry_labels.begin(); it!=opts.entry_labels.end(); ++it)
+        key << ',' << *it;
+    for(auto it=opts.defines.begin(); it!=opts.defines.end(); ++it)
+        key << ' ' << it->first << '=' << it->second;
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    const string str = key.str();
+    for(auto it=str.begin(); it!=str.end(); ++it) {
+        hash ^= static_cast<uint8_t>(*it);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// reads the modification time of a stat'd file in nanoseconds
+int64_t mtime_ns(const struct stat& st) {
+    return st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+// formats the file and line of an object word, with its macro body line
+string object_line_ref(const obj_file_s& obj, unsigned i) {
+    return "'" + string(obj.strs) + "' line[" + to_string(obj.lines[i].line)
+        + (obj.lines[i].macro_line == 0 ? ""
+            : ", macro line " + to_string(obj.lines[i].macro_line))
+        + "]";
+}
+
+// splits a string on a delimiter
+vector<string> split_str(const string& str, char delim) {
+    vector<string> parts;
+    stringstream ss(str);
+    string part;
+    while(getline(ss, part, delim))
+        parts.push_back(part);
+    return parts;
+}
+
+// splits operands on commas (or spaces unless parsing strictly)
+vector<string> split_operands(const string& oprs, bool strict_parsing) {
+    vector<string> toks;
+    if(oprs.empty())
+        return toks;
+    const vector<string> parts = split_str(oprs, ',');
+    for(auto it=parts.begin(); it!=parts.end(); ++it) {
+        string part = *it;
+        trim_head(trim_tail(part));
+        vector<string> words = strict_parsing ? vector<string>(1, part)
+            : split_str(part, ' ');
+        for(auto jt=words.begin(); jt!=words.end(); ++jt) {
+            if(!jt->empty() || strict_parsing)
+                toks.push_back(*jt);
+        }
+    }
+    return toks;
+}
+
 // prints the help message upon failure to run
 void print_help() {
-    cerr << "USAGE:  alarmas <source file> <object file> [-l] [-s]" << endl
+    cerr << "USAGE:  alarmas <source file> <object file> [-l] [-s] [-b Rn[,Rm]]"
+         << endl
+         << "                [-O passes] [-R reports] [-p model]"
+         << " [-f profile] [-e labels]" << endl
+         << "                [-g dot_file] [-j json_file] [-d data_file]"
+         << " [-c] [-L files]" << endl
+         << "                [-r rules] [-D name[=value]]" << endl
+         << "        alarmas -i [object file] [-s]" << endl
+         << "        -i : assemble lines as they are typed, `:help` lists"
+         << " commands" << endl
          << "        -l : print listing to standard error" << endl
-         << "        -s : strict parsing forces correct syntax" << endl;
+         << "        -s : strict parsing forces correct syntax" << endl
+         << "        -b : relax out-of-range branches into long branches"
+         << " through Rn (and scratch Rm)" << endl
+         << "        -O : comma-separated optimization passes (sched, layout,"
+         << " dead, clc, peep," << endl
+         << "             const)" << endl
+         << "        -R : comma-separated reports to standard error"
+         << " (hazards, cfg, dead, carry)" << endl
+         << "        -p : pipeline model for sched/hazards/cfg/const, e.g."
+         << " stages=5,fwd=all,load=1,branch=2,div=8" << endl
+         << "        -f : execution profile for layout, 'address count [taken]'"
+         << " lines" << endl
+         << "        -e : comma-separated labels layout keeps in place" << endl
+         << "        -r : peephole rules for peep, as written by superopt"
+         << endl
+         << "        -g : write the control-flow graph as Graphviz" << endl
+         << "        -j : write the control-flow graph as JSON" << endl
+         << "        -d : write the data memory image to data_file"
+         << " (default <object file>.data)" << endl
+         << "        -c : write a relocatable object instead of an image" << endl
+         << "        -L : comma-separated objects or sources to link after"
+         << " the source file" << endl
+         << "        -D : define a symbol for `.if` and operands (default 1),"
+         << " may be repeated" << endl;
 }
 
 // converts a string to uppercase
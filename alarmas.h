@@ -0,0 +1,620 @@
+/* ************************************************************************* *
+ * File: alarmas.h
+ *  alARM ISA tables shared with `alarmas.cpp`, and a header-only assembler
+ *  that encodes alARM programs embedded in C++ source while it compiles
+ * ------------------------------------------------------------------------- *
+ * Usage (C++14):
+ *   constexpr auto img = ALARMAS_ASSEMBLE(
+ *       "       MOV  r1, 5       \n"
+ *       "loop:  SUB  r1, r1, r2  \n"
+ *       "       BNE  loop        \n"
+ *       "       HALT             \n");
+ *   static_assert(img[3] == 0x0600, "");
+ *  `img` is a `std::array<uint16_t, 4>` built during compilation. Code that
+ *  doesn't assemble fails the build at the `throw` naming the problem.
+ * ************************************************************************* */
+
+#ifndef ALARMAS_H
+#define ALARMAS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+namespace alarmas {
+
+
+/* ========================================================================= *
+ * Opcode and Bitmask Enums
+ * ========================================================================= */
+enum OPCODE : uint16_t {
+    NOP  =0b0000000<<9,
+    HALT =0b0000011<<9,
+    MOVRR=0b0000100<<9,
+    MOVRF=0b0000110<<9,
+    MOVFR=0b0000111<<9,
+    LDRO =0b0001000<<9,
+    LDR  =0b0001011<<9,
+    STRO =0b0001100<<9,
+    STR  =0b0001111<<9,
+
+    ADD  =0b0010000<<9,
+    SUB  =0b0010001<<9,
+    MUL  =0b0010010<<9,
+    MULU =0b0010011<<9,
+    DIV  =0b0010100<<9,
+    MOD  =0b0010101<<9,
+    AND  =0b0010110<<9,
+    OR   =0b0010111<<9,
+    EOR  =0b0011000<<9,
+    NOT  =0b0011001<<9,
+    LSL  =0b0011010<<9,
+    LSR  =0b0011011<<9,
+    ASR  =0b0011100<<9,
+    ROL  =0b0011101<<9,
+    ROR  =0b0011110<<9,
+    CMP  =0b0011111<<9,
+
+    B    =0b0100000<<9,
+    BEQ  =0b0110000<<9,
+    BNE  =0b0111000<<9,
+    MOVIM=0b1000000<<9,
+};
+
+enum I_FMT {
+    S_TYPE=0,
+    R1_TYPE,
+    R2_TYPE,
+    R2NW_TYPE,
+    R3_TYPE,
+    B_TYPE,
+    I_TYPE,
+    FL_TYPE,
+    FS_TYPE,
+    LS_TYPE,
+    LSO_TYPE,
+    FMT_LEN
+};
+
+enum OPR_WIDTH {
+    NON=0,
+    REG=3,
+    IMM=12
+};
+
+
+/* ========================================================================= *
+ * ISA Config Definition
+ * ========================================================================= */
+// operand field of an instruction format, `pos` is its lowest bit
+struct opr_field_s {
+    uint8_t     pos;
+    OPR_WIDTH   width;
+};
+
+// operand fields of an instruction format, in source order
+struct fmt_fields_s {
+    unsigned    n_oprs;
+    opr_field_s oprs[3];
+};
+
+// format of an opcode
+struct opc_fmt_s {
+    OPCODE      opcode;
+    I_FMT       fmt;
+};
+
+// opcodes of a mnemonic, in the order their formats are tried
+struct mnemonic_s {
+    const char* name;
+    unsigned    n_opcodes;
+    OPCODE      opcodes[4];
+};
+
+constexpr fmt_fields_s FMT_FIELDS[FMT_LEN] = {
+    { 0, { } },                                     // S-Type
+    { 1, { {1*REG,REG} } },                         // R1-Type
+    { 2, { {1*REG,REG}, {2*REG,REG} } },            // R2-Type
+    { 2, { {2*REG,REG}, {0,REG} } },                // R2NW-Type
+    { 3, { {1*REG,REG}, {2*REG,REG}, {0,REG} } },   // R3-Type
+    { 1, { {0,IMM} } },                             // B-Type
+    { 2, { {1*IMM,REG}, {0,IMM} } },                // I-Type
+    { 2, { {1*REG,REG}, {0,NON} } },                // FL-Type
+    { 2, { {0,NON},     {2*REG,REG} } },            // FS-Type
+    { 2, { {1*REG,REG}, {2*REG,REG} } },            // LS-Type
+    { 3, { {1*REG,REG}, {2*REG,REG}, {0,REG} } },   // LSO-Type
+};
+
+constexpr opc_fmt_s OPC_FMTS[] = {
+    { NOP,  S_TYPE },
+    { HALT, S_TYPE },
+    { MOVRR, R2_TYPE },
+    { MOVIM, I_TYPE },
+    { MOVRF, FL_TYPE },
+    { MOVFR, FS_TYPE },
+    { LDR,  LS_TYPE },
+    { LDRO, LSO_TYPE },
+    { STR,  LS_TYPE },
+    { STRO, LSO_TYPE },
+    { ADD,  R3_TYPE },
+    { SUB,  R3_TYPE },
+    { MUL,  R3_TYPE },
+    { MULU, R3_TYPE },
+    { DIV,  R3_TYPE },
+    { MOD,  R3_TYPE },
+    { AND,  R3_TYPE },
+    { OR,   R3_TYPE },
+    { EOR,  R3_TYPE },
+    { NOT,  R2_TYPE },
+    { LSL,  R3_TYPE },
+    { LSR,  R3_TYPE },
+    { ASR,  R3_TYPE },
+    { ROL,  R3_TYPE },
+    { ROR,  R3_TYPE },
+    { CMP,  R2NW_TYPE },
+    { B,    B_TYPE },
+    { BEQ,  B_TYPE },
+    { BNE,  B_TYPE },
+};
+
+constexpr mnemonic_s MNEMONICS[] = {
+    { "NOP",    1, { NOP } },
+    { "HALT",   1, { HALT } },
+    { "MOV",    4, { MOVRR, MOVRF, MOVFR, MOVIM } },
+    { "LDR",    2, { LDR, LDRO } },
+    { "STR",    2, { STR, STRO } },
+    { "ADD",    1, { ADD } },
+    { "SUB",    1, { SUB } },
+    { "MUL",    1, { MUL } },
+    { "MULU",   1, { MULU } },
+    { "DIV",    1, { DIV } },
+    { "MOD",    1, { MOD } },
+    { "AND",    1, { AND } },
+    { "OR",     1, { OR } },
+    { "EOR",    1, { EOR } },
+    { "NOT",    1, { NOT } },
+    { "LSL",    1, { LSL } },
+    { "LSR",    1, { LSR } },
+    { "ASR",    1, { ASR } },
+    { "ROL",    1, { ROL } },
+    { "ROR",    1, { ROR } },
+    { "CMP",    1, { CMP } },
+    { "B",      1, { B } },
+    { "BEQ",    1, { BEQ } },
+    { "BNE",    1, { BNE } },
+};
+
+// looks up the format of an opcode
+constexpr I_FMT opcode_format(OPCODE opc) {
+    for(const opc_fmt_s& it : OPC_FMTS) {
+        if(it.opcode == opc)
+            return it.fmt;
+    }
+    throw std::invalid_argument("alarmas: opcode without a format");
+}
+
+
+/* ========================================================================= *
+ * Compile-time Assembler
+ * ------------------------------------------------------------------------- *
+ *  Accepts the relaxed syntax of `alarmas.cpp` (labels, `;` comments, case
+ *  insensitive mnemonics and registers, decimal/hex/binary immediates and
+ *  `CLC`), without directives, macros or `LDI`. Each word is encoded by
+ *  scanning the source, so it's meant for the short programs of test
+ *  benches and fixtures.
+ * ========================================================================= */
+namespace detail {
+
+const long long IMM_MAX = (1<<(IMM-1))-1;
+const long long IMM_MIN = -(1LL<<(IMM-1));
+const unsigned MAX_INST = 65536;
+const unsigned MAX_REG = 7;
+
+// span of source text, `end` excluded
+struct span_s {
+    const char* begin;
+    const char* end;
+};
+
+// line of source split into its labels, mnemonic and operands
+struct line_s {
+    span_s      labels;
+    span_s      mne;
+    span_s      oprs;
+    const char* next;
+};
+
+// up to three operand tokens
+struct oprs_s {
+    span_s      toks[3];
+    unsigned    n;
+};
+
+// parsed immediate value
+struct num_s {
+    bool        ok;
+    long long   val;
+};
+
+constexpr char upper(char c) {
+    return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+}
+
+constexpr bool is_word(char c) {
+    return (c >= '0' && c <= '9') || (upper(c) >= 'A' && upper(c) <= 'Z')
+        || c == '_';
+}
+
+constexpr bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+constexpr bool is_sep(char c) {
+    return is_blank(c) || c == ',' || c == '[' || c == ']';
+}
+
+// compares a span to a string, ignoring case
+constexpr bool equals(span_s s, const char* str) {
+    for(const char* p=s.begin; p!=s.end; ++p, ++str) {
+        if(*str == '\0' || upper(*p) != upper(*str))
+            return false;
+    }
+    return *str == '\0';
+}
+
+// compares two spans, ignoring case
+constexpr bool equals(span_s a, span_s b) {
+    if(a.end - a.begin != b.end - b.begin)
+        return false;
+    for(const char *p=a.begin, *q=b.begin; p!=a.end; ++p, ++q) {
+        if(upper(*p) != upper(*q))
+            return false;
+    }
+    return true;
+}
+
+constexpr const char* skip_blanks(const char* p, const char* end) {
+    while(p != end && is_blank(*p))
+        ++p;
+    return p;
+}
+
+// splits the line starting at `p` into labels, mnemonic and operands
+constexpr line_s split_line(const char* p) {
+    const char* end = p;
+    while(*end != '\0' && *end != '\n')
+        ++end;
+    const char* code = p;
+    while(code != end && *code != ';')
+        ++code;
+    while(code != p && is_blank(code[-1]))
+        --code;
+
+    line_s line = {};
+    line.next = *end == '\n' ? end+1 : nullptr;
+    const char* q = skip_blanks(p, code);
+    line.labels = { q, q };
+    while(true) {
+        const char* w = q;
+        while(w != code && is_word(*w))
+            ++w;
+        if(w == code || *w != ':')
+            break;
+        q = skip_blanks(w+1, code);
+        line.labels.end = w+1;
+    }
+    const char* w = q;
+    while(w != code && is_word(*w))
+        ++w;
+    line.mne = { q, w };
+    line.oprs = { skip_blanks(w, code), code };
+    return line;
+}
+
+// finds the next label of a label span, advancing `p` past it
+constexpr span_s next_label(const char*& p, const char* end) {
+    p = skip_blanks(p, end);
+    const char* w = p;
+    while(w != end && *w != ':')
+        ++w;
+    const span_s label = { p, w };
+    p = w != end ? w+1 : w;
+    return label;
+}
+
+// splits operands on commas, spaces and brackets
+constexpr oprs_s split_oprs(span_s oprs) {
+    oprs_s res = {};
+    const char* p = oprs.begin;
+    while(p != oprs.end) {
+        while(p != oprs.end && is_sep(*p))
+            ++p;
+        if(p == oprs.end)
+            break;
+        const char* w = p;
+        while(w != oprs.end && !is_sep(*w))
+            ++w;
+        if(res.n == 3)
+            throw std::invalid_argument("alarmas: more than 3 operands");
+        res.toks[res.n++] = { p, w };
+        p = w;
+    }
+    return res;
+}
+
+// checks for a register token (`R` and digits)
+constexpr bool is_register(span_s tok) {
+    if(tok.end - tok.begin < 2 || upper(*tok.begin) != 'R')
+        return false;
+    for(const char* p=tok.begin+1; p!=tok.end; ++p) {
+        if(*p < '0' || *p > '9')
+            return false;
+    }
+    return true;
+}
+
+constexpr uint16_t encode_register(span_s tok) {
+    unsigned reg = 0;
+    for(const char* p=tok.begin+1; p!=tok.end; ++p) {
+        reg = reg*10 + (*p - '0');
+        if(reg > MAX_REG)
+            throw std::invalid_argument("alarmas: register above r7");
+    }
+    return reg;
+}
+
+// parses a decimal, hex (3 nibbles) or binary (12 bits) immediate, where
+//   hex and binary values are sign-extended from 12 bits
+constexpr num_s parse_immediate(span_s tok) {
+    const char* p = tok.begin;
+    const bool neg = p != tok.end && *p == '-';
+    if(neg)
+        ++p;
+    unsigned base = 10;
+    if(!neg && tok.end - p > 2 && *p == '0'
+            && (upper(p[1]) == 'X' || upper(p[1]) == 'B')) {
+        base = upper(p[1]) == 'X' ? 16 : 2;
+        p += 2;
+    }
+    if(p == tok.end)
+        return { false, 0 };
+    long long val = 0;
+    unsigned n_digits = 0;
+    for(; p!=tok.end; ++p, ++n_digits) {
+        const char c = upper(*p);
+        const int digit = c >= '0' && c <= '9' ? c - '0'
+            : c >= 'A' && c <= 'F' ? c - 'A' + 10 : 99;
+        if(digit >= static_cast<int>(base))
+            return { false, 0 };
+        val = val*base + digit;
+        if(val > (1LL<<32))
+            throw std::invalid_argument("alarmas: immediate out of range");
+    }
+    if(base != 10) {
+        if(n_digits > (base == 16 ? (IMM+3)/4 : IMM))
+            throw std::invalid_argument("alarmas: immediate too wide");
+        if(val & (1LL<<(IMM-1)))
+            val -= 1LL<<IMM;
+    }
+    return { true, neg ? -val : val };
+}
+
+// finds the address of a label, or -1
+constexpr long long label_address(const char* src, span_s name) {
+    unsigned address = 0;
+    for(const char* p=src; p!=nullptr; ) {
+        const line_s line = split_line(p);
+        for(const char* l=line.labels.begin; l!=line.labels.end; ) {
+            if(equals(next_label(l, line.labels.end), name))
+                return address;
+        }
+        if(line.mne.begin != line.mne.end)
+            address++;
+        p = line.next;
+    }
+    return -1;
+}
+
+// checks that operand tokens fit the fields of a format
+constexpr bool fits_format(I_FMT fmt, const oprs_s& oprs) {
+    const fmt_fields_s& fields = FMT_FIELDS[fmt];
+    if(oprs.n != fields.n_oprs)
+        return false;
+    for(unsigned o=0; o<oprs.n; o++) {
+        const bool is_flags = equals(oprs.toks[o], "FLAGS");
+        const bool is_reg = is_register(oprs.toks[o]);
+        if((fields.oprs[o].width == REG && !is_reg)
+                || (fields.oprs[o].width == NON && !is_flags)
+                || (fields.oprs[o].width == IMM && (is_reg || is_flags)))
+            return false;
+    }
+    return true;
+}
+
+// encodes the instruction of a line placed at `address`
+constexpr uint16_t encode_line(const char* src, const line_s& line,
+        unsigned address) {
+    // error: line content with no mnemonic
+    if(line.mne.begin == line.mne.end)
+        throw std::invalid_argument("alarmas: no mnemonic (or directive)");
+    // `CLC` is `AND R0, R0, R0`
+    if(equals(line.mne, "CLC")) {
+        if(line.oprs.begin != line.oprs.end)
+            throw std::invalid_argument("alarmas: CLC takes no operands");
+        return AND;
+    }
+
+    // pick the first opcode of the mnemonic whose format fits
+    // ---------------------------------------------------------------------
+    const mnemonic_s* mne = nullptr;
+    for(const mnemonic_s& it : MNEMONICS) {
+        if(equals(line.mne, it.name))
+            mne = &it;
+    }
+    if(mne == nullptr)
+        throw std::invalid_argument("alarmas: invalid mnemonic (or LDI)");
+    const oprs_s oprs = split_oprs(line.oprs);
+    unsigned k = 0;
+    while(k < mne->n_opcodes && !fits_format(
+            opcode_format(mne->opcodes[k]), oprs))
+        k++;
+    if(k == mne->n_opcodes)
+        throw std::invalid_argument("alarmas: operands don't fit mnemonic");
+    const OPCODE opc = mne->opcodes[k];
+    const I_FMT fmt = opcode_format(opc);
+
+    // encode operands into their fields
+    // ---------------------------------------------------------------------
+    uint16_t word = opc;
+    for(unsigned o=0; o<oprs.n; o++) {
+        const opr_field_s& field = FMT_FIELDS[fmt].oprs[o];
+        long long val = 0;
+        if(field.width == REG)
+            val = encode_register(oprs.toks[o]);
+        else if(field.width == IMM) {
+            const num_s num = parse_immediate(oprs.toks[o]);
+            const long long target = fmt == B_TYPE && !num.ok
+                ? label_address(src, oprs.toks[o]) : -1;
+            if(!num.ok && fmt == B_TYPE && target < 0)
+                throw std::invalid_argument("alarmas: unknown branch label");
+            if(!num.ok && fmt != B_TYPE)
+                throw std::invalid_argument("alarmas: expected immediate");
+            val = num.ok ? num.val : target - (address + 1LL);
+            if(num.ok && (val < IMM_MIN || val > IMM_MAX))
+                throw std::invalid_argument("alarmas: immediate out of range");
+            if(val < IMM_MIN || val > IMM_MAX)
+                throw std::invalid_argument("alarmas: branch out of range");
+        }
+        word |= (static_cast<uint16_t>(val) & ~(~0u<<field.width))
+            << field.pos;
+    }
+    return word;
+}
+
+// checks labels and every instruction, returning the instruction count
+constexpr unsigned check_program(const char* src) {
+    unsigned address = 0;
+    for(const char* p=src; p!=nullptr; ) {
+        const line_s line = split_line(p);
+        for(const char* l=line.labels.begin; l!=line.labels.end; ) {
+            const span_s label = next_label(l, line.labels.end);
+            bool reserved = label.begin == label.end || is_register(label)
+                || equals(label, "FLAGS") || equals(label, "LDI")
+                || (*label.begin >= '0' && *label.begin <= '9');
+            for(const mnemonic_s& it : MNEMONICS)
+                reserved = reserved || equals(label, it.name);
+            if(reserved)
+                throw std::invalid_argument("alarmas: invalid label name");
+            if(label_address(src, label) != address)
+                throw std::invalid_argument("alarmas: repeat label");
+        }
+        if(line.mne.begin != line.mne.end || line.oprs.begin != line.oprs.end)
+            encode_line(src, line, address++);
+        if(address > MAX_INST)
+            throw std::invalid_argument("alarmas: too many instructions");
+        p = line.next;
+    }
+    return address;
+}
+
+// encodes the `i`th instruction of a program
+constexpr uint16_t encode_word(const char* src, unsigned i) {
+    unsigned address = 0;
+    for(const char* p=src; p!=nullptr; ) {
+        const line_s line = split_line(p);
+        if(line.mne.begin != line.mne.end && address++ == i)
+            return encode_line(src, line, i);
+        p = line.next;
+    }
+    throw std::invalid_argument("alarmas: image size doesn't match");
+}
+
+template<std::size_t... I>
+constexpr std::array<uint16_t, sizeof...(I)> encode_words(const char* src,
+        std::index_sequence<I...>) {
+    return {{ encode_word(src, I)... }};
+}
+
+} // namespace detail
+
+// counts the instructions of a program, the size of its image
+constexpr unsigned count_insts(const char* src) {
+    unsigned n = 0;
+    for(const char* p=src; p!=nullptr; ) {
+        const detail::line_s line = detail::split_line(p);
+        if(line.mne.begin != line.mne.end || line.oprs.begin != line.oprs.end)
+            n++;
+        p = line.next;
+    }
+    return n;
+}
+
+// assembles a program of `N` instructions into its image
+template<std::size_t N>
+constexpr std::array<uint16_t, N> assemble(const char* src) {
+    if(detail::check_program(src) != N)
+        throw std::invalid_argument("alarmas: image size doesn't match");
+    return detail::encode_words(src, std::make_index_sequence<N>());
+}
+
+
+
+/* ========================================================================= *
+ * ALU Semantics
+ * ========================================================================= */
+// computes an ALU operation on register values, false if undefined
+constexpr bool alu_eval(OPCODE opc, uint16_t n, uint16_t m, bool carry,
+        uint16_t& res) {
+    const unsigned s = m & 0xF;
+    const int16_t sn = static_cast<int16_t>(n);
+    const int16_t sm = static_cast<int16_t>(m);
+    switch(opc) {
+        case ADD:   res = n + m + carry;                            break;
+        case SUB:   res = n - m - carry;                            break;
+        case MUL:   res = static_cast<uint32_t>(n) * m;             break;
+        case MULU:  res = (static_cast<int32_t>(sn) * sm) >> 16;    break;
+        case DIV:
+        case MOD:
+            // division by zero and overflow have no defined result
+            if(sm == 0 || (sn == INT16_MIN && sm == -1))
+                return false;
+            res = opc == DIV ? sn / sm : sn % sm;
+            break;
+        case AND:   res = n & m;                                    break;
+        case OR:    res = n | m;                                    break;
+        case EOR:   res = n ^ m;                                    break;
+        case NOT:   res = ~n;                                       break;
+        case LSL:   res = n << s;                                   break;
+        case LSR:   res = n >> s;                                   break;
+        case ASR:   res = sn >> s;                                  break;
+        case ROL:   res = (n << s) | (n >> (16-s));                 break;
+        case ROR:   res = (n >> s) | (n << (16-s));                 break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+// checks if the carry an ALU operation leaves is known, only `ADD`, `SUB`,
+//   `CMP` and `AND` (`CLC`) are documented to set it
+constexpr bool alu_carry_known(OPCODE opc) {
+    return opc == ADD || opc == SUB || opc == CMP || opc == AND;
+}
+
+// computes the carry an ALU operation leaves when it's known, `ADD` carries
+//   out, `SUB` and `CMP` borrow, and `AND` clears it
+constexpr bool alu_carry(OPCODE opc, uint16_t n, uint16_t m, bool carry) {
+    return opc == ADD ? (static_cast<uint32_t>(n) + m + carry) >> 16
+        : opc == SUB ? n < static_cast<uint32_t>(m) + carry
+        : opc == CMP ? n < m : false;
+}
+
+} // namespace alarmas
+
+// assembles a string literal (or constexpr string) sized by its contents
+#define ALARMAS_ASSEMBLE(src) \
+    ::alarmas::assemble< ::alarmas::count_insts(src)>(src)
+
+#endif // ALARMAS_H
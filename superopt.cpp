@@ -0,0 +1,860 @@
+/* ************************************************************************* *
+ * File: superopt.cpp
+ *  Brute-force superoptimizer that searches every shorter sequence of alARM
+ *  `MOV` and ALU instructions for each target sequence, and writes the ones
+ *  it proves equivalent into a rules file for `alarmas -O peep -r <file>`
+ * ------------------------------------------------------------------------- *
+ * Targets are blocks of instructions separated by blank lines, optionally
+ *  with a `; keeps r1, r2` comment naming the registers whose values must
+ *  match afterwards (default: every register the block writes). Flags are
+ *  never kept, `alarmas` only applies a rule where they are dead.
+ * ************************************************************************* */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <regex>
+#include <cstdint>
+#include "alarmas.h"
+
+using namespace std;
+using namespace alarmas;
+
+
+/* ========================================================================= *
+ * Static Constant Definitions
+ * ========================================================================= */
+// registers `R0` to `R6` can be searched over, the PC can't
+const unsigned MAX_VARS = 7;
+const unsigned DEFAULT_MAX_LEN = 3;
+const unsigned DEFAULT_VECTORS = 32;
+const unsigned DEFAULT_MAX_BITS = 33;
+// immediates tried besides the ones of the target, along with the powers
+//   of two and the masks below them that fit the field
+const int SMALL_IMM_MIN = -1;
+const int SMALL_IMM_MAX = 16;
+// corner values placed in the first test vectors
+const uint16_t CORNER_VALS[] = { 0, 1, 0xFFFF, 0x8000, 0x7FFF };
+
+
+/* ========================================================================= *
+ * Struct definitions
+ * ========================================================================= */
+// instruction over the register variables of a sequence (`A`, `B`, ...)
+struct seq_inst_s {
+    OPCODE      opcode;
+    uint8_t     rd;
+    uint8_t     rn;
+    uint8_t     rm;
+    int16_t     imm;
+};
+
+typedef vector<seq_inst_s> seq_t;
+
+// registers (by variable) and carry a sequence runs on, `ok` is cleared by
+//   results with no defined value
+struct state_s {
+    uint16_t    regs[MAX_VARS];
+    bool        carry;
+    // left by an operation whose carry isn't known (see `alu_carry_known`)
+    bool        carry_unknown;
+    bool        ok;
+};
+
+// target sequence read from the target file
+struct target_s {
+    seq_t           seq;
+    unsigned        n_vars;
+    unsigned        keeps;
+    vector<string>  regs;
+    unsigned        line_num;
+};
+
+// instructions of a candidate, by index into the searched alphabet
+typedef vector<unsigned> cand_t;
+
+struct search_opts_s {
+    char*       target_file = nullptr;
+    char*       rules_file  = nullptr;
+    unsigned    max_len     = DEFAULT_MAX_LEN;
+    unsigned    n_vectors   = DEFAULT_VECTORS;
+    unsigned    max_bits    = DEFAULT_MAX_BITS;
+    unsigned    n_threads   = 0;
+    // searches `MUL`, `MULU`, `DIV` and `MOD` too (`-m`)
+    bool        muldiv      = false;
+};
+
+
+/* ========================================================================= *
+ * Regular Expression Definitions
+ * ========================================================================= */
+const regex keeps_re("^\\s*;\\s*keeps\\s+(.*)$", regex::icase);
+
+
+/* ========================================================================= *
+ * Function Declarations
+ * ========================================================================= */
+/* ------------------------------------------------------------------------- *
+ * read_targets
+ * - Reads the target sequences of `in`, one block of lines each, using the
+ *     parser of `alarmas.h` for every instruction.
+ * - Registers are renamed to variables in the order they appear, so a rule
+ *     found for `r3` and `r5` applies to any pair of registers.
+ * - Returns true upon succesful completion, filling `targets`.
+ * - Returns false if a line doesn't assemble, or uses instructions other
+ *     than `MOV` and ALU operations, the flags or the PC.
+ * ------------------------------------------------------------------------- */
+bool read_targets(ifstream& in, vector<target_s>& targets);
+
+/* ------------------------------------------------------------------------- *
+ * superoptimize
+ * - Enumerates every sequence shorter than `target` (and at most `max_len`
+ *     long) over its variables, `MOV` immediates of the target and small
+ *     ones, and the ALU operations, shortest first.
+ * - Multiply and divide operations take several cycles on most pipelines,
+ *     so a shorter sequence using one is rarely faster, and they're only
+ *     searched with `opts.muldiv` set.
+ * - The first instruction of each candidate is handed out to the threads,
+ *     which run the rest on `n_vectors` random states (and corner values)
+ *     and keep the candidates matching the target's kept registers.
+ * - Survivors are then checked against every input that matters, the
+ *     registers either sequence reads before writing (or keeps without
+ *     writing) and the carry, in enumeration order.
+ * - Returns true if a shorter sequence was proven, set in `best`, along
+ *     with the number of inputs it was checked over in `n_inputs`.
+ * - Survivors that need more than `max_bits` input bits are skipped and
+ *     counted in `n_unproven`.
+ * ------------------------------------------------------------------------- */
+bool superoptimize(const target_s& target, const search_opts_s& opts,
+    seq_t& best, unsigned long long& n_inputs, unsigned& n_unproven);
+
+/* ------------------------------------------------------------------------- *
+ * Search helper functions
+ * ------------------------------------------------------------------------- */
+// runs an instruction on a state
+void run_inst(const seq_inst_s& inst, state_s& st);
+
+// runs a sequence on a state
+void run_seq(const seq_t& seq, state_s& st);
+
+// variables (bitmask) and carry whose values reach the variables of `keeps`
+//   at the end of a sequence
+unsigned live_in(const seq_t& seq, unsigned keeps, bool& carry_in);
+
+// variables (bitmask) written by a sequence
+unsigned seq_writes(const seq_t& seq);
+
+// builds the instructions a candidate can be made of, with the multiply and
+//   divide operations if `muldiv`
+vector<seq_inst_s> build_alphabet(const target_s& target, bool muldiv);
+
+// checks a candidate against the target on every input of `vars` and the
+//   carry (if `carry_in`), spread over `n_threads` threads
+bool prove_equal(const target_s& target, const seq_t& cand, unsigned vars,
+    bool carry_in, unsigned n_threads);
+
+// formats a sequence as rule instructions (`ADD A, B, C | ...`)
+string rule_str(const seq_t& seq);
+
+/* ------------------------------------------------------------------------- *
+ * IO helper functions
+ * ------------------------------------------------------------------------- */
+// validates and organizes command line options
+bool get_options(int argc, char** argv, search_opts_s& opts);
+
+// prints help message for program usage
+void print_help();
+
+// converts a string to uppercase
+string str_to_upper(const string& str);
+
+
+/* ========================================================================= *
+ * Main Function
+ * ========================================================================= */
+int main(int argc, char** argv) {
+    // obtain arguments/options and read targets
+    search_opts_s opts;
+    if(!get_options(argc, argv, opts)) {
+        print_help();
+        return 1;
+    }
+    ifstream fin(opts.target_file);
+    if(fin.fail()) {
+        cerr << "Error: could not open target file '" << opts.target_file
+             << "'" << endl;
+        return 1;
+    }
+    vector<target_s> targets;
+    if(!read_targets(fin, targets)) {
+        cerr << "Error: failed to read targets from '" << opts.target_file
+             << "', aborting..."
+             << endl;
+        return 1;
+    }
+    fin.close();
+
+    // search each target, writing the rules that were proven
+    ofstream fout(opts.rules_file);
+    if(fout.fail()) {
+        cerr << "Error: could not open rules file '" << opts.rules_file
+             << "'" << endl;
+        return 1;
+    }
+    fout << "; peephole rules for `alarmas -O peep`, found by superopt from '"
+         << opts.target_file << "'" << endl;
+    unsigned n_rules = 0;
+    for(auto it=targets.begin(); it!=targets.end(); ++it) {
+        seq_t best;
+        unsigned long long n_inputs = 0;
+        unsigned n_unproven = 0;
+        cerr << "line[" << it->line_num << "]: " << rule_str(it->seq)
+             << endl;
+        const bool found = superoptimize(*it, opts, best, n_inputs,
+            n_unproven);
+        if(n_unproven > 0) {
+            cerr << "  skipped " << n_unproven << " candidate"
+                 << (n_unproven == 1 ? "" : "s") << " with more than "
+                 << opts.max_bits << " input bits (see `-x`)"
+                 << endl;
+        }
+        if(!found) {
+            cerr << "  no shorter sequence" << endl;
+            continue;
+        }
+        cerr << "  => " << (best.empty() ? "(nothing)" : rule_str(best))
+             << endl;
+
+        // the rule keeps variables, named in the order they appear
+        string keeps;
+        for(unsigned v=0; v<it->n_vars; v++) {
+            if(it->keeps & (1u<<v))
+                keeps += (keeps.empty() ? "" : ", ") + string(1, 'A'+v);
+        }
+        fout << "; line " << it->line_num << ": " << it->seq.size() << " -> "
+             << best.size() << " instructions, proven over " << n_inputs
+             << " input" << (n_inputs == 1 ? "" : "s") << endl
+             << rule_str(it->seq) << " => " << rule_str(best)
+             << " : keeps " << keeps << endl;
+        n_rules++;
+    }
+    fout.close();
+    cerr << "Wrote " << n_rules << " rule" << (n_rules == 1 ? "" : "s")
+         << " for " << targets.size() << " target"
+         << (targets.size() == 1 ? "" : "s") << " to '" << opts.rules_file
+         << "'" << endl;
+    return 0;
+}
+
+
+/* ========================================================================= *
+ * Function Definitions
+ * ========================================================================= */
+/* ------------------------------------------------------------------------- *
+ * read_targets
+ * - Reads the target sequences of `in`, one block of lines each, using the
+ *     parser of `alarmas.h` for every instruction.
+ * - Registers are renamed to variables in the order they appear, so a rule
+ *     found for `r3` and `r5` applies to any pair of registers.
+ * - Returns true upon succesful completion, filling `targets`.
+ * - Returns false if a line doesn't assemble, or uses instructions other
+ *     than `MOV` and ALU operations, the flags or the PC.
+ * ------------------------------------------------------------------------- */
+bool read_targets(ifstream& in, vector<target_s>& targets) {
+    string line_buf;
+    unsigned file_line = 0;
+    target_s target = {};
+    string keeps_buf;
+    unsigned keeps_line = 0;
+    smatch m;
+
+    // renames a register number to its variable
+    auto reg_var = [&target](unsigned reg) -> uint8_t {
+        const string name = "R" + to_string(reg);
+        auto found = find(target.regs.begin(), target.regs.end(), name);
+        if(found != target.regs.end())
+            return found - target.regs.begin();
+        target.regs.push_back(name);
+        return target.regs.size()-1;
+    };
+
+    // finishes the current block, resolving its kept registers
+    auto end_block = [&]() -> bool {
+        if(target.seq.empty())
+            return true;
+        target.n_vars = target.regs.size();
+        target.keeps = seq_writes(target.seq);
+        if(!keeps_buf.empty()) {
+            target.keeps = 0;
+            stringstream keeps_ss(keeps_buf);
+            string tok;
+            while(getline(keeps_ss, tok, ',')) {
+                tok.erase(0, tok.find_first_not_of(" \t"));
+                tok.erase(tok.find_last_not_of(" \t\r")+1);
+                const string name = str_to_upper(tok);
+                auto found = find(target.regs.begin(), target.regs.end(),
+                    name);
+                // error: kept register isn't part of the target
+                if(found == target.regs.end()) {
+                    cerr << "Error: line[" << keeps_line << "]: "
+                         << "kept register '" << tok << "' isn't used by "
+                         << "the target"
+                         << endl;
+                    return false;
+                }
+                target.keeps |= 1u<<(found - target.regs.begin());
+            }
+        }
+        targets.push_back(target);
+        target = {};
+        keeps_buf.clear();
+        return true;
+    };
+
+    while(getline(in, line_buf)) {
+        file_line++;
+        // blank lines end a target
+        if(line_buf.find_first_not_of(" \t\r") == string::npos) {
+            if(!end_block())
+                return false;
+            continue;
+        }
+        if(regex_match(line_buf, m, keeps_re)) {
+            keeps_buf = m[1].str();
+            keeps_line = file_line;
+            continue;
+        }
+
+        // assemble the line on its own and take its fields back out
+        // -----------------------------------------------------------------
+        const detail::line_s line = detail::split_line(line_buf.c_str());
+        if(line.mne.begin == line.mne.end && line.oprs.begin == line.oprs.end)
+            continue;
+        uint16_t word = 0;
+        try {
+            word = detail::encode_line(line_buf.c_str(), line, 0);
+        }
+        catch(const invalid_argument& e) {
+            cerr << "Error: line[" << file_line << "]: " << e.what() << ":"
+                 << endl
+                 << "--> " << line_buf
+                 << endl;
+            return false;
+        }
+        const OPCODE opc = (word & MOVIM) ? MOVIM
+            : static_cast<OPCODE>(word & (~0u<<9));
+        const I_FMT fmt = opcode_format(opc);
+        // error: not a `MOV` or ALU operation
+        if(fmt != R2_TYPE && fmt != R2NW_TYPE && fmt != R3_TYPE
+                && fmt != I_TYPE) {
+            cerr << "Error: line[" << file_line << "]: "
+                 << "only register and immediate `MOV` and ALU operations "
+                 << "can be searched:"
+                 << endl
+                 << "--> " << line_buf
+                 << endl;
+            return false;
+        }
+        if(target.seq.empty())
+            target.line_num = file_line;
+
+        // rename registers to variables, in the order they appear
+        // -----------------------------------------------------------------
+        seq_inst_s inst = { opc, 0, 0, 0, 0 };
+        unsigned regs[3] = { 0, 0, 0 };
+        const fmt_fields_s& fields = FMT_FIELDS[fmt];
+        for(unsigned o=0; o<fields.n_oprs; o++) {
+            const opr_field_s& field = fields.oprs[o];
+            const unsigned val = (word >> field.pos) & ~(~0u<<field.width);
+            if(field.width == IMM)
+                inst.imm = static_cast<int16_t>(val << 4) >> 4;
+            else if(val == detail::MAX_REG) {
+                // error: the PC can't be a variable
+                cerr << "Error: line[" << file_line << "]: "
+                     << "the PC (r" << detail::MAX_REG << ") can't be "
+                     << "searched over:"
+                     << endl
+                     << "--> " << line_buf
+                     << endl;
+                return false;
+            }
+            regs[o] = val;
+        }
+        if(fmt == R2NW_TYPE) {
+            inst.rn = reg_var(regs[0]);
+            inst.rm = reg_var(regs[1]);
+        }
+        else if(fmt == I_TYPE)
+            inst.rd = reg_var(regs[0]);
+        else {
+            // sources are named before the destination they write
+            inst.rn = reg_var(regs[1]);
+            inst.rm = fmt == R3_TYPE ? reg_var(regs[2]) : inst.rn;
+            inst.rd = reg_var(regs[0]);
+        }
+        target.seq.push_back(inst);
+    }
+    return end_block();
+}
+
+/* ------------------------------------------------------------------------- *
+ * superoptimize
+ * - Enumerates every sequence shorter than `target` (and at most `max_len`
+ *     long) over its variables, `MOV` immediates of the target and small
+ *     ones, and the ALU operations, shortest first.
+ * - Multiply and divide operations take several cycles on most pipelines,
+ *     so a shorter sequence using one is rarely faster, and they're only
+ *     searched with `opts.muldiv` set.
+ * - The first instruction of each candidate is handed out to the threads,
+ *     which run the rest on `n_vectors` random states (and corner values)
+ *     and keep the candidates matching the target's kept registers.
+ * - Survivors are then checked against every input that matters, the
+ *     registers either sequence reads before writing (or keeps without
+ *     writing) and the carry, in enumeration order.
+ * - Returns true if a shorter sequence was proven, set in `best`, along
+ *     with the number of inputs it was checked over in `n_inputs`.
+ * - Survivors that need more than `max_bits` input bits are skipped and
+ *     counted in `n_unproven`.
+ * ------------------------------------------------------------------------- */
+bool superoptimize(const target_s& target, const search_opts_s& opts,
+        seq_t& best, unsigned long long& n_inputs, unsigned& n_unproven) {
+    n_unproven = 0;
+    if(target.keeps == 0)
+        return false;
+    const vector<seq_inst_s> alphabet = build_alphabet(target,
+        opts.muldiv);
+    bool target_carry = false;
+    const unsigned target_vars = live_in(target.seq, target.keeps,
+        target_carry);
+
+    // random test vectors, skipping the ones the target has no result for
+    // ---------------------------------------------------------------------
+    mt19937 rng(target.line_num);
+    const unsigned n_corners = sizeof(CORNER_VALS)/sizeof(CORNER_VALS[0]);
+    vector<state_s> inputs, outputs;
+    for(unsigned k=0; inputs.size()<opts.n_vectors && k<opts.n_vectors*16;
+            k++) {
+        state_s st = {};
+        for(unsigned v=0; v<MAX_VARS; v++)
+            st.regs[v] = k < n_corners ? CORNER_VALS[(k+v) % n_corners]
+                : rng();
+        st.carry = k < n_corners ? k&1 : rng()&1;
+        st.ok = true;
+        state_s out = st;
+        run_seq(target.seq, out);
+        if(!out.ok)
+            continue;
+        inputs.push_back(st);
+        outputs.push_back(out);
+    }
+    const unsigned n_vecs = inputs.size();
+
+    // search each length, shortest first
+    // ---------------------------------------------------------------------
+    const unsigned n_threads = max(1u, opts.n_threads);
+    const unsigned max_len = min<unsigned>(opts.max_len,
+        target.seq.size()-1);
+    for(unsigned len=0; len<=max_len; len++) {
+        vector<cand_t> survivors;
+        mutex survivors_lock;
+        atomic<unsigned> next_first(0);
+
+        // checks the candidate in `cand` at its last instruction, running
+        //   vectors from the states after the rest
+        auto check_leaf = [&](const cand_t& cand,
+                const vector<state_s>& before) {
+            const seq_inst_s& last = alphabet[cand.back()];
+            for(unsigned t=0; t<n_vecs; t++) {
+                state_s st = before[t];
+                run_inst(last, st);
+                if(!st.ok)
+                    return false;
+                for(unsigned v=0; v<target.n_vars; v++) {
+                    if((target.keeps & (1u<<v))
+                            && st.regs[v] != outputs[t].regs[v])
+                        return false;
+                }
+            }
+            return true;
+        };
+
+        // enumerates the candidates starting with each handed out
+        //   instruction, keeping the states after every prefix
+        auto worker = [&]() {
+            cand_t cand(len);
+            vector<vector<state_s>> states(len+1, inputs);
+            function<void(unsigned)> extend = [&](unsigned depth) {
+                if(depth+1 == len) {
+                    for(unsigned a=0; a<alphabet.size(); a++) {
+                        cand[depth] = a;
+                        if(!check_leaf(cand, states[depth]))
+                            continue;
+                        lock_guard<mutex> guard(survivors_lock);
+                        survivors.push_back(cand);
+                    }
+                    return;
+                }
+                for(unsigned a=0; a<alphabet.size(); a++) {
+                    cand[depth] = a;
+                    bool ok = true;
+                    for(unsigned t=0; t<n_vecs && ok; t++) {
+                        states[depth+1][t] = states[depth][t];
+                        run_inst(alphabet[a], states[depth+1][t]);
+                        ok = states[depth+1][t].ok;
+                    }
+                    if(ok)
+                        extend(depth+1);
+                }
+            };
+            unsigned first;
+            while((first = next_first++) < alphabet.size()) {
+                cand[0] = first;
+                if(len == 1) {
+                    if(check_leaf(cand, states[0])) {
+                        lock_guard<mutex> guard(survivors_lock);
+                        survivors.push_back(cand);
+                    }
+                    continue;
+                }
+                bool ok = true;
+                for(unsigned t=0; t<n_vecs && ok; t++) {
+                    states[1][t] = states[0][t];
+                    run_inst(alphabet[first], states[1][t]);
+                    ok = states[1][t].ok;
+                }
+                if(ok)
+                    extend(1);
+            }
+        };
+
+        // the empty sequence is checked on its own
+        if(len == 0) {
+            bool ok = true;
+            for(unsigned t=0; t<n_vecs && ok; t++) {
+                for(unsigned v=0; v<target.n_vars && ok; v++) {
+                    ok = !(target.keeps & (1u<<v))
+                        || inputs[t].regs[v] == outputs[t].regs[v];
+                }
+            }
+            if(ok)
+                survivors.push_back(cand_t());
+        }
+        else {
+            vector<thread> pool;
+            for(unsigned t=0; t<n_threads; t++)
+                pool.emplace_back(worker);
+            for(auto it=pool.begin(); it!=pool.end(); ++it)
+                it->join();
+        }
+
+        // prove the survivors in enumeration order
+        // -----------------------------------------------------------------
+        sort(survivors.begin(), survivors.end());
+        for(auto it=survivors.begin(); it!=survivors.end(); ++it) {
+            seq_t cand;
+            for(auto jt=it->begin(); jt!=it->end(); ++jt)
+                cand.push_back(alphabet[*jt]);
+            bool cand_carry = false;
+            const unsigned vars = target_vars
+                | live_in(cand, target.keeps, cand_carry);
+            const bool carry_in = target_carry || cand_carry;
+            unsigned bits = carry_in;
+            for(unsigned v=0; v<target.n_vars; v++)
+                bits += vars & (1u<<v) ? 16 : 0;
+            if(bits > opts.max_bits) {
+                n_unproven++;
+                continue;
+            }
+            if(!prove_equal(target, cand, vars, carry_in, n_threads))
+                continue;
+            best = cand;
+            n_inputs = 1ULL<<bits;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------------------- *
+ * Search helper functions
+ * ------------------------------------------------------------------------- */
+// runs an instruction on a state
+void run_inst(const seq_inst_s& inst, state_s& st) {
+    if(inst.opcode == MOVRR) {
+        st.regs[inst.rd] = st.regs[inst.rn];
+        return;
+    }
+    if(inst.opcode == MOVIM) {
+        st.regs[inst.rd] = inst.imm;
+        return;
+    }
+    const uint16_t n = st.regs[inst.rn];
+    const uint16_t m = st.regs[inst.rm];
+    uint16_t res = 0;
+    if(inst.opcode != CMP) {
+        st.ok &= alu_eval(inst.opcode, n, m, st.carry, res);
+        // `ADD` and `SUB` have no defined result on an unknown carry
+        st.ok &= !st.carry_unknown
+            || (inst.opcode != ADD && inst.opcode != SUB);
+        st.regs[inst.rd] = res;
+    }
+    st.carry = alu_carry(inst.opcode, n, m, st.carry);
+    st.carry_unknown = !alu_carry_known(inst.opcode);
+}
+
+// runs a sequence on a state
+void run_seq(const seq_t& seq, state_s& st) {
+    for(auto it=seq.begin(); it!=seq.end(); ++it)
+        run_inst(*it, st);
+}
+
+// variables (bitmask) and carry whose values reach the variables of `keeps`
+//   at the end of a sequence
+unsigned live_in(const seq_t& seq, unsigned keeps, bool& carry_in) {
+    unsigned live = keeps;
+    carry_in = false;
+    for(auto it=seq.rbegin(); it!=seq.rend(); ++it) {
+        const OPCODE opc = it->opcode;
+        const I_FMT fmt = opcode_format(opc);
+        const bool uses_carry = opc == ADD || opc == SUB;
+        // operands matter when the result or a carry made from them is
+        //   read later, and always to `DIV`/`MOD`, which may be undefined
+        const bool needed = opc == DIV || opc == MOD
+            || (opc != CMP && (live & (1u<<it->rd)))
+            || (carry_in && (uses_carry || opc == CMP));
+        if(opc != CMP)
+            live &= ~(1u<<it->rd);
+        if(opc >= ADD && opc <= CMP)
+            carry_in = false;
+        if(!needed)
+            continue;
+        if(fmt == R2_TYPE || fmt == R2NW_TYPE || fmt == R3_TYPE)
+            live |= 1u<<it->rn;
+        if(fmt == R2NW_TYPE || fmt == R3_TYPE)
+            live |= 1u<<it->rm;
+        carry_in |= uses_carry;
+    }
+    return live;
+}
+
+// variables (bitmask) written by a sequence
+unsigned seq_writes(const seq_t& seq) {
+    unsigned writes = 0;
+    for(auto it=seq.begin(); it!=seq.end(); ++it) {
+        if(it->opcode != CMP)
+            writes |= 1u<<it->rd;
+    }
+    return writes;
+}
+
+// builds the instructions a candidate can be made of, with the multiply and
+//   divide operations if `muldiv`
+vector<seq_inst_s> build_alphabet(const target_s& target, bool muldiv) {
+    vector<seq_inst_s> alphabet;
+    const uint8_t k = target.n_vars;
+
+    // immediates of the target and small ones
+    vector<int16_t> imms;
+    for(int i=SMALL_IMM_MIN; i<=SMALL_IMM_MAX; i++)
+        imms.push_back(i);
+    for(unsigned b=5; b<IMM-1; b++) {
+        imms.push_back(1<<b);
+        imms.push_back((1<<b)-1);
+        imms.push_back(-(1<<b));
+    }
+    for(auto it=target.seq.begin(); it!=target.seq.end(); ++it) {
+        if(it->opcode == MOVIM && find(imms.begin(), imms.end(), it->imm)
+                == imms.end())
+            imms.push_back(it->imm);
+    }
+
+    for(uint8_t d=0; d<k; d++) {
+        for(uint8_t n=0; n<k; n++) {
+            if(n != d)
+                alphabet.push_back({ MOVRR, d, n, n, 0 });
+        }
+        for(auto it=imms.begin(); it!=imms.end(); ++it)
+            alphabet.push_back({ MOVIM, d, 0, 0, *it });
+    }
+    for(const opc_fmt_s& it : OPC_FMTS) {
+        if(it.opcode < ADD || it.opcode >= CMP || (!muldiv
+                && it.opcode >= MUL && it.opcode <= MOD))
+            continue;
+        for(uint8_t d=0; d<k; d++) {
+            for(uint8_t n=0; n<k; n++) {
+                if(it.fmt == R2_TYPE) {
+                    alphabet.push_back({ it.opcode, d, n, n, 0 });
+                    continue;
+                }
+                for(uint8_t m=0; m<k; m++)
+                    alphabet.push_back({ it.opcode, d, n, m, 0 });
+            }
+        }
+    }
+    return alphabet;
+}
+
+// checks a candidate against the target on every input of `vars` and the
+//   carry (if `carry_in`), spread over `n_threads` threads
+bool prove_equal(const target_s& target, const seq_t& cand, unsigned vars,
+        bool carry_in, unsigned n_threads) {
+    vector<unsigned> var_list;
+    for(unsigned v=0; v<target.n_vars; v++) {
+        if(vars & (1u<<v))
+            var_list.push_back(v);
+    }
+    const unsigned bits = 16*var_list.size() + carry_in;
+    const unsigned long long n_inputs = 1ULL<<bits;
+    // threads take chunks of inputs until one finds a difference
+    const unsigned long long chunk = 1ULL<<16;
+    atomic<unsigned long long> next_input(0);
+    atomic<bool> equal(true);
+
+    auto worker = [&]() {
+        unsigned long long first;
+        while(equal && (first = next_input.fetch_add(chunk)) < n_inputs) {
+            const unsigned long long last = min(first+chunk, n_inputs);
+            for(unsigned long long i=first; i<last; i++) {
+                state_s st = {};
+                st.ok = true;
+                unsigned long long bits_left = i;
+                if(carry_in) {
+                    st.carry = bits_left & 1;
+                    bits_left >>= 1;
+                }
+                for(auto it=var_list.begin(); it!=var_list.end(); ++it) {
+                    st.regs[*it] = bits_left & 0xFFFF;
+                    bits_left >>= 16;
+                }
+                state_s want = st;
+                run_seq(target.seq, want);
+                if(!want.ok)
+                    continue;
+                run_seq(cand, st);
+                bool same = st.ok;
+                for(unsigned v=0; v<target.n_vars && same; v++) {
+                    same = !(target.keeps & (1u<<v))
+                        || st.regs[v] == want.regs[v];
+                }
+                if(!same) {
+                    equal = false;
+                    return;
+                }
+            }
+        }
+    };
+    vector<thread> pool;
+    for(unsigned t=0; t<n_threads; t++)
+        pool.emplace_back(worker);
+    for(auto it=pool.begin(); it!=pool.end(); ++it)
+        it->join();
+    return equal;
+}
+
+// formats a sequence as rule instructions (`ADD A, B, C | ...`)
+string rule_str(const seq_t& seq) {
+    string str;
+    for(auto it=seq.begin(); it!=seq.end(); ++it) {
+        const char* mne = "";
+        for(const mnemonic_s& jt : MNEMONICS) {
+            for(unsigned k=0; k<jt.n_opcodes; k++) {
+                if(jt.opcodes[k] == it->opcode)
+                    mne = jt.name;
+            }
+        }
+        const I_FMT fmt = opcode_format(it->opcode);
+        str += (str.empty() ? "" : " | ") + string(mne) + " ";
+        if(fmt == R2NW_TYPE)
+            str += string(1, 'A'+it->rn) + ", " + string(1, 'A'+it->rm);
+        else if(fmt == I_TYPE)
+            str += string(1, 'A'+it->rd) + ", " + to_string(it->imm);
+        else {
+            str += string(1, 'A'+it->rd) + ", " + string(1, 'A'+it->rn);
+            if(fmt == R3_TYPE)
+                str += ", " + string(1, 'A'+it->rm);
+        }
+    }
+    return str;
+}
+
+/* ------------------------------------------------------------------------- *
+ * IO helper functions
+ * ------------------------------------------------------------------------- */
+// validates and organizes command line options
+bool get_options(int argc, char** argv, search_opts_s& opts) {
+    // error: invalid number of arguments
+    if(argc < 3) {
+        if(argc > 1)
+            cerr << "Error: invalid number of arguments" << endl;
+        return false;
+    }
+
+    // target and rules file are always 1st and 2nd arguments
+    opts.target_file = argv[1];
+    opts.rules_file = argv[2];
+    opts.n_threads = thread::hardware_concurrency();
+
+    // loop through other arguments, numeric except for `-m`
+    for(int i=3; i<argc; i++) {
+        if(strcmp(argv[i], "-m") == 0) {
+            opts.muldiv = true;
+            continue;
+        }
+        unsigned* opt = strcmp(argv[i], "-k") == 0 ? &opts.max_len
+            : strcmp(argv[i], "-n") == 0 ? &opts.n_vectors
+            : strcmp(argv[i], "-x") == 0 ? &opts.max_bits
+            : strcmp(argv[i], "-t") == 0 ? &opts.n_threads : nullptr;
+        if(opt == nullptr || i+1 >= argc) {
+            cerr << "Error: unrecognized argument '" << argv[i] << "'"
+                 << endl;
+            return false;
+        }
+        char* end = nullptr;
+        const unsigned long val = strtoul(argv[++i], &end, 10);
+        // error: not a positive number (inputs stay below 64 bits)
+        if(*end != '\0' || val == 0 || (opt == &opts.max_bits && val > 63)) {
+            cerr << "Error: invalid value '" << argv[i] << "' for '"
+                 << argv[i-1] << "'"
+                 << endl;
+            return false;
+        }
+        *opt = val;
+    }
+
+    // signal success
+    return true;
+}
+
+// prints help message for program usage
+void print_help() {
+    cerr << "USAGE:  superopt <target file> <rules file> [-k length]"
+         << " [-n vectors] [-x bits] [-t threads] [-m]" << endl
+         << "        -k : longest sequence searched (default "
+         << DEFAULT_MAX_LEN << ")" << endl
+         << "        -n : random test vectors each candidate runs on"
+         << " (default " << DEFAULT_VECTORS << ")" << endl
+         << "        -x : most input bits a candidate is proven over"
+         << " (default " << DEFAULT_MAX_BITS << "," << endl
+         << "             two registers and the carry)" << endl
+         << "        -t : threads to search with (default: every core)"
+         << endl
+         << "        -m : search MUL, MULU, DIV and MOD too, which are slower"
+         << " than" << endl
+         << "             the other ALU operations on most pipelines" << endl;
+}
+
+// converts a string to uppercase
+string str_to_upper(const string& str) {
+    string upper = str;
+    transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+    return upper;
+}
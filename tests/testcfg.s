@@ -0,0 +1,17 @@
+; control-flow analysis, assemble with `-R cfg -g cfg.dot -j cfg.json` and
+;   check the loops, warnings and cycle estimates in the report
+    MOV     r0,     3
+outer:                              ; loop of depth 1
+    MOV     r1,     4
+inner:                              ; loop of depth 2, run once per outer pass
+    LDR     r2,     [r1]
+    MOV     r3,     1
+    SUB     r1,     r1,     r3
+    BNE     inner
+    SUB     r0,     r0,     r3
+    BNE     outer
+    MOV     r7,     r4              ; indirect jump, ends the known paths
+dead:                               ; unreachable from address 0
+    B       100                     ; branches past the end of the program
+tail:
+    ADD     r1,     r1,     r1      ; falls through past the end
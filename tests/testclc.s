@@ -0,0 +1,22 @@
+; carry tracking, assemble with `-R carry` to see the carry reaching each
+;   CLC, ADD and SUB and with `-O clc` to drop the redundant CLCs
+    CLC                             ; redundant, the carry is clear at reset
+    ADD     r1,     r1,     r2
+    CLC                             ; kept, ADD may have left a carry
+    ADD     r3,     r3,     r4      ; low word
+    ADD     r5,     r5,     r6      ; high word, chained carry of low word
+    MOV     r4,     1
+loop:
+    ADD     r1,     r1,     r2      ; warned, borrow of SUB below reaches it
+    SUB     r3,     r3,     r4
+    BNE     loop
+    AND     r2,     r2,     r2
+    CLC                             ; redundant, AND cleared the carry
+    SUB     r1,     r1,     r2
+    MUL     r6,     r6,     r6
+    CLC                             ; kept, the carry MUL leaves isn't
+                                    ;   documented, and BEQ reads Z
+    BEQ     done
+    MOV     r0,     0
+done:
+    HALT
@@ -0,0 +1,49 @@
+; conditional assembly, assemble with `-l` to see the skipped lines and
+;   with `-D FAST` or `-D MODE=2` to pick another variant
+        .ifndef MODE
+        .equ    MODE,   1               ; default unless given with `-D`
+        .endif
+        .equ    STEP,   4
+        .equ    LIMIT,  STEP            ; symbols can name earlier symbols
+
+        .data
+table:
+        .if MODE == 2
+        .word   2, 4, 6, 8
+        .else
+        .word   1, 2, 3, 4
+        .endif
+size:   .word   LIMIT
+        .text
+; sums the table, unrolled when FAST is defined
+        MOV     r1,     table
+        MOV     r2,     0
+        .ifdef FAST
+        LDR     r3,     [r1]
+        ADD     r2,     r2,     r3
+        MOV     r4,     1
+        LDR     r3,     [r1, r4]
+        ADD     r2,     r2,     r3
+        MOV     r4,     2
+        LDR     r3,     [r1, r4]
+        ADD     r2,     r2,     r3
+        MOV     r4,     3
+        LDR     r3,     [r1, r4]
+        ADD     r2,     r2,     r3
+        .else
+        MOV     r5,     STEP            ; replaced by its value
+loop:   LDR     r3,     [r1]
+        ADD     r2,     r2,     r3
+        MOV     r4,     1
+        ADD     r1,     r1,     r4
+        SUB     r5,     r5,     r4
+        BNE     loop
+        .endif
+        .if MODE > 1
+        .ifdef FAST                     ; nested blocks of a skipped region
+        LSL     r2,     r2,     r4      ;   are only matched up
+        .endif
+        MOV     r4,     1
+        LSR     r2,     r2,     r4
+        .endif
+done:   B       done
@@ -0,0 +1,31 @@
+; constant propagation, assemble with `-O const` to fold known results and
+;   reduce `MUL`, `DIV` and `MOD` by powers of two, and add `-p mul=3,div=8,
+;   mod=8` to also load the shift or mask into a dead register
+    MOV     r1,     6
+    MOV     r2,     4
+    MUL     r3,     r1,     r2      ; folded, 24 fits the immediate
+    MOV     r5,     1000
+    MUL     r5,     r5,     r5      ; kept, its low word 16960 doesn't fit
+    MOV     r4,     2
+    MUL     r6,     r6,     r2      ; reduced to LSL by r4
+    MUL     r0,     r3,     r6      ; kept, neither is a power of two
+    LDR     r5,     [r0]
+    LSR     r5,     r5,     r4      ; r5 is non-negative from here
+    DIV     r6,     r5,     r2      ; reduced to ASR by r4
+    MOD     r0,     r6,     r2      ; kept, unless `-p` has the mask loaded
+    LDR     r1,     [r0]
+    DIV     r1,     r1,     r2      ; kept, r1 may be negative
+loop:
+    ADD     r2,     r2,     r2      ; kept, the carry isn't known here
+    MOV     r3,     4               ; r3 is 4 on every path into `done`
+    SUB     r5,     r5,     r4
+    BNE     loop
+    MOV     r4,     16
+    CLC
+    ADD     r6,     r3,     r4      ; folded, the carry is clear
+    MUL     r1,     r1,     r4      ; reduced to LSL by r3
+    NOT     r0,     r4              ; kept, BEQ reads its flags
+    BEQ     done
+    MOV     r1,     0
+done:
+    HALT
@@ -0,0 +1,33 @@
+; data section directives, assemble with `-l` to see the data layout and
+;   with `-d` to pick the data memory image file
+        .data
+squares:
+        .word   0, 1, 4, 9, 16, 25, 36, 49
+jumps:  .word   even, odd               ; instruction labels
+count:  .word   8
+        .align  16
+buffer: .fill   32                      ; zeroed scratch space
+ones:   .fill   4, 0xFFFF
+        .org    0x0100
+greet:  .incbin "tests/testdata.bin"    ; path is relative to the working dir
+        .text
+; sums the odd squares by jumping through the table
+        MOV     r1,     squares         ; data label as an immediate
+        LDI     r2,     count
+        LDR     r2,     [r2]
+        MOV     r3,     0
+loop:   LDR     r4,     [r1]
+        MOV     r5,     1
+        AND     r5,     r4,     r5
+        LDI     r6,     jumps
+        LDR     r6,     [r6, r5]
+        MOV     r7,     r6              ; jump to even or odd
+odd:    CLC
+        ADD     r3,     r3,     r4
+even:   MOV     r5,     1
+        ADD     r1,     r1,     r5
+        SUB     r2,     r2,     r5
+        BNE     loop
+        LDI     r1,     buffer
+        STR     r3,     [r1]
+        HALT
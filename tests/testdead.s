@@ -0,0 +1,16 @@
+; dead write elimination, assemble with `-R dead` to list the dead writes
+;   and with `-O dead` to remove them, then compare the listings
+    MOV     r1,     5               ; dead, overwritten below
+    MOV     r2,     3
+    ADD     r3,     r2,     r2      ; live, registers are kept at HALT
+    MOV     r4,     r3              ; dead, overwritten below
+    MOV     r4,     0
+    MOV     r1,     1
+loop:
+    CMP     r1,     r2              ; dead, MUL sets the flags SUB reads
+    MUL     r5,     r1,     r1
+    SUB     r2,     r2,     r1
+    BNE     loop
+    CLC
+    MOV     r6,     flags
+    HALT
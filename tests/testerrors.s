@@ -21,6 +21,22 @@
 ; r1
 ; -foo:
 ; halt r0
+; .if
+; .if foo
+; .if 1 = 2
+; .ifdef 0x10
+; .endif
+; .else
+; .if 0
+; .equ mov, 1
+; .equ x 0x10000
+; .equ x, 1
+; x: mov r0 r1
+; mov r0 y
+; .equ y, 1
+; .macro spin
+; spin
+; .endm
 
 ; encoder errors
 ; --------------
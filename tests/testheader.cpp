@@ -0,0 +1,63 @@
+// header assembler, checked while it compiles with `make testheader`; the
+//   words are the encodings of `testhandencoded.s`
+#include "../alarmas.h"
+
+constexpr auto insts = ALARMAS_ASSEMBLE(
+    "MOV  R0, 0x4    \n"
+    "MOV  R1, 0x50   \n"
+    "MOV  R2, 0x600  \n"
+    "ADD  R2, R3, R1 \n"
+    "SUB  R2, R0, R1 \n"
+    "MUL  R5, R0, R7 \n"
+    "MULU R2, R5, R1 \n"
+    "DIV  R2, R0, R1 \n"
+    "MOD  R2, R0, R1 \n"
+    "AND  R2, R0, R1 \n"
+    "OR   R2, R0, R1 \n"
+    "EOR  R2, R0, R1 \n"
+    "NOT  R2, R0     \n"
+    "LSL  R2, R0, R1 \n"
+    "LSR  R2, R0, R1 \n"
+    "ASR  R2, R0, R1 \n"
+    "ROL  R2, R0, R1 \n"
+    "ROR  R2, R0, R1 \n"
+    "CMP  R2, R4     \n"
+    "B    0xFFF      \n"
+    "BEQ  0x40       \n");
+static_assert(insts.size() == 21, "one word per instruction");
+static_assert(insts[0] == 0x8004, "MOV R0, 0x4");
+static_assert(insts[1] == 0x9050, "MOV R1, 0x50");
+static_assert(insts[2] == 0xA600, "MOV R2, 0x600");
+static_assert(insts[3] == 0x20D1, "ADD R2, R3, R1");
+static_assert(insts[4] == 0x2211, "SUB R2, R0, R1");
+static_assert(insts[5] == 0x242F, "MUL R5, R0, R7");
+static_assert(insts[6] == 0x2751, "MULU R2, R5, R1");
+static_assert(insts[7] == 0x2811, "DIV R2, R0, R1");
+static_assert(insts[8] == 0x2A11, "MOD R2, R0, R1");
+static_assert(insts[9] == 0x2C11, "AND R2, R0, R1");
+static_assert(insts[10] == 0x2E11, "OR R2, R0, R1");
+static_assert(insts[11] == 0x3011, "EOR R2, R0, R1");
+static_assert(insts[12] == 0x3210, "NOT R2, R0");
+static_assert(insts[13] == 0x3411, "LSL R2, R0, R1");
+static_assert(insts[14] == 0x3611, "LSR R2, R0, R1");
+static_assert(insts[15] == 0x3811, "ASR R2, R0, R1");
+static_assert(insts[16] == 0x3A11, "ROL R2, R0, R1");
+static_assert(insts[17] == 0x3C11, "ROR R2, R0, R1");
+static_assert(insts[18] == 0x3E84, "CMP R2, R4");
+static_assert(insts[19] == 0x4FFF, "B 0xFFF");
+static_assert(insts[20] == 0x6040, "BEQ 0x40");
+
+// labels, comments, `CLC` and branches back and forward
+constexpr auto loop = ALARMAS_ASSEMBLE(
+    "       MOV  r1, 5          ; counter\n"
+    "       CLC                 \n"
+    "loop:  SUB  r1, r1, r2     \n"
+    "       BNE  loop           \n"
+    "       B    done           \n"
+    "       NOP                 \n"
+    "done:  HALT                \n");
+static_assert(loop.size() == 7, "labels take no words");
+static_assert(loop[1] == 0x2C00, "CLC is AND R0, R0, R0");
+static_assert(loop[3] == 0x7FFE, "BNE loop");
+static_assert(loop[4] == 0x4001, "B done");
+static_assert(loop[6] == 0x0600, "HALT");
@@ -0,0 +1,19 @@
+; Interactive session, meant to be piped into `-i` (not assembled as a file):
+;   ./alarmas -i tests/testinteractive.mem < tests/testinteractive.s
+; Forward branches wait for their label and are patched when it's typed,
+;   `:undo` takes lines back (un-patching branches) and lines with errors
+;   are rejected without changing the program.
+start:  MOV     r1, 10
+        MOV     r2, 1
+        B       check           ; waits for `check`
+loop:   SUB     r1, r1, r2
+        BEQ     done            ; waits for `done`
+check:  CMP     r1, r0          ; patches the `B`
+        BNE     loop
+done:   MOV     r3, r1          ; patches the `BEQ`
+:undo
+        MOV     r9, r1          ; error: rejected, `done` still waits
+        .data                   ; error: directives need a whole file
+done:   LDI     r3, 0x1234      ; patches the `BEQ` again
+        HALT
+:save
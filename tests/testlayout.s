@@ -0,0 +1,32 @@
+; profile-guided block layout, assemble with
+;   `-O layout -f tests/testlayout.prof -e isr` and compare the listing
+;   against an unlaid-out run
+    B       main                    ; reset vector, first instruction stays
+isr:                                ; fixed entry point, keeps its address
+    MOV     r5,     r7
+    BNE     isr_rare
+    MOV     r6,     1
+    B       isr_done
+isr_rare:
+    MOV     r6,     r7              ; reads the PC, so the block stays put
+isr_done:
+    HALT
+main:
+    MOV     r0,     0
+    MOV     r1,     1
+    MOV     r2,     100
+loop:
+    CMP     r0,     r2
+    BEQ     done                    ; rarely taken, stays a fall-through
+    LDR     r3,     [r0]
+    CMP     r3,     r1
+    BEQ     odd                     ; mostly taken, `odd` moves in front of
+                                    ;   `loop` so it falls into it
+    MOV     r4,     0               ; cold path, branches back to `odd`
+    STR     r4,     [r0]
+odd:
+    CLC
+    ADD     r0,     r0,     r1
+    B       loop
+done:
+    HALT
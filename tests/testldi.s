@@ -0,0 +1,13 @@
+; LDI psuedo-instruction expansions, check listing for chosen sequences
+    LDI     r1,     0x7FF           ; fits MOV immediate
+    LDI     r1,     -2048
+    LDI     r2,     0x8000          ; single-register chain
+    LDI     r2,     0xFFFF
+    LDI     r3,     0xBEEF,  r4     ; needs scratch register
+    LDI     r3      0x1234   r4
+    LDI     r5,     65535
+    LDI     r5,     -32768
+    LDI     r6,     0b1010101010101010, r0
+start:
+    LDI     r0,     0xCAFE,  r1
+    B       start
@@ -0,0 +1,10 @@
+; multi-file program, link with `-L tests/testlinklib.s` (from the repository
+;   root), which assembles `tests/testlinklib.o` on the first link and reuses
+;   it while the library source is unchanged
+        .extern mul_by_add
+        .global mul_done
+        MOV     r1,     6               ; r3 <- r1 * r2 without MUL
+        MOV     r2,     7
+        B       mul_by_add
+mul_done:
+        HALT
@@ -0,0 +1,11 @@
+; library half of `testlink.s`, also assembles on its own with `-c`
+        .global mul_by_add
+        .extern mul_done
+mul_by_add:
+        MOV     r3,     0
+        MOV     r4,     1
+loop:   CLC
+        ADD     r3,     r3,     r1
+        SUB     r2,     r2,     r4
+        BNE     loop
+        B       mul_done
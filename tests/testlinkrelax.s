@@ -0,0 +1,14 @@
+; relaxed branch in a linked program, link with `-b r5 -L tests/testlinklib.s`
+;   (from the repository root); the long branch over the padding loads an
+;   absolute address, which is only known in the source file of a link
+        .extern mul_by_add
+        .global mul_done
+        MOV     r1,     6               ; r3 <- r1 * r2 in the library
+        MOV     r2,     7
+        B       call                    ; relaxed, jumps over 2100 words
+        .rept   2100
+        NOP
+        .endr
+call:   B       mul_by_add              ; library is placed right after
+mul_done:
+        HALT
@@ -0,0 +1,34 @@
+; macros and repeat blocks, assemble with `-l` to see where each expanded
+;   instruction came from
+.macro  addc    dst, a, b               ; add without a carry-in
+        CLC
+        ADD     \dst,   \a,     \b
+.endm
+.macro  set     reg,    val             ; register or immediate value
+        MOV     \reg,   \val
+.endm
+.macro  wide    reg,    val             ; any 16-bit value
+        LDI     \reg,   \val
+.endm
+.macro  delay   reg,    n               ; `\@` keeps the loop labels apart
+        MOV     \reg,   \n
+wait\@: SUB     \reg,   \reg,   r6
+        BNE     wait\@
+.endm
+.macro  double  reg                     ; uses of earlier macros expand too
+        addc    \reg,   \reg,   \reg
+.endm
+        MOV     r6,     1
+        set     r1,     5
+        set     r2,     r1
+        addc    r3,     r1,     r2
+        wide    r4,     0x1234
+        delay   r5,     3
+        delay   r5,     7
+        .rept   4                       ; unrolled shift
+        LSL     r3,     r3,     r6
+        .endr
+        .rept   2                       ; unrolled macro uses
+        double  r4
+        .endr
+        HALT
@@ -0,0 +1,37 @@
+; peephole rewriting, assemble with `-O peep -r tests/testpeep.rules` to
+;   apply the rules superopt found for tests/testsuperopt.s
+    MOV     r1,     3
+    MOV     r4,     r1              ; rewritten into a single ADD
+    ADD     r4,     r4,     r4
+    MOV     r2,     1               ; rewritten, r2 and the flags are
+                                    ;   overwritten below
+    LSL     r3,     r3,     r2
+    LSL     r3,     r3,     r2
+    MOV     r2,     0               ; kept, only AND is known to clear
+                                    ;   the carry the SUB reads
+    CLC
+    SUB     r5,     r2,     r5
+    NOT     r6,     r6              ; removed, both NOTs cancel
+    NOT     r6,     r6
+    MOV     r2,     8               ; kept, r2 is read below
+    LSL     r4,     r4,     r2
+    LSR     r4,     r4,     r2
+    ADD     r1,     r1,     r2
+    MOV     r2,     8               ; rewritten, masks r1 to its low byte
+    LSL     r1,     r1,     r2
+    LSR     r1,     r1,     r2
+    MOV     r0,     0
+    MOV     r2,     0
+loop:
+    NOT     r6,     r6              ; kept, BEQ reads the flags of the NOT
+    NOT     r6,     r6
+    BEQ     done
+    MOV     r2,     1               ; kept, `skip` splits the sequence
+    LSL     r3,     r3,     r2
+skip:
+    LSL     r3,     r3,     r2
+    MOV     r2,     0
+    SUB     r1,     r1,     r1
+    BNE     loop
+done:
+    HALT
@@ -0,0 +1,21 @@
+; pipeline scheduling, assemble with `-O sched -R hazards` and compare the
+;   listing and hazard report against an unscheduled run
+    MOV     r0,     0
+    MOV     r1,     1
+loop:
+    LDR     r2,     [r0]            ; load-use on next line
+    ADD     r3,     r3,     r2
+    LDR     r4,     [r0, r1]
+    MUL     r4,     r4,     r4
+    MOV     r5,     8
+    CLC
+    ADD     r0,     r0,     r1
+    STR     r4,     [r0]
+    CMP     r0,     r5
+    BNE     loop
+    MOV     r6,     r7              ; reads the PC, never moved
+    LDR     r1,     [r6]
+    ADD     r1,     r1,     r1
+    MOV     r2,     3
+    MOV     r3,     r2
+    HALT
@@ -0,0 +1,22 @@
+; targets for `superopt tests/testsuperopt.s tests/testpeep.rules`, each
+;   block is searched for a shorter equivalent
+; keeps r1
+        MOV     r2,     1
+        LSL     r1,     r1,     r2
+        LSL     r1,     r1,     r2
+
+        MOV     r3,     r1
+        ADD     r3,     r3,     r3
+
+; keeps r1
+        MOV     r2,     0
+        CLC
+        SUB     r1,     r2,     r1
+
+        NOT     r1,     r1
+        NOT     r1,     r1
+
+; keeps r4
+        MOV     r5,     8
+        LSL     r4,     r4,     r5
+        LSR     r4,     r4,     r5